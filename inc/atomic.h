@@ -21,11 +21,10 @@
  */
 
 
-#define NELEMENTS		50      /**< Maximum number of elements to consider */
 extern int nelements;                  /**< The actual number of ions read from the data file */
 #define NIONS		500     /**< Maximum number of ions to consider */
 extern int nions;                      /**< The actual number of ions read from the datafile */
-#define NLEVELS 	12000   /**<  Maximum number of levels for all elements and ions */
+#define NLEVELS 	12000   /**<  Maximum number of levels for the arrays outside the atomic data which are indexed by level */
 extern int nlevels;                    /**< These are the actual number of levels which were read in */
 #define NLTE_LEVELS	12000   /**<  Maximum number of levels to treat explicitly */
 extern int nlte_levels;                /**<  Actual number of levels to treat explicityly */
@@ -33,17 +32,38 @@ extern int nlte_levels;                /**<  Actual number of levels to treat ex
 /* AUGER NOTE: recommended to increase NLEVELS_MACRO to at least 500 for Auger macro-atoms */
 #define NLEVELS_MACRO   300     /**<  Maximum number of macro atom levels. (SS, June 04) */
 extern int nlevels_macro;              /**<  Actual number of macro atom levels. (SS, June 04) */
-#define NLINES 		200000  /**<  Maximum number of lines to be read */
+#define NLINES 		200000  /**<  Maximum number of lines for the arrays outside the atomic data which are indexed by line */
 extern int nlines;                     /**<  Actual number of lines that were read in */
 extern int nlines_macro;               /**<  Actual number of Macro Atom lines that were read in.  New version of get_atomic
                                    data assumes that macro lines are read in before non-macro lines */
 #define N_INNER     10          /**< Maximum number of inner shell ionization cross sections per ion */
 extern int n_inner_tot;                /**< The actual number of inner shell ionization cross sections in total */
 
+/** 
+  * The number of entries allocated for each of the tables of atomic data
+  *
+  * These are counted from the records in the data files before the tables are
+  * allocated, by count_atomic_records, so each table is only as large as the
+  * data which can be read into it.  Each table also has one spare entry at the
+  * end, which is left in its initialised state, so that the searches which look
+  * at the entry after the last one read remain within the table.
+  */
+typedef struct atomic_sizes
+{
+  int nelements;                /**< Element records */
+  int nions;                    /**< Ion records */
+  int nlevels;                  /**< Level records, of all types */
+  int nlines;                   /**< Line records, of all types */
+  int nphot;                    /**< Photoionization x-section records, which is the size of phot_top */
+  int ninner;                   /**< Inner shell x-section records, which is the size of inner_cross and the yields */
+  int nauger_macro;             /**< Auger macro-atom records */
+  int ncoll_stren;              /**< Collision strength records */
+} Atomic_sizes;
+
+extern Atomic_sizes atomic_max;
+
 
 /* AUGER NOTE: recommended to increase these values to at least 200 for Auger macro-atoms */
-#define NBBJUMPS         100    /**<  Maximum number of Macro Atom bound-bound jumps from any one configuration (SS) */
-#define NBFJUMPS         100    /**<  Maximum number of Macro Atom Bound-free jumps from any one configuration (SS) */
 
 #define MAXJUMPS          1000000       /**<  The maximum number of Macro Atom jumps before emission (if this is exceeded
                                            it gives up (SS) */
@@ -189,10 +209,6 @@ typedef struct configurations
   double q_num;                 /* principal quantum number.  In Topbase this has non-integer values */
   double ex;                    /*excitation energy of level */
   double rad_rate;              /* Total spontaneous radiative de-excitation rate for level */
-  int bbu_jump[NBBJUMPS];       /* list of upwards bb jumps from this configuration */
-  int bbd_jump[NBBJUMPS];       /* list of downwards bb jumps from this configuration */
-  int bfu_jump[NBFJUMPS];       /* list of upwards bf jumps from this configuration */
-  int bfd_jump[NBFJUMPS];       /* list of downwards bf jumps from this configuration (SS) */
   int bbu_indx_first;           /* index to first MC estimator for bb jumps from this configuration */
   int bfu_indx_first;           /* index to first MC estimator for bf jumps from this configuration */
   int bfd_indx_first;           /* index to first rate for downward bf jumps from this configuration */
@@ -205,8 +221,32 @@ config_dummy, *ConfigPtr;
 extern ConfigPtr xconfig;
 
 
+/** 
+  * The Macro Atom jumps of one type from each configuration, in compressed sparse row form
+  *
+  * The jumps from configuration n are jump[offset[n]] to jump[offset[n + 1] - 1], in the
+  * order in which they were read, so the down_index and up_index recorded in the line
+  * and phot_top structures are positions within that range.  While the atomic data is
+  * read the jumps are recorded as (configuration, jump) pairs, and the offset and jump
+  * arrays are built from these at the end of get_atomic_data.
+  */
+typedef struct jump_list
+{
+  char name[16];                /**< The name of the list, from which its tables are named when they are shared */
+  int njumps;                   /**< The total number of jumps of this type */
+  int *offset;                  /**< Index in jump of the first jump from each configuration; nlevels + 1 elements */
+  int *jump;                    /**< The line or phot_top index of each jump */
+  int npairs, npairs_max;       /**< The number of pairs recorded, and the space allocated for them */
+  int *pair_config, *pair_jump; /**< The (configuration, jump) pairs recorded while the data is read */
+} Jump_list;
+
+extern Jump_list bbu_jumps;     /**< upwards bb jumps from each configuration */
+extern Jump_list bbd_jumps;     /**< downwards bb jumps from each configuration */
+extern Jump_list bfu_jumps;     /**< upwards bf jumps from each configuration */
+extern Jump_list bfd_jumps;     /**< downwards bf jumps from each configuration (SS) */
+
+
 extern int nauger_macro;        /* the number of auger processes read in associated with macro atoms */
-#define NAUGER_MACRO 200        /* number of Auger processes */
 #define NAUGER_ELECTRONS 4
 
 typedef struct auger
@@ -246,32 +286,64 @@ typedef struct lines
                                    Could do that by initializing */
   double el, eu;                /**<  The energy of the lower and upper levels for the transition */
   double pow;                   /**< The power in the lines as last calculated in total_line_emission */
-  int where_in_list;            /**<  Position of line in the line list: i.e. lin_ptr[line[n].where_in_list] points
-                                   to the line. Added by SS for use in macro atom method. */
+  int where_in_list;            /**<  Position of line in the line list: i.e. lin_idx[line[n].where_in_list] is n.
+                                   Added by SS for use in macro atom method. */
   int down_index;               /**<  This is to map from the line to knowing which macro atom jump it is (and therefore find
                                    the estimator with which it is associated. The estimator is identified by the
                                    upper configuration (nconfigu) and then down_index (for deexcitation) or the lower
                                    configuration (nconfigl) and then up_index. (SS) */
   int up_index;
   int coll_index;               /**<  A link into the collision strength data, if its -999 it means there is no data and van reg should be used */
+  double a21;                   /**< The Einstein A coefficient.  This and the following coefficients, which do not depend
+                                   on temperature, are set by line_coefficients */
+  double q21_coef;              /**< 8.629e-6 / gu, so that q21 is q21_coef * upsilon / sqrt(t) */
+  double q21_vr;                /**< q21_coef times the Van Regemorter collision strength, without the gaunt factor */
+  double gu_over_gl;            /**< The ratio of the multiplicities, used for q12 by detailed balance */
 
 }
 line_dummy, *LinePtr;
 
 
-extern LinePtr line, lin_ptr[NLINES];  /**<  line[] is the actual structure array that contains all the data, *lin_ptr
-                                   is an array which contains a frequency ordered set of ptrs to line */
+extern LinePtr line;            /**<  line[] is the actual structure array that contains all the data */
+extern int *lin_idx;            /**<  The positions in line[] of the lines in frequency order */
                                 /**<  fast_line (added by SS August 05) is going to be a hypothetical
                                    rapid transition used in the macro atoms to stabilise level populations */
 extern struct lines fast_line;
 
-extern int nline_min, nline_max, nline_delt;   /**<  Used to select a range of lines in a frequency band from the lin_ptr array 
+extern int nline_min, nline_max, nline_delt;   /**<  Used to select a range of lines in a frequency band from the lin_idx array 
                                            in situations where the frequency range of interest is limited, including for defining which
                                            lines come into play for resonant scattering along a line of sight, and in
                                            calculating band_limit luminosities.  The limits are established by the
                                            routine limit_lines.
                                          */
 
+/** 
+  * A frequency ordered copy of the most used fields of the lines
+  *
+  * Element n of each array belongs to the line LIN_PTR(n), so that searches in
+  * frequency, and sums over the lines in a band, read contiguous memory instead
+  * of going to each line structure.  It is built by index_lines, and
+  * must be rebuilt if the line structure is changed.
+  *
+  * The buckets divide the range of log frequency of the lines evenly, so the
+  * bucket containing a frequency is found directly and only the lines in that
+  * bucket need to be searched.
+  */
+typedef struct line_view
+{
+  int nlines;                   /**< The number of lines in the view */
+  double *freq;                 /**< The frequency of each line, in increasing order */
+  double *f;                    /**< The oscillator strength */
+  double *gl, *gu;              /**< The multiplicity of the lower and upper level */
+  int *nion;                    /**< The ion of the transition */
+  int nbuckets;                 /**< The number of buckets, of equal width in log frequency, used by limit_lines */
+  double log_freq_min;          /**< The log of the frequency of the first line, the lower edge of the first bucket */
+  double bucket_scale;          /**< The number of buckets per unit of log frequency */
+  int *bucket;                  /**< bucket[b] is the first line in bucket b or above; nbuckets + 1 elements */
+} Line_view;
+
+extern Line_view line_view;
+
 
 /* coll_stren is the collision strength interpolation data extracted from Chianti */
 
@@ -303,9 +375,31 @@ typedef struct coll_stren
                                   */
   double scups[N_COLL_STREN_PTS];       /**< The scaled coll strengths in ythe fit.
                                           */
+  int n_table;                  /**< The number of points in the table of upsilon, or 0 if there is no table */
+  double log_u0_min;            /**< log(u0) at the first point of the table */
+  double table_scale;           /**< The number of intervals in the table per unit of log(u0) */
+  int table_offset;             /**< Index in upsilon_pool of the first point of the table of upsilon, at points
+                                   evenly spaced in log(T_e), and so in log(u0) = log(kT_e/h nu) */
 } Coll_stren, *Coll_strenptr;
 
-extern Coll_stren coll_stren[NLINES];
+/* The default range of electron temperature, and the largest fractional error, of the
+   tables of upsilon made by build_upsilon_tables */
+#define UPSILON_TABLE_TMIN 1.0e3
+#define UPSILON_TABLE_TMAX 1.0e7
+#define UPSILON_TABLE_ERROR 1.0e-3
+#define UPSILON_TABLE_MAX_POINTS 16385
+
+extern Coll_stren *coll_stren;
+
+/** The points of all of the tables of upsilon, one table after another */
+typedef struct upsilon_pool
+{
+  int npoints;                  /**< The number of points stored in the pool */
+  int npoints_max;              /**< The number of points for which space has been allocated */
+  double *upsilon;
+} Upsilon_pool;
+
+extern Upsilon_pool upsilon_pool;
 
 
 
@@ -334,10 +428,6 @@ typedef struct topbase_phot
   int z, istate;
   int np;                       /**< the number of points in the corr section fit */
   int n, l;                     /**< Shell and subshell, used for inner shell */
-  int nlast;                    /**<  nlast is an index into the arrays freq and x.  It allows 
-                                   a quick check to see whether one needs to do a search
-                                   for the correct array elements, or whether this process
-                                   can be short circuited */
   int n_elec_yield;             /**< Index to the electron yield array - only used for inner shell ionizations */
 //  int n_fluor_yield;            /**< Index to the fluorescent photon yield array - only used for inner shell ionizations */
   int macro_info;               /**< Identifies whether line is to be treated using a Macro Atom approach.
@@ -353,16 +443,41 @@ typedef struct topbase_phot
                                    configuration (nlev) and then up_index. (SS) */
   int up_index;
   int use;                      /**< It we are to use this cross section. This allows unused VFKY cross sections to sit in the array. */
-  double freq[NCROSS], log_freq[NCROSS], x[NCROSS], log_x[NCROSS];
-                                                                 /**< frequency and cross sections, plus log versions for FB integrals*/
-  double f, log_f, sigma, log_sigma;            /**< last freq, last x-section and log versions*/
+  int offset;                   /**< Index of the first point of this x-section in xsection_pool; the points
+                                   are freq, log_freq, x and log_x [offset] to [offset + np - 1] */
 } Topbase_phot, *TopPhotPtr;
 
-extern Topbase_phot phot_top[NLEVELS];
-extern TopPhotPtr phot_top_ptr[NLEVELS];       /**<  Pointers to phot_top in threshold frequency order - this */
+extern Topbase_phot *phot_top;
+extern int *phot_top_idx;       /**<  The positions in phot_top of the x-sections in threshold frequency order */
 
-extern Topbase_phot inner_cross[N_INNER * NIONS];  /**< Pointer to inner shell cross sections which use the same structure type */
-extern TopPhotPtr inner_cross_ptr[N_INNER * NIONS];  /**< Pointer to inner shell cross sections in frequency order */
+extern Topbase_phot *inner_cross;  /**< Pointer to inner shell cross sections which use the same structure type */
+
+/** 
+  * The frequencies and cross sections of all of the photoionization and inner shell x-sections
+  *
+  * Each x-section has a different number of points, so rather than giving every
+  * Topbase_phot room for NCROSS points the points are stored one after the other
+  * in these arrays, and each x-section records the offset to its first point.
+  * The pool is sized from the x-sections which were read, and compacted to the
+  * points which are used once all of the atomic data has been read.
+  */
+typedef struct xsection_pool
+{
+  int npoints;                  /**< The number of points stored in the pool */
+  int npoints_max;              /**< The number of points for which space has been allocated */
+  double *freq, *log_freq, *x, *log_x;  /**< frequency and cross sections, plus log versions for FB integrals */
+} Xsection_pool;
+
+extern Xsection_pool xsection_pool;
+extern int *inner_cross_idx;    /**< The positions in inner_cross of the inner shell x-sections in frequency order */
+
+/* The n'th line, photoionization x-section and inner shell x-section in order of frequency.  The
+   orders are kept as positions rather than pointers, so that the tables can be shared by processes
+   which have them at different addresses */
+
+#define LIN_PTR(n)              (&line[lin_idx[n]])
+#define PHOT_TOP_PTR(n)         (&phot_top[phot_top_idx[n]])
+#define INNER_CROSS_PTR(n)      (&inner_cross[inner_cross_idx[n]])
 
 
 
@@ -377,7 +492,7 @@ typedef struct inner_elec_yield
   double Ea;                    /**< Average electron energy */
 } Inner_elec_yield, Inner_elec_yieldPtr;
 
-extern Inner_elec_yield inner_elec_yield[N_INNER * NIONS];
+extern Inner_elec_yield *inner_elec_yield;
 
 /** This structure for the flourescent photon yield following inner shell ionization from Kaastra and Mewe*/
 typedef struct inner_fluor_yield
@@ -389,7 +504,7 @@ typedef struct inner_fluor_yield
   double yield;                 /**< number of photons per ionization */
 } Inner_fluor_yield, Inner_fluor_yieldPtr;
 
-extern Inner_fluor_yield inner_fluor_yield[N_INNER * NIONS];
+extern Inner_fluor_yield *inner_fluor_yield;
 
 
 
@@ -403,7 +518,7 @@ struct ground_fracs
                                    fractions must have been computed elsewhere */
 };
 
-extern struct ground_fracs ground_frac[NIONS];
+extern struct ground_fracs *ground_frac;  /**< NIONS entries */
 
 
 #define MAX_DR_PARAMS 9         //This is the maximum number of c or e parameters.
@@ -429,9 +544,9 @@ typedef struct dielectronic_recombination
 } Drecomb, *Drecombptr;
 
 
-extern Drecomb drecomb[NIONS];  //set up the actual structure
+extern Drecomb *drecomb;        //set up the actual structure, with NIONS entries
 
-extern double dr_coeffs[NIONS]; //this will be an array to temprarily store the volumetric dielectronic recombination rate coefficients for the current cell under interest. We may want to make this 2D and store the coefficients for a range of temperatures to interpolate.
+extern double dr_coeffs[NIONS]; //this will be an array to temprarily store the volumetric dielectronic recombination rate coefficients for the current cell under interest. The coefficients for a range of temperatures are tabulated in rate_tables.
 
 
 #define T_RR_PARAMS         6   //This is the number of parameters.
@@ -450,7 +565,7 @@ typedef struct total_rr
   int type;                     /**< NSH 23/7/2012 - What type of parampeters we have for this ion */
 } Total_rr, *total_rrptr;
 
-extern Total_rr total_rr[NIONS];        //Set up the structure
+extern Total_rr *total_rr;      //Set up the structure, with NIONS entries
 
 #define BAD_GS_RR_PARAMS 19     //This is the number of points in the fit.
 extern int n_bad_gs_rr;
@@ -463,7 +578,7 @@ typedef struct badnell_gs_rr
   double rates[BAD_GS_RR_PARAMS];       //rates corresponding to those temperatures
 } Bad_gs_rr, *Bad_gs_rrptr;
 
-extern Bad_gs_rr bad_gs_rr[NIONS];      //Set up the structure
+extern Bad_gs_rr *bad_gs_rr;    //Set up the structure, with NIONS entries
 
 
 #define DERE_DI_PARAMS 20       //This is the maximum number of points in the fit.
@@ -478,7 +593,7 @@ typedef struct dere_di_rate
   double min_temp;
 } Dere_di_rate, *Dere_di_rateptr;
 
-extern Dere_di_rate dere_di_rate[NIONS];        //Set up the structure
+extern Dere_di_rate *dere_di_rate;      //Set up the structure, with NIONS entries
 
 extern double di_coeffs[NIONS]; //This is an array to store the di_coeffs 
 extern double qrecomb_coeffs[NIONS];    //JM 1508 analogous array for three body recombination 
@@ -494,7 +609,7 @@ typedef struct gaunt_total
   float s1, s2, s3;
 } Gaunt_total, *Gaunt_totalptr;
 
-extern Gaunt_total gaunt_total[MAX_GAUNT_N_GSQRD];      //Set up the structure
+extern Gaunt_total *gaunt_total;        //Set up the structure, with MAX_GAUNT_N_GSQRD entries
 
 
 
@@ -514,14 +629,116 @@ typedef struct charge_exchange
 
 } Charge_exchange, *Charge_exchange_ptr;
 
-extern Charge_exchange charge_exchange[MAX_CHARGE_EXCHANGE];    //Set up the structure
+extern Charge_exchange *charge_exchange;        //Set up the structure, with MAX_CHARGE_EXCHANGE entries
 
 extern double charge_exchange_recomb_rates[NIONS];      //An array to store the actual recombination rates for a given temperature - 
 //there is an estimated rate for ions without an actual rate, so we need to dimneions for ions.
 extern double charge_exchange_ioniz_rates[MAX_CHARGE_EXCHANGE]; //An array to store the actual ionization rates for a given temperature
 
 
+/**
+  * Tables of the rate coefficients which are given as fits in the atomic data
+  *
+  * Each fit is evaluated by build_rate_tables at ntemps temperatures evenly
+  * spaced in log(T), and rate_table_values then interpolates in the tables
+  * for the temperatures of many cells at once.  There is a row of ntemps
+  * values for each ion (or, for charge exchange, each record), so rate[type]
+  * [n * ntemps + k] is the rate for ion n at the k'th temperature.
+  */
+
+#define RATE_DR          0      /**< Dielectronic recombination, from drecomb */
+#define RATE_TOTAL_RR    1      /**< Total radiative recombination, from total_rr */
+#define RATE_GS_RR       2      /**< Ground state radiative recombination, from bad_gs_rr */
+#define RATE_DI          3      /**< Direct (collisional) ionization, from dere_di_rate */
+#define RATE_CH_EX       4      /**< Charge exchange, from charge_exchange, by record rather than ion */
+#define NRATE_TYPES      5
+
+#define RATE_TABLE_TMIN 1.0e3   /**< The default range and size of the tables */
+#define RATE_TABLE_TMAX 1.0e8
+#define RATE_TABLE_NTEMPS 1001
+
+typedef struct rate_tables
+{
+  int ntemps;                   /**< The number of temperatures in each table, 0 if the tables have not been built */
+  double log_t_min, log_t_max;  /**< The log of the first and last temperatures */
+  double scale;                 /**< The number of intervals per unit of log(T) */
+  int nrows[NRATE_TYPES];       /**< The number of rows in each table, nions or n_charge_exchange */
+  double *rate[NRATE_TYPES];    /**< The tables, nrows[type] * ntemps values each */
+} Rate_tables;
+
+extern Rate_tables rate_tables;
+
+
+/* Which processes share the tables of atomic data, see shared_alloc.c */
+
+#define SHARED_PRIVATE   0      /**< Each process has its own copy of the tables */
+#define SHARED_NODE      1      /**< The processes on a node share one copy, in MPI shared memory windows */
+#define SHARED_NUMA      2      /**< The processes in each NUMA domain of a node share one copy */
+#define SHARED_POSIX     3      /**< Independent processes share one copy, in a POSIX shared memory segment */
+#define SHARED_BCAST     16     /**< Added to SHARED_NODE or SHARED_NUMA, only rank 0 reads the data and sends it to each node */
+
+
 
 /* a variable which controls whether to save a summary of atomic data
    this is defined in atomic.h, rather than the modes structure */
 extern int write_atomicdata;
+
+
+/** Atomic_file holds the complete contents of one of the atomic data files, which are read
+  * into memory in a single operation and then parsed line by line from the buffer
+  */
+
+typedef struct atomic_file
+{
+  char *buf;                    /**< The contents of the file, terminated by a NUL */
+  char *next;                   /**< The start of the next line to be returned */
+  char *end;                    /**< The end of the contents of the file */
+} Atomic_file, *AtomicFilePtr;
+
+
+/** The atomic data files are parsed in two phases.  In the first, each file named in the masterfile
+  * is read and broken into records, with the bulkiest records (lines and photoionization x-sections)
+  * parsed into the structures below.  This can be done for all of the files in parallel. In the
+  * second phase the records are applied to the atomic data structures one at a time, in the order
+  * they appear in the masterfile, so that all of the rules about what must be read first still apply.
+  */
+
+extern int atomicdata_nthreads;         /**< The number of threads used to parse the atomic data files; if
+                                           0 or less, it is chosen by atomicdata_thread_count */
+extern int atomicdata_node_readers;     /**< The number of processes on this node which read the atomic data,
+                                           set by shared_init, or 0 if this is not known */
+
+typedef struct line_record
+{
+  int nwords;                   /**< The number of fields read from the record */
+  int z, istate;                /**< Atomic number and ionization state of the line */
+  double wave, f;               /**< Wavelength in Angstroms and the oscillator strength */
+  double gl, gu;                /**< Multiplicities of the lower and upper level */
+  double el, eu;                /**< Energies of the lower and upper level in eV */
+  int levl, levu;               /**< Indices of the lower and upper level */
+} Line_record, *LineRecordPtr;
+
+typedef struct atomic_record
+{
+  char *line;                   /**< The record itself, as read from the file */
+  char *extra[2];               /**< Continuation lines which belong to Auger and collision strength records */
+  int nextra;                   /**< The number of continuation lines which were found */
+  int lineno;                   /**< The line number of the record in the file, counted as get_atomic_data always has */
+  char choice;                  /**< The type of record, or '*' if the record continues the previous type */
+  char type;                    /**< The type the record was parsed as; '?' for a continuation at the start of a file */
+  int np;                       /**< The number of x-section points found after a photoionization or inner shell record */
+  int index;                    /**< The first x-section point, or the parsed line data, of the record, -1 if there is none */
+} Atomic_record, *AtomicRecordPtr;
+
+typedef struct atomic_data_file
+{
+  char *name;                   /**< The name of the file, as given in the masterfile */
+  int status;                   /**< 0 if the file was read and parsed, 1 if it could not be read, 2 if memory ran out */
+  Atomic_file contents;         /**< The contents of the file, to which the records point */
+  Atomic_record *record;        /**< The records in the order they appear in the file */
+  int nrecords, nrecords_max;
+  Line_record *lines;           /**< Parsed line records */
+  int nline_records, nline_records_max;
+  double *xe, *xx;              /**< Parsed x-section points, energy in eV and cross-section in cm**2 */
+  int npoints, npoints_max;
+} Atomic_data_file, *AtomicDataFilePtr;
@@ -3,15 +3,69 @@ int get_atomic_data(char masterfile[]);
 /* atomicdata_sub.c */
 int atomicdata2file(void);
 int index_lines(void);
+int build_line_view(void);
 int index_phot_top(void);
 int index_inner_cross(void);
 void indexx(int n, float arrin[], int indx[]);
+int line_view_bucket(double freq);
+int line_view_search(double freq, int upper);
 int limit_lines(double freqmin, double freqmax);
+int limit_lines_batch(int nwindows, double freqmin[], double freqmax[], int line_min[], int line_max[], int line_delt[]);
 int check_xsections(void);
+int line_coefficients(struct lines *line_ptr);
 double q21(struct lines *line_ptr, double t);
 double q12(struct lines *line_ptr, double t);
 double a21(struct lines *line_ptr);
+int line_rates(double t, double q21_rate[], double q12_rate[], double a21_rate[]);
 double upsilon(int n_coll, double u0);
+int build_upsilon_table(int n_coll, double freq, double tmin, double tmax, double max_error);
+int build_upsilon_tables(double tmin, double tmax, double max_error);
+double tabulated_upsilon(int n_coll, double u0);
 void skiplines(FILE *fptr, int nskip);
+int atomic_file_open(char *filename, Atomic_file *afile);
+int atomic_file_next_line(Atomic_file *afile, char **line);
+void atomic_file_close(Atomic_file *afile);
+int xsection_pool_init(int npoints);
+int xsection_pool_add(Topbase_phot *xptr, int np, double xe[], double xx[]);
+int xsection_pool_compact(void);
+int jump_list_init(Jump_list *list, char *name);
+int jump_list_add(Jump_list *list, int nconfig, int njump);
+int jump_list_build(Jump_list *list, int nconfigs);
+/* atomicdata_parse.c */
+char atomic_record_type(char *word);
+int parse_line_record(char *aline, char *word, Line_record *lrec);
+int parse_atomic_file(Atomic_data_file *dfile);
+int atomicdata_thread_count(void);
+int parse_atomic_files(Atomic_data_file dfiles[], int nfiles);
+void free_atomic_data_file(Atomic_data_file *dfile);
+int count_atomic_records(Atomic_data_file dfiles[], int nfiles, Atomic_sizes *sizes);
+/* atomicdata_sort.c */
+int index_by_key(int n, double key[], int index[]);
 /* atomicdata_init.c */
 int init_atomic_data(void);
+/* atomicdata_share.c */
+int share_atomic_data(void);
+int release_atomic_data(void);
+int atomic_data_fingerprint(char *masterfile, char *key, int size);
+/* rate_tables.c */
+double rate_fit(int type, int n, double t);
+int build_rate_tables(double tmin, double tmax, int ntemps);
+int rate_table_values(int type, int ncells, double t_e[], double rates[]);
+/* shared_alloc.c */
+int shared_init(int mode);
+int shared_init_posix(char *key);
+int shared_get_mode(void);
+int shared_loader(void);
+int shared_nprocs(void);
+void *shared_calloc(char *name, size_t count, size_t size);
+void *shared_realloc(void *ptr, size_t count, size_t size);
+void shared_free(void *ptr);
+int shared_publish(void);
+void *shared_lookup(char *name);
+int shared_bcast(void *buf, int size);
+int shared_release(void);
+/* shared_reduce.c */
+int shared_reduce_init(int nprocs, int n);
+double *shared_reduce_slice(void);
+double *shared_reduce_sum(void);
+int shared_reduce_free(void);
@@ -20,4 +20,6 @@ double integrate_trap(double (*integrand)(double, void *), void *params, double
 double integrate_simp(double (*integrand)(double, void *), void *params, double lower_bound, double upper_bound,
                       double rel_tol);
 
+extern __thread long alpha_sp_evaluations;
+
 #endif//NUM_INT_INTEGRATE_H
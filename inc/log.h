@@ -1,3 +1,6 @@
+#ifndef LOG_H
+#define LOG_H
+
 /* rdpar.c */
 int opar(char filename[]);
 int add_par(char filename[]);
@@ -20,6 +23,7 @@ int string2int(char *word, char *string_choices, char *string_values, char *stri
 int rdchoice(char question[], char answers[], char *answer);
 int get_root(char root[], char total[]);
 int rdpar_set_mpi_rank(int rank);
+int rdpar_set_broadcast(int broadcast);
 int rdpar_set_verbose(int vlevel);
 int rdpar_check(void);
 /* xlog.c */
@@ -43,7 +47,64 @@ int Log_set_mpi_rank(int rank, int n_mpi);
 int Log_parallel(char *format, ...);
 int Debug(char *format, ...);
 void Exit(int error_code);
+/* trace.c */
+int Trace_init(char *filename);
+int Trace_begin(const char *name);
+int Trace_end(const char *name);
+int Trace_write(void);
 /* synonyms.c */
 int get_question_name_length(char question[]);
 int are_synonym_lists_valid(void);
 int is_input_line_synonym_for_question(char question[], char input_line[]);
+int synonyms_for_input_line(char input_line[], int synonyms[]);
+int synonyms_for_question(char question[], int synonyms[]);
+
+/* The rest of this file, and the guard around it, are not made by cproto,
+   and need to be kept if the prototypes above are remade.  Since Debug and
+   Log_silent become macros here, any other prototypes for them, as in
+   templates.h, have to come before this file is included. */
+
+/* definitions of what is logged at what verbosity level */
+
+#define SHOW_PARALLEL	    1
+#define SHOW_ERROR	    2
+#define SHOW_LOG  	    3
+#define SHOW_DEBUG	    4
+#define SHOW_LOG_SILENT     5
+#define SHOW_ERROR_SILENT   5
+
+/* Debug and Log_silent calls whose level is above LOG_MAX_VERBOSITY are
+   removed when the program is compiled, e.g. with -DLOG_MAX_VERBOSITY=3:
+   their arguments are still checked by the compiler, but are never
+   evaluated, and the calls have no value.  Those which are compiled in
+   only call the function, and so only evaluate their arguments, if the
+   verbosity set at run time would show them.  Log_silent is also called
+   if the diag file has not been opened, since it opens the file. */
+
+#ifndef LOG_MAX_VERBOSITY
+#define LOG_MAX_VERBOSITY   SHOW_ERROR_SILENT
+#endif
+
+extern int log_verbosity;
+extern int init_log;
+
+#if LOG_MAX_VERBOSITY >= SHOW_DEBUG
+#define Debug(...) (log_verbosity >= SHOW_DEBUG ? (Debug) (__VA_ARGS__) : 0)
+#else
+#define Debug(...) ((void) sizeof ((Debug) (__VA_ARGS__)))
+#endif
+
+#if LOG_MAX_VERBOSITY >= SHOW_LOG_SILENT
+#define Log_silent(...) ((log_verbosity >= SHOW_LOG_SILENT || init_log == 0) ? (Log_silent) (__VA_ARGS__) : 0)
+#else
+#define Log_silent(...) ((void) sizeof ((Log_silent) (__VA_ARGS__)))
+#endif
+
+/* Tracing costs no more than checking trace_enabled while it is off */
+
+extern int trace_enabled;
+
+#define Trace_begin(name) (trace_enabled ? (Trace_begin) (name) : 0)
+#define Trace_end(name) (trace_enabled ? (Trace_end) (name) : 0)
+
+#endif
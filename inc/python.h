@@ -1136,7 +1136,7 @@ typedef struct macro
   double *jbar; /**<  This will store the Sobolev mean intensity in transitions which is needed
      for Macro Atom jumping probabilities. The indexing is by configuration (the
      NLTE_LEVELS) and then by the upward bound-bound jumps from that level
-     (the NBBJUMPS) (SS) */
+     (the bbu_jumps) (SS) */
 
   double *jbar_old;
 
@@ -1790,9 +1790,9 @@ extern struct Import *imported_model;   // MAX_DOM is defined in python.h and as
 /* the functions contained in log., rdpar.c and lineio.c are
    declare separately from templates. This is because some functions
    only use log.h and don't use python.h due to repeated definitions */
-#include "log.h"
 #include "version.h"
 #include "templates.h"
+#include "log.h"
 
 /* We're going to keep the matrix GPU functions seperate from the other templates */
 #ifdef CUDA_ON
@@ -10,6 +10,10 @@ int randwind_thermal_trapping(PhotPtr p, int *nnscat);
 int get_atomic_data(char masterfile[]);
 /* atomicdata_init.c */
 int init_atomic_data(void);
+/* atomicdata_share.c */
+int share_atomic_data(void);
+int release_atomic_data(void);
+int atomic_data_fingerprint(char *masterfile, char *key, int size);
 /* atomicdata_sub.c */
 int atomicdata2file(void);
 int index_lines(void);
@@ -17,11 +21,17 @@ int index_phot_top(void);
 int index_inner_cross(void);
 void indexx(int n, float arrin[], int indx[]);
 int limit_lines(double freqmin, double freqmax);
+int limit_lines_batch(int nwindows, double freqmin[], double freqmax[], int line_min[], int line_max[], int line_delt[]);
 int check_xsections(void);
+int line_coefficients(struct lines *line_ptr);
 double q21(struct lines *line_ptr, double t);
 double q12(struct lines *line_ptr, double t);
 double a21(struct lines *line_ptr);
+int line_rates(double t, double q21_rate[], double q12_rate[], double a21_rate[]);
 double upsilon(int n_coll, double u0);
+int build_upsilon_table(int n_coll, double freq, double tmin, double tmax, double max_error);
+int build_upsilon_tables(double tmin, double tmax, double max_error);
+double tabulated_upsilon(int n_coll, double u0);
 void skiplines(FILE *fptr, int nskip);
 /* bands.c */
 int bands_init(int imode, struct xbands *band);
@@ -441,6 +451,10 @@ void init_rng_directory(char *root, int rank);
 void save_gsl_rng_state(void);
 void reload_gsl_rng_state(void);
 double random_number(double min, double max);
+/* rate_tables.c */
+double rate_fit(int type, int n, double t);
+int build_rate_tables(double tmin, double tmax, int ntemps);
+int rate_table_values(int type, int ncells, double t_e[], double rates[]);
 /* rdpar.c */
 int opar(char filename[]);
 int add_par(char filename[]);
@@ -463,6 +477,7 @@ int string2int(char *word, char *string_choices, char *string_values, char *stri
 int rdchoice(char question[], char answers[], char *answer);
 int get_root(char root[], char total[]);
 int rdpar_set_mpi_rank(int rank);
+int rdpar_set_broadcast(int broadcast);
 int rdpar_set_verbose(int vlevel);
 int rdpar_check(void);
 /* rdpar_init.c */
@@ -563,6 +578,24 @@ int get_meta_params(void);
 /* setup_star_bh.c */
 double get_stellar_params(void);
 int get_bl_and_agn_params(double lstar);
+/* shared_alloc.c */
+int shared_init(int mode);
+int shared_init_posix(char *key);
+int shared_get_mode(void);
+int shared_loader(void);
+int shared_nprocs(void);
+void *shared_calloc(char *name, size_t count, size_t size);
+void *shared_realloc(void *ptr, size_t count, size_t size);
+void shared_free(void *ptr);
+int shared_publish(void);
+void *shared_lookup(char *name);
+int shared_bcast(void *buf, int size);
+int shared_release(void);
+/* shared_reduce.c */
+int shared_reduce_init(int nprocs, int n);
+double *shared_reduce_slice(void);
+double *shared_reduce_sum(void);
+int shared_reduce_free(void);
 /* shell_wind.c */
 int get_shell_wind_params(int ndom);
 int shell_make_grid(int ndom, WindPtr w);
@@ -616,6 +649,8 @@ double sv_wind_mdot_integral(double r, void *params);
 int get_question_name_length(char question[]);
 int are_synonym_lists_valid(void);
 int is_input_line_synonym_for_question(char question[], char input_line[]);
+int synonyms_for_input_line(char input_line[], int synonyms[]);
+int synonyms_for_question(char question[], int synonyms[]);
 /* time.c */
 double timer(void);
 int get_time(char curtime[]);
@@ -0,0 +1,469 @@
+//
+// Benchmarks for the layout of the atomic data
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "atomic.h"
+#include "python.h"
+
+#define NUM_WINDOWS 100000
+#define NUM_REPEATS 20
+
+//
+// Print the results for a benchmark run, with the sum used to check that both
+// layouts did the same work
+//
+void print_bench_results(const char *name, const double time, const double sum, const double expected) {
+  const double error = (expected != 0.0) ? fabs((sum - expected) / expected) : 0.0;
+  printf("%-24s : %-12.6f seconds : fractional difference %5e\n", name, time, error);
+}
+
+//
+// Pick line windows with centres spread evenly in log frequency over the line
+// list, and record the range of lines which fall in each. The width is the
+// fractional width of the window, e.g. v/c for a resonance search
+//
+int make_line_windows(const double width, int *window_min, int *window_max) {
+  const double log_freq_min = log(line_view.freq[0]);
+  const double log_freq_max = log(line_view.freq[nlines - 1]);
+  int total = 0;
+
+  srand48(42);
+  for (int i = 0; i < NUM_WINDOWS; ++i) {
+    const double freq = exp(log_freq_min + drand48() * (log_freq_max - log_freq_min));
+    if (limit_lines(freq * (1.0 - width), freq * (1.0 + width)) > 0) {
+      window_min[i] = nline_min;
+      window_max[i] = nline_max;
+      total += nline_delt;
+    } else {
+      window_min[i] = 0;
+      window_max[i] = -1;
+    }
+  }
+
+  return total;
+}
+
+//
+// Sum gf over the lines in each window by going through LIN_PTR to each line
+// structure
+//
+double sum_windows_aos(const int *window_min, const int *window_max, double *time) {
+  double sum = 0.0;
+
+  const clock_t start_time = clock();
+  for (int r = 0; r < NUM_REPEATS; ++r) {
+    for (int i = 0; i < NUM_WINDOWS; ++i) {
+      for (int n = window_min[i]; n <= window_max[i]; ++n) { sum += LIN_PTR(n)->gl * LIN_PTR(n)->f; }
+    }
+  }
+  *time = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  return sum;
+}
+
+//
+// Sum gf over the lines in each window using the arrays in line_view
+//
+double sum_windows_soa(const int *window_min, const int *window_max, double *time) {
+  const double *gl = line_view.gl;
+  const double *f = line_view.f;
+  double sum = 0.0;
+
+  const clock_t start_time = clock();
+  for (int r = 0; r < NUM_REPEATS; ++r) {
+    for (int i = 0; i < NUM_WINDOWS; ++i) {
+      for (int n = window_min[i]; n <= window_max[i]; ++n) { sum += gl[n] * f[n]; }
+    }
+  }
+  *time = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  return sum;
+}
+
+//
+// Compare line window sums over the line structures and the line view, for
+// narrow windows like those in resonance searches and wide ones like those for
+// band limited luminosities
+//
+void line_window_benchmark(void) {
+  const double widths[] = {1e-4, 1e-2, 1e-1};
+  const int num_widths = sizeof(widths) / sizeof(widths[0]);
+
+  int *window_min = malloc(NUM_WINDOWS * sizeof(int));
+  int *window_max = malloc(NUM_WINDOWS * sizeof(int));
+  if (window_min == NULL || window_max == NULL) {
+    perror("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Line windows: %d lines, %d windows, %d repeats\n", nlines, NUM_WINDOWS, NUM_REPEATS);
+  for (int w = 0; w < num_widths; ++w) {
+    const int total = make_line_windows(widths[w], window_min, window_max);
+    printf("Width %.0e: average of %.1f lines per window\n", widths[w], (double) total / NUM_WINDOWS);
+
+    double time_aos, time_soa;
+    const double sum_aos = sum_windows_aos(window_min, window_max, &time_aos);
+    const double sum_soa = sum_windows_soa(window_min, window_max, &time_soa);
+    print_bench_results("LIN_PTR (AoS)", time_aos, sum_aos, sum_aos);
+    print_bench_results("line_view (SoA)", time_soa, sum_soa, sum_aos);
+  }
+
+  free(window_min);
+  free(window_max);
+}
+
+//
+// Find the lines in a window by bisecting the whole line list, which is how
+// limit_lines worked before the buckets were added
+//
+int limit_lines_bisect(const double freq_min, const double freq_max, int *line_min, int *line_max) {
+  const double *freq = line_view.freq;
+
+  if (freq_min > freq[nlines - 1] || freq_max < freq[0]) {
+    *line_min = *line_max = 0;
+    return 0;
+  }
+
+  int lo = 0, hi = nlines;
+  while (lo < hi) {
+    const int mid = (lo + hi) >> 1;
+    if (freq[mid] < freq_min) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  *line_min = (lo > 0) ? lo - 1 : 0;
+
+  lo = 0;
+  hi = nlines;
+  while (lo < hi) {
+    const int mid = (lo + hi) >> 1;
+    if (freq[mid] <= freq_max) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  *line_max = (lo < nlines - 1) ? lo : nlines - 1;
+
+  return *line_max - *line_min + 1;
+}
+
+//
+// Compare the time to find the lines in many windows by bisection, by
+// limit_lines one window at a time, and by limit_lines_batch
+//
+void line_lookup_benchmark(void) {
+  const double log_freq_min = log(line_view.freq[0]);
+  const double log_freq_max = log(line_view.freq[nlines - 1]);
+
+  double *freq_min = malloc(NUM_WINDOWS * sizeof(double));
+  double *freq_max = malloc(NUM_WINDOWS * sizeof(double));
+  int *line_min = malloc(NUM_WINDOWS * sizeof(int));
+  int *line_max = malloc(NUM_WINDOWS * sizeof(int));
+  int *line_delt = malloc(NUM_WINDOWS * sizeof(int));
+  if (freq_min == NULL || freq_max == NULL || line_min == NULL || line_max == NULL || line_delt == NULL) {
+    perror("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+
+  srand48(42);
+  for (int i = 0; i < NUM_WINDOWS; ++i) {
+    const double freq = exp(log_freq_min + drand48() * (log_freq_max - log_freq_min));
+    freq_min[i] = freq * (1.0 - 1e-4);
+    freq_max[i] = freq * (1.0 + 1e-4);
+  }
+
+  printf("Line lookup: %d lines, %d buckets, %d windows, %d repeats\n", nlines, line_view.nbuckets, NUM_WINDOWS,
+         NUM_REPEATS);
+
+  double sum_bisect = 0.0;
+  clock_t start_time = clock();
+  for (int r = 0; r < NUM_REPEATS; ++r) {
+    for (int i = 0; i < NUM_WINDOWS; ++i) {
+      int lmin, lmax;
+      sum_bisect += limit_lines_bisect(freq_min[i], freq_max[i], &lmin, &lmax);
+    }
+  }
+  const double time_bisect = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  double sum_buckets = 0.0;
+  start_time = clock();
+  for (int r = 0; r < NUM_REPEATS; ++r) {
+    for (int i = 0; i < NUM_WINDOWS; ++i) { sum_buckets += limit_lines(freq_min[i], freq_max[i]); }
+  }
+  const double time_buckets = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  double sum_batch = 0.0;
+  start_time = clock();
+  for (int r = 0; r < NUM_REPEATS; ++r) {
+    sum_batch += limit_lines_batch(NUM_WINDOWS, freq_min, freq_max, line_min, line_max, line_delt);
+  }
+  const double time_batch = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  print_bench_results("bisection", time_bisect, sum_bisect, sum_bisect);
+  print_bench_results("limit_lines", time_buckets, sum_buckets, sum_bisect);
+  print_bench_results("limit_lines_batch", time_batch, sum_batch, sum_bisect);
+
+  free(freq_min);
+  free(freq_max);
+  free(line_min);
+  free(line_max);
+  free(line_delt);
+}
+
+//
+// Read in test temperatures from file
+//
+void load_temperatures(const char *filename, double **temperature_array, int *num_elements) {
+  FILE *file = fopen(filename, "r");
+  if (!file) {
+    perror("Error opening file");
+    exit(EXIT_FAILURE);
+  }
+
+  int count = 0;
+  double temperature;
+  while (fscanf(file, "%lf", &temperature) == 1) { count++; }
+
+  *temperature_array = malloc(count * sizeof(double));
+  if ((*temperature_array) == NULL) {
+    fclose(file);
+    perror("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+
+  fseek(file, 0, SEEK_SET);
+  for (int i = 0; i < count; ++i) {
+    if (fscanf(file, "%lf", &(*temperature_array)[i]) != 1) {
+      fclose(file);
+      free(*temperature_array);
+      perror("Error reading temperature");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  fclose(file);
+  *num_elements = count;
+}
+
+//
+// Sum upsilon for every collision strength record at every temperature, either
+// calculating it each time or interpolating in the tables
+//
+double sum_upsilon(const int *coll_index, const double *coll_freq, const int num_coll, const double *temperatures,
+                   const int num_temperatures, double (*upsilon_function)(int, double), double *worst_error,
+                   double *time) {
+  double sum = 0.0;
+
+  *worst_error = 0.0;
+  const clock_t start_time = clock();
+  for (int i = 0; i < num_temperatures; ++i) {
+    for (int j = 0; j < num_coll; ++j) {
+      const double u0 = BOLTZMANN * temperatures[i] / (PLANCK * coll_freq[j]);
+      sum += upsilon_function(coll_index[j], u0);
+    }
+  }
+  *time = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  for (int i = 0; i < num_temperatures; ++i) {
+    for (int j = 0; j < num_coll; ++j) {
+      const double u0 = BOLTZMANN * temperatures[i] / (PLANCK * coll_freq[j]);
+      const double exact = upsilon(coll_index[j], u0);
+      const double error = (exact != 0.0) ? fabs((upsilon_function(coll_index[j], u0) - exact) / exact) : 0.0;
+      if (error > *worst_error) { *worst_error = error; }
+    }
+  }
+
+  return sum;
+}
+
+//
+// Compare calculating the Burgess and Tully collision strengths each time with
+// interpolating in the tables made by build_upsilon_tables
+//
+void upsilon_benchmark(const char *temperature_file) {
+  int num_temperatures;
+  double *temperatures;
+
+  load_temperatures(temperature_file, &temperatures, &num_temperatures);
+
+  int *coll_index = calloc(n_coll_stren, sizeof(int));
+  double *coll_freq = calloc(n_coll_stren, sizeof(double));
+  if (coll_index == NULL || coll_freq == NULL) {
+    perror("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+
+  int num_coll = 0;
+  for (int n = 0; n < nlines; ++n) {
+    if (line[n].coll_index >= 0) {
+      coll_index[num_coll] = line[n].coll_index;
+      coll_freq[num_coll] = line[n].freq;
+      num_coll++;
+    }
+  }
+
+  printf("Collision strengths: %d records, %d temperatures\n", num_coll, num_temperatures);
+
+  double time_exact, error_exact;
+  const double sum_exact =
+      sum_upsilon(coll_index, coll_freq, num_coll, temperatures, num_temperatures, upsilon, &error_exact, &time_exact);
+
+  const clock_t start_time = clock();
+  const int num_points = build_upsilon_tables(UPSILON_TABLE_TMIN, UPSILON_TABLE_TMAX, UPSILON_TABLE_ERROR);
+  const double time_build = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  double time_table, error_table;
+  const double sum_table = sum_upsilon(coll_index, coll_freq, num_coll, temperatures, num_temperatures,
+                                       tabulated_upsilon, &error_table, &time_table);
+
+  printf("Tables from %.0e to %.0e K: %d points, %.1f per record, built in %f seconds\n", UPSILON_TABLE_TMIN,
+         UPSILON_TABLE_TMAX, num_points, (double) num_points / (num_coll > 0 ? num_coll : 1), time_build);
+  print_bench_results("upsilon", time_exact, sum_exact, sum_exact);
+  print_bench_results("tabulated_upsilon", time_table, sum_table, sum_exact);
+  printf("Largest fractional error of tabulated_upsilon %5e (target %5e)\n", error_table, UPSILON_TABLE_ERROR);
+
+  free(temperatures);
+  free(coll_index);
+  free(coll_freq);
+}
+
+//
+// Compare evaluating the fits for the recombination, ionization and charge
+// exchange rates of every ion in every cell with interpolating in the tables
+// made by build_rate_tables, taking each test temperature as a cell
+//
+void rate_table_benchmark(const char *temperature_file) {
+  const char *names[NRATE_TYPES] = {"DR", "total RR", "ground state RR", "DI", "charge exchange"};
+  int num_cells;
+  double *t_e;
+
+  load_temperatures(temperature_file, &t_e, &num_cells);
+
+  const int max_rows = (nions > n_charge_exchange) ? nions : n_charge_exchange;
+  double *exact = calloc((size_t) max_rows * num_cells, sizeof(double));
+  double *table = calloc((size_t) max_rows * num_cells, sizeof(double));
+  if (exact == NULL || table == NULL) {
+    perror("Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+
+  const clock_t build_start = clock();
+  build_rate_tables(RATE_TABLE_TMIN, RATE_TABLE_TMAX, RATE_TABLE_NTEMPS);
+  const double time_build = ((double) (clock() - build_start)) / CLOCKS_PER_SEC;
+
+  printf("Rate tables: %d ions, %d cells, %d temperatures from %.0e to %.0e K built in %f seconds\n", nions, num_cells,
+         RATE_TABLE_NTEMPS, RATE_TABLE_TMIN, RATE_TABLE_TMAX, time_build);
+
+  for (int type = 0; type < NRATE_TYPES; ++type) {
+    const int num_rows = (type == RATE_CH_EX) ? n_charge_exchange : nions;
+
+    double sum_exact = 0.0;
+    clock_t start_time = clock();
+    for (int r = 0; r < NUM_REPEATS; ++r) {
+      for (int n = 0; n < num_rows; ++n) {
+        for (int i = 0; i < num_cells; ++i) { exact[n * num_cells + i] = rate_fit(type, n, t_e[i]); }
+      }
+      for (int i = 0; i < num_rows * num_cells; ++i) { sum_exact += exact[i]; }
+    }
+    const double time_exact = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+    double sum_table = 0.0;
+    start_time = clock();
+    for (int r = 0; r < NUM_REPEATS; ++r) {
+      rate_table_values(type, num_cells, t_e, table);
+      for (int i = 0; i < num_rows * num_cells; ++i) { sum_table += table[i]; }
+    }
+    const double time_table = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+    // A rate which is not finite is as wrong as it can be, and would otherwise
+    // never compare greater than the largest error
+    double worst_error = 0.0;
+    int num_not_finite = 0;
+    for (int i = 0; i < num_rows * num_cells; ++i) {
+      if (!isfinite(exact[i]) || !isfinite(table[i])) {
+        num_not_finite++;
+        worst_error = INFINITY;
+        continue;
+      }
+      const double error = (exact[i] != 0.0) ? fabs((table[i] - exact[i]) / exact[i]) : fabs(table[i]);
+      if (error > worst_error) { worst_error = error; }
+    }
+
+    printf("%s: %d rows, largest fractional error %5e\n", names[type], num_rows, worst_error);
+    if (num_not_finite > 0) {
+      printf("%s: %d of %d rates are not finite\n", names[type], num_not_finite, num_rows * num_cells);
+    }
+    print_bench_results("rate_fit", time_exact, sum_exact, sum_exact);
+    print_bench_results("rate_table_values", time_table, sum_table, sum_exact);
+  }
+
+  free(t_e);
+  free(exact);
+  free(table);
+}
+
+//
+// Time many Debug calls which the verbosity does not show, calling the function
+// each time as every call did before Debug became a macro, and through the
+// macro, which checks the verbosity first or, with -DLOG_MAX_VERBOSITY=3,
+// removes the call altogether
+//
+void log_call_benchmark(void) {
+  const int num_calls = NUM_WINDOWS * NUM_REPEATS;
+  volatile int line_index = 0;
+
+  Log_set_verbosity(SHOW_ERROR);
+
+  clock_t start_time = clock();
+  for (int i = 0; i < num_calls; ++i) {
+    (Debug)("log_call_benchmark: line %d has frequency %e\n", i, line[line_index].freq);
+  }
+  const double time_function = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  start_time = clock();
+  for (int i = 0; i < num_calls; ++i) {
+    Debug("log_call_benchmark: line %d has frequency %e\n", i, line[line_index].freq);
+  }
+  const double time_macro = ((double) (clock() - start_time)) / CLOCKS_PER_SEC;
+
+  printf("Log calls: %d Debug calls not shown, %f seconds calling the function, %f seconds with Debug %s\n",
+         num_calls, time_function, time_macro, (LOG_MAX_VERBOSITY >= SHOW_DEBUG) ? "compiled in" : "compiled out");
+}
+
+//
+// Main function of the program
+//
+int main(int argc, char **argv) {
+  char *masterfile = (argc > 1) ? argv[1] : "data/h10_hetop_standard80.dat";
+  char *temperature_file = (argc > 2) ? argv[2] : "test-temperatures.txt";
+
+  struct timespec load_start, load_end;
+
+  Trace_init(getenv("TRACE_FILE"));
+  Log_set_verbosity(SHOW_LOG);
+  clock_gettime(CLOCK_MONOTONIC, &load_start);
+  get_atomic_data(masterfile);
+  clock_gettime(CLOCK_MONOTONIC, &load_end);
+  Log_set_verbosity(SHOW_ERROR);
+
+  printf("Loaded %s in %f seconds with LOG_MAX_VERBOSITY %d\n", masterfile,
+         (load_end.tv_sec - load_start.tv_sec) + 1e-9 * (load_end.tv_nsec - load_start.tv_nsec), LOG_MAX_VERBOSITY);
+
+  if (nlines > 0) {
+    line_window_benchmark();
+    line_lookup_benchmark();
+  }
+  if (n_coll_stren > 0) { upsilon_benchmark(temperature_file); }
+  if (nions > 0) { rate_table_benchmark(temperature_file); }
+  if (nlines > 0) { log_call_benchmark(); }
+
+  return EXIT_SUCCESS;
+}
@@ -1,13 +1,431 @@
+#include "gsl/gsl_errno.h"
+#include <malloc.h>
+#include <math.h>
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include <atomic.h>
+#include <integrate.h>
 #include <python.h>
 
-int main(void) {
-  MPI_Init(NULL, NULL);
+//
+// The copies of the atomic data which are compared by the layout benchmark
+//
+struct layout {
+  const char *name;
+  int mode;
+};
+
+static const struct layout LAYOUTS[] = {
+    {"private", SHARED_PRIVATE},
+    {"numa", SHARED_NUMA},
+    {"node", SHARED_NODE},
+};
+#define NUM_LAYOUTS ((int) (sizeof(LAYOUTS) / sizeof(LAYOUTS[0])))
+
+#define NUM_WINDOWS 200000
+#define NUM_ALPHA_SP_TEMPERATURES 4
+
+//
+// Find the mode of shared_init for the name of a layout
+//
+static int layout_mode(const char *name) {
+  for (int i = 0; i < NUM_LAYOUTS; ++i) {
+    if (strcmp(name, LAYOUTS[i].name) == 0) { return LAYOUTS[i].mode; }
+  }
+  if (strcmp(name, "bcast") == 0) { return SHARED_NODE | SHARED_BCAST; }
+  fprintf(stderr, "Unknown layout %s: use private, numa, node or bcast\n", name);
+  MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  return SHARED_PRIVATE;
+}
+
+//
+// Time the lookup of the lines in many narrow frequency windows with
+// limit_lines, returning the number of lines found so the work is not removed
+//
+static double time_limit_lines(long *nfound) {
+  const double log_fmin = log(line_view.freq[0]);
+  const double log_fmax = log(line_view.freq[nlines - 1]);
+  unsigned int seed = 1;
+  long found = 0;
+
+  const double start = MPI_Wtime();
+  for (int i = 0; i < NUM_WINDOWS; ++i) {
+    seed = 1664525u * seed + 1013904223u;
+    const double fmin = exp(log_fmin + (log_fmax - log_fmin) * (seed / 4294967296.0));
+    if (limit_lines(fmin, 1.001 * fmin) > 0) { found += nline_delt; }
+  }
+  const double time = MPI_Wtime() - start;
+
+  *nfound = found;
+  return time;
+}
+
+//
+// Time alpha_sp for every bound-free jump of the macro atom levels, at a few
+// temperatures, returning the number of calls and the sum of the results
+//
+static double time_alpha_sp(long *ncalls, double *sum) {
+  const double temperatures[NUM_ALPHA_SP_TEMPERATURES] = {5.0e3, 1.0e4, 3.0e4, 1.0e5};
+  long calls = 0;
+  double total = 0.0;
+
+  const double start = MPI_Wtime();
+  for (int i = 0; i < NUM_ALPHA_SP_TEMPERATURES; ++i) {
+    for (int j = 0; j < nlevels_macro; ++j) {
+      const int *bfd_jump = &bfd_jumps.jump[bfd_jumps.offset[j]];
+      for (int k = 0; k < xconfig[j].n_bfd_jump; ++k) {
+        total += alpha_sp(&phot_top[bfd_jump[k]], temperatures[i], 0, integrate_default);
+        calls++;
+      }
+    }
+  }
+  const double time = MPI_Wtime() - start;
+
+  *ncalls = calls;
+  *sum = total;
+  return time;
+}
+
+//
+// Read in the atomic data with each layout in turn, i.e. a copy for every
+// rank, one for each NUMA domain or one for each node, and compare how
+// quickly all of the ranks together can use it. Each rank is timed on its own
+// and the slowest sets the throughput, since in Python the ranks wait for
+// each other at the end of each cycle
+//
+static void layout_benchmark(const char *masterfile, int world_rank) {
+  Log_set_verbosity(SHOW_ERROR);
+  geo.ioniz_mode = 9;
+  gsl_set_error_handler_off();
+
+  if (world_rank == 0) {
+    printf("%-8s : %6s : %-23s : %s\n", "Layout", "Copies", "limit_lines (windows/s)", "alpha_sp (calls/s)");
+  }
+
+  for (int i = 0; i < NUM_LAYOUTS; ++i) {
+    Trace_begin(LAYOUTS[i].name);
+    if (shared_init(LAYOUTS[i].mode)) { get_atomic_data((char *) masterfile); }
+    share_atomic_data();
+    int ncopies = shared_loader();
+    MPI_Allreduce(MPI_IN_PLACE, &ncopies, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+    long nfound, ncalls;
+    double sum;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double limit_lines_time = time_limit_lines(&nfound);
+    MPI_Barrier(MPI_COMM_WORLD);
+    double alpha_sp_time = time_alpha_sp(&ncalls, &sum);
+    MPI_Allreduce(MPI_IN_PLACE, &limit_lines_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &alpha_sp_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+    int world_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    if (world_rank == 0) {
+      printf("%-8s : %6d : %-23.4e : %.4e\n", LAYOUTS[i].name, ncopies,
+             world_size * NUM_WINDOWS / limit_lines_time, world_size * ncalls / alpha_sp_time);
+      Log_silent("%s: %ld lines found, sum of alpha_sp %e\n", LAYOUTS[i].name, nfound, sum);
+    }
+
+    release_atomic_data();
+    Trace_end(LAYOUTS[i].name);
+  }
+
+  shared_init(SHARED_PRIVATE);
+}
+
+//
+// Time summing estimator arrays of several sizes over the first 1, 2, 4, ...
+// ranks, with a flat MPI_Allreduce over all of them as Python does and with
+// the two levels of shared_reduce_sum. Each rank copies its contribution into
+// the array it accumulates into before each sum, in the same way for both
+//
+#define NUM_REDUCE_SIZES 4
+#define REDUCE_VALUES_PER_RUN 20000000
+
+static void reduce_benchmark(int world_rank, int world_size) {
+  const int sizes[NUM_REDUCE_SIZES] = {1000, 10000, 100000, 1000000};
+  const int max_size = sizes[NUM_REDUCE_SIZES - 1];
+
+  double *contribution = malloc(max_size * sizeof(double));
+  double *flat = malloc(max_size * sizeof(double));
+  if (contribution == NULL || flat == NULL) {
+    perror("Memory allocation failed");
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  for (int j = 0; j < max_size; ++j) { contribution[j] = 0.5 * (world_rank + 1) * (j % 97 + 1); }
+
+  if (world_rank == 0) {
+    printf("%-6s : %-8s : %-16s : %-16s : %s\n", "Ranks", "Values", "Flat (us)", "Two level (us)", "Difference");
+  }
+
+  for (int nprocs = 1;; nprocs = (2 * nprocs < world_size) ? 2 * nprocs : world_size) {
+    MPI_Comm comm;
+    MPI_Comm_split(MPI_COMM_WORLD, world_rank < nprocs ? 0 : MPI_UNDEFINED, world_rank, &comm);
+
+    for (int i = 0; i < NUM_REDUCE_SIZES; ++i) {
+      const int n = sizes[i];
+      const int nruns = REDUCE_VALUES_PER_RUN / n < 100 ? REDUCE_VALUES_PER_RUN / n : 100;
+      double flat_time = 0.0;
+      double shared_time = 0.0;
+      double difference = 0.0;
+
+      Trace_begin("flat allreduce");
+      if (comm != MPI_COMM_NULL) {
+        MPI_Barrier(comm);
+        const double start = MPI_Wtime();
+        for (int run = 0; run < nruns; ++run) {
+          memcpy(flat, contribution, n * sizeof(double));
+          MPI_Allreduce(MPI_IN_PLACE, flat, n, MPI_DOUBLE, MPI_SUM, comm);
+        }
+        flat_time = (MPI_Wtime() - start) / nruns;
+      }
+      Trace_end("flat allreduce");
+
+      Trace_begin("two level reduce");
+      if (shared_reduce_init(nprocs, n)) {
+        double *slice = shared_reduce_slice();
+        double *sum = NULL;
+        MPI_Barrier(comm);
+        const double start = MPI_Wtime();
+        for (int run = 0; run < nruns; ++run) {
+          memcpy(slice, contribution, n * sizeof(double));
+          sum = shared_reduce_sum();
+        }
+        shared_time = (MPI_Wtime() - start) / nruns;
+        for (int j = 0; j < n; ++j) {
+          const double error = fabs(sum[j] - flat[j]) / fabs(flat[j]);
+          if (error > difference) { difference = error; }
+        }
+      }
+      shared_reduce_free();
+      Trace_end("two level reduce");
+
+      MPI_Allreduce(MPI_IN_PLACE, &flat_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &shared_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &difference, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      if (world_rank == 0) {
+        printf("%-6d : %-8d : %-16.2f : %-16.2f : %.1e\n", nprocs, n, 1e6 * flat_time, 1e6 * shared_time, difference);
+      }
+    }
+
+    if (comm != MPI_COMM_NULL) { MPI_Comm_free(&comm); }
+    if (nprocs == world_size) { break; }
+  }
+
+  free(contribution);
+  free(flat);
+}
+
+//
+// The memory used by a rank, in MB, from /proc/self/smaps_rollup or, on older
+// kernels, by adding up the mappings in /proc/self/smaps. PSS divides each
+// shared page between the ranks which map it, so it adds up to what the node
+// uses, whereas RSS counts a shared page in full for every rank
+//
+struct memory {
+  double rss;
+  double pss;
+};
+
+static struct memory sample_memory(void) {
+  struct memory memory = {0.0, 0.0};
+  FILE *file = fopen("/proc/self/smaps_rollup", "r");
+  if (file == NULL) { file = fopen("/proc/self/smaps", "r"); }
+  if (file == NULL) { return memory; }
+
+  char line[256];
+  long kb;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "Rss: %ld kB", &kb) == 1) {
+      memory.rss += kb / 1024.0;
+    } else if (sscanf(line, "Pss: %ld kB", &kb) == 1) {
+      memory.pss += kb / 1024.0;
+    }
+  }
+  fclose(file);
+
+  return memory;
+}
+
+//
+// Move the elements, which every rank has read, into a window on host rank 0
+// and point ele at it, as in the example of sharing an array
+//
+static void share_elements(MPI_Comm host_comm, int host_rank, MPI_Win *win) {
+  MPI_Aint window_size = host_rank == 0 ? (MPI_Aint) (nelements * sizeof(*ele)) : 0;
+  int disp_unit = 1;
+  ElemPtr shared_ele;
+
+  MPI_Win_allocate_shared(window_size, disp_unit, MPI_INFO_NULL, host_comm, &shared_ele, win);
+  if (host_rank == 0) {
+    memcpy(shared_ele, ele, window_size);
+  } else {
+    MPI_Win_shared_query(*win, 0, &window_size, &disp_unit, &shared_ele);
+  }
+  MPI_Win_fence(0, *win);
+
+  shared_free(ele);
+  ele = shared_ele;
+}
+
+//
+// Read each data set with every rank having its own copy, with only ele
+// shared and with all of the atomic data shared, and report the memory used
+// by each node, i.e. the ranks in host_comm, and how long the data took to
+// read and to move into the shared windows. The memory of the largest node is
+// reported, and the increase in PSS from before the data was read is the
+// memory which the data itself takes
+//
+#define NUM_MEMORY_LAYOUTS 3
+
+static void memory_benchmark(int nfiles, char **masterfiles, MPI_Comm host_comm, int host_rank, int world_rank) {
+  const char *names[NUM_MEMORY_LAYOUTS] = {"private", "ele", "shared"};
+
+  Log_set_verbosity(SHOW_ERROR);
+
+  int host_size;
+  MPI_Comm_size(host_comm, &host_size);
+  MPI_Allreduce(MPI_IN_PLACE, &host_size, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  if (world_rank == 0) {
+    printf("Memory for each node of up to %d ranks, in MB\n", host_size);
+    printf("%-8s : %-10s : %-10s : %-10s : %-10s : %s\n", "Layout", "RSS", "PSS", "Data PSS", "Load (s)", "Setup (s)");
+  }
+
+  for (int i = 0; i < nfiles; ++i) {
+    if (world_rank == 0) { printf("%s\n", masterfiles[i]); }
+
+    for (int layout = 0; layout < NUM_MEMORY_LAYOUTS; ++layout) {
+      Trace_begin(names[layout]);
+      MPI_Win ele_win;
+      double load_time = 0.0;
+      double setup_time = 0.0;
+
+      // Give back the memory of the last data set, so it is not counted again
+      malloc_trim(0);
+      MPI_Barrier(MPI_COMM_WORLD);
+      const struct memory before = sample_memory();
+
+      const int loader = shared_init(layout == NUM_MEMORY_LAYOUTS - 1 ? SHARED_NODE : SHARED_PRIVATE);
+      double start = MPI_Wtime();
+      if (loader) { get_atomic_data(masterfiles[i]); }
+      load_time = MPI_Wtime() - start;
+
+      MPI_Barrier(MPI_COMM_WORLD);
+      start = MPI_Wtime();
+      if (layout == 1) {
+        share_elements(host_comm, host_rank, &ele_win);
+      } else {
+        share_atomic_data();
+      }
+      setup_time = MPI_Wtime() - start;
+
+      MPI_Barrier(MPI_COMM_WORLD);
+      const struct memory after = sample_memory();
+
+      double node[3] = {after.rss, after.pss, after.pss - before.pss};
+      MPI_Allreduce(MPI_IN_PLACE, node, 3, MPI_DOUBLE, MPI_SUM, host_comm);
+      MPI_Allreduce(MPI_IN_PLACE, node, 3, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &load_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      MPI_Allreduce(MPI_IN_PLACE, &setup_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+      if (world_rank == 0) {
+        printf("%-8s : %-10.2f : %-10.2f : %-10.2f : %-10.4f : %.4f\n", names[layout], node[0], node[1], node[2],
+               load_time, setup_time);
+      }
+
+      release_atomic_data();
+      if (layout == 1) { MPI_Win_free(&ele_win); }
+      Trace_end(names[layout]);
+    }
+  }
+
+  shared_init(SHARED_PRIVATE);
+}
+
+//
+// Share the atomic data with other copies of this program, which need not be
+// in the same MPI job, through a POSIX shared memory segment named from the
+// fingerprint of the data. The first copy reads the data and the others wait
+// for it, then map the tables. Each copy holds on to the data for the given
+// number of seconds, so that several can be started together
+//
+static void posix_example(char *masterfile, int seconds) {
+  char key[64];
+
+  Log_set_verbosity(SHOW_LOG);
+  if (!atomic_data_fingerprint(masterfile, key, sizeof(key))) { exit(EXIT_FAILURE); }
+
+  const double start = MPI_Wtime();
+  const int loader = shared_init_posix(key);
+  if (loader) { get_atomic_data(masterfile); }
+  share_atomic_data();
+  const double time = MPI_Wtime() - start;
+
+  printf("Process %d %s %s in %.4f seconds: element 0 name = %s, %d ions and %d lines\n", (int) getpid(),
+         loader ? "read" : "attached to", key, time, ele[0].name, nions, nlines);
+  fflush(stdout);
+  sleep(seconds);
+
+  // The last copy to release the data removes the segment
+  release_atomic_data();
+}
+
+//
+// With no arguments, the examples of sharing an array and the atomic data are
+// run, the atomic data being shared by each node or with the layout given as
+// the first argument. With "layouts" as the first argument, the benchmark of
+// the layouts is run with the masterfile given as the second argument, with
+// "reduce" the benchmark of summing the estimators is run, with "memory" the
+// benchmark of the memory used with the masterfiles given after it, and with
+// "posix" the atomic data is shared with other copies of the program instead
+//
+int main(int argc, char **argv) {
+  MPI_Init(&argc, &argv);
+  Trace_init(getenv("TRACE_FILE"));
+
+  if (argc > 1 && strcmp(argv[1], "reduce") == 0) {
+    int world_rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    reduce_benchmark(world_rank, world_size);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "posix") == 0) {
+    posix_example(argc > 2 ? argv[2] : "data/standard80.dat", argc > 3 ? atoi(argv[3]) : 0);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "memory") == 0) {
+    char *default_masterfiles[] = {"data/standard80.dat", "data/h10_hetop_standard80.dat"};
+    int world_rank, host_rank;
+    MPI_Comm host_comm;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &host_comm);
+    MPI_Comm_rank(host_comm, &host_rank);
+    if (argc > 2) {
+      memory_benchmark(argc - 2, &argv[2], host_comm, host_rank, world_rank);
+    } else {
+      memory_benchmark(2, default_masterfiles, host_comm, host_rank, world_rank);
+    }
+    MPI_Comm_free(&host_comm);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "layouts") == 0) {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    layout_benchmark(argc > 2 ? argv[2] : "data/h10_hetop_standard80.dat", world_rank);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+  }
+  const int atomic_layout = argc > 1 ? layout_mode(argv[1]) : SHARED_NODE;
 
   // In this toy model, we'll initialise memory in a root rank and share it with
   // all other non-root ranks. This only works with intra-node processes, e.g.
@@ -23,9 +441,11 @@ int main(void) {
   int host_rank;
   int host_size;
   MPI_Comm host_comm;
+  Trace_begin("split communicator");
   MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &host_comm);
   MPI_Comm_rank(host_comm, &host_rank);
   MPI_Comm_size(host_comm, &host_size);
+  Trace_end("split communicator");
 
   //
   // Example with an array of 5 integers
@@ -45,6 +465,7 @@ int main(void) {
   // but we still need to set up the window. Using `MPI_Win_shared_query` we can
   // point `shared_data` to the same address as the shared buffer on the root
   // rank to gain access to the data.
+  Trace_begin("create int window");
   if (host_rank == 0) {
     window_size = 5 * disp_unit;
     MPI_Win_allocate_shared(window_size, disp_unit, MPI_INFO_NULL, host_comm, &shared_data, &win);
@@ -53,6 +474,7 @@ int main(void) {
     MPI_Win_shared_query(win, 0, &window_size, &disp_unit, &shared_data);
   }
   MPI_Win_fence(0, win);  // Force synchronisation to make sure all windows are in the same state
+  Trace_end("create int window");
 
   // At this point, shared_data will be (hopefully) full of zero's. But we can
   // modify the contents of it and this should be reflected in the pointer on
@@ -82,49 +504,36 @@ int main(void) {
   MPI_Win_free(&win);
 
   //
-  // Example with Python elements struct
+  // Example with the Python atomic data
   //
 
   Log_set_verbosity(SHOW_LOG);
 
-  // Only read in data for the host rank
-  if (host_rank == 0) { get_atomic_data("data/standard80.dat"); }
-
-  // Create variables for window share
-  struct elements *shared_ele;
-  disp_unit = (int) sizeof(ele_dummy);
-  window_size = 0;
+  // Rather than creating a window for each table by hand, the tables are
+  // allocated with shared_calloc. After shared_init, only one rank on each
+  // node (the "loader", which is host rank 0) reads in the atomic data, as if
+  // the tables were private. Then every rank calls share_atomic_data, which
+  // moves each table into a shared window on the loader, attaches the other
+  // ranks to it after a fence, and points ele, ion, line, etc. at the windows.
+  // So each node holds one copy of the data, however many ranks it has. With
+  // SHARED_NUMA, each NUMA domain of the node holds its own copy instead, so
+  // no rank reads it from the memory of another socket. With SHARED_BCAST as
+  // well, only world rank 0 reads the data, and sends it to the loader of
+  // every other node, so the files are read once however many nodes there are.
+  if (shared_init(atomic_layout)) { get_atomic_data("data/standard80.dat"); }
+  share_atomic_data();
 
-  // On the root host rank, allocate shared memory space for shared_ele of the
-  // appropriate window size. Then copy the contents of ele into shared_ele and
-  // free ele.
-  // For non-root ranks, we create the shared pointer and then used shared_query
-  // to point it to the correct base address in the root rank
-  if (host_rank == 0) {
-    window_size = nelements * disp_unit;
-    MPI_Win_allocate_shared(window_size, disp_unit, MPI_INFO_NULL, host_comm, &shared_ele, &win);
-    memcpy(shared_ele, ele, window_size);
-    free(ele);
-  } else {
-    MPI_Win_allocate_shared(0, disp_unit, MPI_INFO_NULL, host_comm, &shared_ele, &win);
-    MPI_Win_shared_query(win, 0, &window_size, &disp_unit, &shared_ele);
-  }
-  MPI_Win_fence(0, win); // force synchronisation, to make sure all windows are the same
-
-  // Point the shared_ele data back to ele
-  ele = shared_ele;
-
-  // Print stuff
+  // Print stuff, which every rank can now see
   for (int i = 0; i < host_size; ++i) {
     if (i == host_rank) {
-      printf("Host rank %d: element %d name = %s\n", host_rank, host_rank, ele[host_rank].name);
+      const int nelem = host_rank % nelements;
+      printf("Host rank %d: element %d name = %s, %d ions and %d lines\n", host_rank, nelem, ele[nelem].name, nions, nlines);
     }
     MPI_Barrier(MPI_COMM_WORLD);
   }
 
-  // Synchronise and free the window at the end
-  MPI_Win_fence(0, win);
-  MPI_Win_free(&win);
+  // Free the windows at the end, which all of the ranks on a node do together
+  release_atomic_data();
 
   MPI_Finalize();
 
@@ -3,38 +3,66 @@
 //
 
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "atomic.h"
 #include "integrate.h"
 #include "python.h"
 
+//
+// The last frequency and x-section calculated by `sigma_phot` for recently
+// used entries. In Python these are kept in the entry itself, but `phot_top`
+// may be shared by all of the processes on a node, so here each thread keeps
+// its own, in a slot chosen by the address of the entry
+//
+#define SIGMA_PHOT_MEMO_SIZE 64
+
+struct sigma_phot_memo {
+  const struct topbase_phot *x_ptr;
+  int nlast;// Index of the interval the last frequency was in
+  double freq;
+  double sigma;
+};
+
+static __thread struct sigma_phot_memo sigma_phot_memo[SIGMA_PHOT_MEMO_SIZE];
+
 //
 // `sigma_phot` is used to calculate the photoionization cross-section for a
 // given topbase photoionization entry and frequency. This function is taken
-// from Python
+// from Python, but the points of the x-section are in `xsection_pool`
 //
 double sigma_phot(struct topbase_phot *x_ptr, double freq) {
   int nmax;
   double xsection;
   double frac;
   int nlast;
+  const double *x_freq = &xsection_pool.freq[x_ptr->offset];
+  const double *log_freq = &xsection_pool.log_freq[x_ptr->offset];
+  const double *log_x = &xsection_pool.log_x[x_ptr->offset];
+  struct sigma_phot_memo *memo = &sigma_phot_memo[((uintptr_t) x_ptr / sizeof(*x_ptr)) % SIGMA_PHOT_MEMO_SIZE];
 
-  if (freq < x_ptr->freq[0]) {
+  if (freq < x_freq[0]) {
     return (0.0);// Since this was below threshold
   }
 
-  if (freq == x_ptr->f) {
-    return (x_ptr->sigma);// Avoid recalculating xsection
+  if (memo->x_ptr != x_ptr) {
+    memo->x_ptr = x_ptr;
+    memo->nlast = -1;
+    memo->freq = -1;
   }
 
-  if (x_ptr->nlast > -1) {
-    nlast = x_ptr->nlast;
-    if (x_ptr->freq[nlast] < freq && freq < x_ptr->freq[nlast + 1]) {
-      frac = (log(freq) - x_ptr->log_freq[nlast]) / (x_ptr->log_freq[nlast + 1] - x_ptr->log_freq[nlast]);
-      xsection = exp((1. - frac) * x_ptr->log_x[nlast] + frac * x_ptr->log_x[nlast + 1]);
-      x_ptr->sigma = xsection;
-      x_ptr->f = freq;
+  if (freq == memo->freq) {
+    return (memo->sigma);// Avoid recalculating xsection
+  }
+
+  if (memo->nlast > -1) {
+    nlast = memo->nlast;
+    if (x_freq[nlast] < freq && freq < x_freq[nlast + 1]) {
+      frac = (log(freq) - log_freq[nlast]) / (log_freq[nlast + 1] - log_freq[nlast]);
+      xsection = exp((1. - frac) * log_x[nlast] + frac * log_x[nlast + 1]);
+      memo->sigma = xsection;
+      memo->freq = freq;
 
       return (xsection);
     }
@@ -42,9 +70,9 @@ double sigma_phot(struct topbase_phot *x_ptr, double freq) {
 
   /* Calculate the x-section */
   nmax = x_ptr->np;
-  x_ptr->nlast = linterp(freq, &x_ptr->freq[0], &x_ptr->x[0], nmax, &xsection, 1);// call linterp in log space
-  x_ptr->sigma = xsection;
-  x_ptr->f = freq;
+  memo->nlast = linterp(freq, &xsection_pool.freq[x_ptr->offset], &xsection_pool.x[x_ptr->offset], nmax, &xsection, 1);// call linterp in log space
+  memo->sigma = xsection;
+  memo->freq = freq;
 
   return (xsection);
 }
@@ -59,11 +87,18 @@ struct integration_parameters {
   struct topbase_phot *phot;
 };
 
+//
+// The number of times the integrand has been evaluated in this thread, which
+// is used to estimate how long each alpha_sp takes
+//
+__thread long alpha_sp_evaluations = 0;
+
 //
 // Returns the value of the integrand in the calculation for the spontaneous
 // recombination coefficient
 //
 double alpha_sp_integration(double freq, void *params) {
+  alpha_sp_evaluations++;
   const struct integration_parameters *p = (struct integration_parameters *) params;
   const double temperature = p->temperature;
   const double freq_lower = p->freq_lower;
@@ -85,8 +120,8 @@ double alpha_sp_integration(double freq, void *params) {
 double alpha_sp(struct topbase_phot *phot, const double temperature, int mode,
                 double (*integrator)(double (*integrand)(double, void *), void *, double, double, double)) {
   const double rtol = 1e-4;// hardcoded to 1e-4, like in Python
-  const double freq_lower = phot->freq[0];
-  double freq_upper = phot->freq[phot->np - 1];
+  const double freq_lower = xsection_pool.freq[phot->offset];
+  double freq_upper = xsection_pool.freq[phot->offset + phot->np - 1];
 
   if ((H_OVER_K * (freq_upper - freq_lower) / temperature) > ALPHA_MATOM_NUMAX_LIMIT) {
     freq_upper = freq_lower + temperature * ALPHA_MATOM_NUMAX_LIMIT / H_OVER_K;
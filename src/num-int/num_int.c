@@ -4,9 +4,10 @@
 
 #include "gsl/gsl_errno.h"
 #include <math.h>
+#include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 
 #include "atomic.h"
 #include "integrate.h"
@@ -101,45 +102,208 @@ void load_temperatures(double **temperature_array, int *num_elements) {
 }
 
 //
-// Time how long it takes to compute alpha_sp for a given integrator function
+// The work of a benchmark: alpha_sp for every bound-free jump of every macro
+// atom level, at every temperature, possibly more than once. The items are
+// in the order the results are compared in, temperature by temperature
 //
-double time_integrator(double (*integrator)(double (*integrand)(double, void *), void *, double, double, double),
-                       double **results, int *results_count) {
-  int num_temperatures;
-  double *temperatures;
+struct workload {
+  int num_items;
+  int *temperature; // Index in temperatures of each item
+  int *phot;        // Index in phot_top of each item
+  double *cost;     // Estimated cost of each item
+};
 
-  load_temperatures(&temperatures, &num_temperatures);
+#define NUM_CALIBRATION_TEMPERATURES 3
+
+static struct workload build_workload(int num_temperatures, int repeat) {
+  struct workload work = {0, NULL, NULL, NULL};
 
-  /* Count how big of an array we need to store the results for comparison */
   int count = 0;
-  for (int i = 0; i < num_temperatures; ++i) {
-    for (int j = 0; j < nlevels_macro; ++j) {
-      for (int k = 0; k < xconfig[j].n_bfd_jump; ++k) { count++; }
+  for (int j = 0; j < nlevels_macro; ++j) { count += xconfig[j].n_bfd_jump; }
+  count *= num_temperatures * repeat;
+
+  work.temperature = malloc(count * sizeof(int));
+  work.phot = malloc(count * sizeof(int));
+  work.cost = malloc(count * sizeof(double));
+  if (work.temperature == NULL || work.phot == NULL || work.cost == NULL) {
+    perror("Memory allocation failed");
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  for (int r = 0; r < repeat; ++r) {
+    for (int i = 0; i < num_temperatures; ++i) {
+      for (int j = 0; j < nlevels_macro; ++j) {
+        const int *bfd_jump = &bfd_jumps.jump[bfd_jumps.offset[j]];
+        for (int k = 0; k < xconfig[j].n_bfd_jump; ++k) {
+          work.temperature[work.num_items] = i;
+          work.phot[work.num_items] = bfd_jump[k];
+          work.cost[work.num_items] = phot_top[bfd_jump[k]].np;
+          work.num_items++;
+        }
+      }
     }
   }
-  *results = calloc(count, sizeof(double));
-  if ((*results) == NULL) {
+
+  return work;
+}
+
+static void free_workload(struct workload *work) {
+  free(work->temperature);
+  free(work->phot);
+  free(work->cost);
+  work->num_items = 0;
+}
+
+//
+// Estimate the cost of each item from the number of times the integrand is
+// evaluated for its x-section, at the first, middle and last temperature. The
+// ranks share the calibration, each doing every size'th x-section. An item
+// takes the count at the calibration temperature nearest its own, in log T.
+// Without a count, e.g. if the integrator failed, the number of points in the
+// x-section, which the work was estimated with at first, is kept
+//
+static double calibrate_workload(struct workload *work, const double *temperatures, int num_temperatures,
+                                 double (*integrator)(double (*integrand)(double, void *), void *, double, double,
+                                                      double),
+                                 MPI_Comm comm) {
+  int rank, size;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  const int calibration[NUM_CALIBRATION_TEMPERATURES] = {0, num_temperatures / 2, num_temperatures - 1};
+  double *evaluations = calloc((size_t) nphot_total * NUM_CALIBRATION_TEMPERATURES, sizeof(double));
+  char *used = calloc(nphot_total, 1);
+  if (evaluations == NULL || used == NULL) {
     perror("Memory allocation failed");
-    exit(EXIT_FAILURE);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
   }
-  if (results_count != NULL) { *results_count = count; }
-
-  const clock_t start_time = clock();
-  count = 0;
-  for (int i = 0; i < num_temperatures; ++i) {
-    const double temperature = temperatures[i];
-    for (int j = 0; j < nlevels_macro; ++j) {
-      for (int k = 0; k < xconfig[j].n_bfd_jump; ++k) {
-        const double result = alpha_sp(&phot_top[xconfig[j].bfd_jump[k]], temperature, 0, integrator);
-        (*results)[count] = result;
-        count++;
+  for (int n = 0; n < work->num_items; ++n) { used[work->phot[n]] = 1; }
+
+  const double start = MPI_Wtime();
+  for (int p = 0, count = 0; p < nphot_total; ++p) {
+    if (!used[p] || count++ % size != rank) { continue; }
+    for (int c = 0; c < NUM_CALIBRATION_TEMPERATURES; ++c) {
+      alpha_sp_evaluations = 0;
+      alpha_sp(&phot_top[p], temperatures[calibration[c]], 0, integrator);
+      evaluations[p * NUM_CALIBRATION_TEMPERATURES + c] = (double) alpha_sp_evaluations;
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, evaluations, nphot_total * NUM_CALIBRATION_TEMPERATURES, MPI_DOUBLE, MPI_SUM, comm);
+  const double time = MPI_Wtime() - start;
+
+  for (int n = 0; n < work->num_items; ++n) {
+    const double log_t = log(temperatures[work->temperature[n]]);
+    int nearest = 0;
+    for (int c = 1; c < NUM_CALIBRATION_TEMPERATURES; ++c) {
+      if (fabs(log(temperatures[calibration[c]]) - log_t) < fabs(log(temperatures[calibration[nearest]]) - log_t)) {
+        nearest = c;
       }
     }
+    const double count = evaluations[work->phot[n] * NUM_CALIBRATION_TEMPERATURES + nearest];
+    if (count > 0) { work->cost[n] = count; }
   }
-  const clock_t end_time = clock();
+
+  free(evaluations);
+  free(used);
+
+  return time;
+}
+
+//
+// Split the items into contiguous ranges of about the same estimated cost,
+// one for each rank, so the results can be gathered in order
+//
+static void partition_workload(const struct workload *work, int size, int *first) {
+  double total = 0.0;
+  for (int n = 0; n < work->num_items; ++n) { total += work->cost[n]; }
+
+  double sum = 0.0;
+  int n = 0;
+  first[0] = 0;
+  for (int r = 1; r < size; ++r) {
+    const double target = total * r / size;
+    while (n < work->num_items && sum + 0.5 * work->cost[n] < target) { sum += work->cost[n++]; }
+    first[r] = n;
+  }
+  first[size] = work->num_items;
+}
+
+//
+// Time how long it takes to compute alpha_sp for a given integrator function,
+// which is traced with the given name, with the work split over the ranks in
+// comm. The temperatures are gone through repeat times. The results are
+// gathered on rank 0 of comm, and the time is that of the slowest rank. If
+// balance is not NULL, it is set to the time of the slowest rank over the mean
+// time, and the time taken to calibrate the cost of the work is added to it
+//
+double time_integrator(const char *name,
+                       double (*integrator)(double (*integrand)(double, void *), void *, double, double, double),
+                       MPI_Comm comm, int repeat, double **results, int *results_count, double *balance,
+                       double *calibration_time) {
+  int rank, size, num_temperatures;
+  double *temperatures;
+
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &size);
+
+  Trace_begin(name);
+  Trace_begin("load_temperatures");
+  load_temperatures(&temperatures, &num_temperatures);
+  Trace_end("load_temperatures");
+
+  struct workload work = build_workload(num_temperatures, repeat);
+  Trace_begin("calibrate_workload");
+  const double calibration = calibrate_workload(&work, temperatures, num_temperatures, integrator, comm);
+  Trace_end("calibrate_workload");
+  if (calibration_time != NULL) { *calibration_time = calibration; }
+
+  int *first = malloc((size + 1) * sizeof(int));
+  int *counts = malloc(size * sizeof(int));
+  *results = calloc(work.num_items > 0 ? work.num_items : 1, sizeof(double));
+  if (first == NULL || counts == NULL || (*results) == NULL) {
+    perror("Memory allocation failed");
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  if (results_count != NULL) { *results_count = work.num_items; }
+  partition_workload(&work, size, first);
+  for (int r = 0; r < size; ++r) { counts[r] = first[r + 1] - first[r]; }
+
+  MPI_Barrier(comm);
+  const double start_time = MPI_Wtime();
+  for (int n = first[rank]; n < first[rank + 1]; ++n) {
+    (*results)[n] = alpha_sp(&phot_top[work.phot[n]], temperatures[work.temperature[n]], 0, integrator);
+  }
+  const double my_time = MPI_Wtime() - start_time;
+
+  Trace_begin("gather results");
+  if (rank == 0) {
+    MPI_Gatherv(MPI_IN_PLACE, counts[0], MPI_DOUBLE, *results, counts, first, MPI_DOUBLE, 0, comm);
+  } else {
+    MPI_Gatherv(&(*results)[first[rank]], counts[rank], MPI_DOUBLE, NULL, NULL, NULL, MPI_DOUBLE, 0, comm);
+  }
+  Trace_end("gather results");
+
+  double max_time, sum_time;
+  MPI_Allreduce(&my_time, &max_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+  MPI_Allreduce(&my_time, &sum_time, 1, MPI_DOUBLE, MPI_SUM, comm);
+  if (balance != NULL) { *balance = sum_time > 0.0 ? max_time / (sum_time / size) : 1.0; }
+
+  free(first);
+  free(counts);
+  free_workload(&work);
   free(temperatures);
+  Trace_end(name);
 
-  return ((double) (end_time - start_time)) / CLOCKS_PER_SEC;
+  return max_time;
+}
+
+//
+// Print how evenly the work was split and how long it took to estimate its
+// cost, under the results of a benchmark
+//
+void print_balance(const double balance, const double calibration_time) {
+  printf("%-12s   load imbalance %.3f (slowest rank / mean), calibration %.6f seconds\n", "", balance,
+         calibration_time);
 }
 
 //
@@ -148,30 +312,90 @@ double time_integrator(double (*integrator)(double (*integrand)(double, void *),
 #define TIME_IT(name, integrator)                                                                                      \
   do {                                                                                                                 \
     int count;                                                                                                         \
-    double *results;                                                                                                   \
-    const double time = time_integrator(integrator, &results, &count);                                                 \
-    print_results(name, time, results_default, results, count);                                                        \
+    double *results, balance, calibration_time;                                                                        \
+    const double time =                                                                                                \
+        time_integrator(name, integrator, MPI_COMM_WORLD, 1, &results, &count, &balance, &calibration_time);           \
+    if (rank == 0) {                                                                                                   \
+      print_results(name, time, results_default, results, count);                                                     \
+      print_balance(balance, calibration_time);                                                                        \
+    }                                                                                                                  \
     free(results);                                                                                                     \
   } while (0);
 
+//
+// Time the default integrator on the first 1, 2, 4, ... ranks. For strong
+// scaling the same work is split between more ranks, so ideally the time
+// falls as 1 / ranks; for weak scaling each rank has the work of the whole
+// benchmark, so ideally the time stays the same. The efficiency compares
+// each with the time on one rank
+//
+void print_scaling(int rank, int size) {
+  double strong_one = 0.0;
+  double weak_one = 0.0;
+
+  if (rank == 0) {
+    printf("\n%-6s : %-12s : %-10s : %-12s : %s\n", "Ranks", "Strong (s)", "Efficiency", "Weak (s)", "Efficiency");
+  }
+
+  for (int nprocs = 1;; nprocs = (2 * nprocs < size) ? 2 * nprocs : size) {
+    MPI_Comm comm;
+    MPI_Comm_split(MPI_COMM_WORLD, rank < nprocs ? 0 : MPI_UNDEFINED, rank, &comm);
+
+    if (comm != MPI_COMM_NULL) {
+      double *results;
+      const double strong = time_integrator("Strong scaling", integrate_default, comm, 1, &results, NULL, NULL, NULL);
+      free(results);
+      const double weak = time_integrator("Weak scaling", integrate_default, comm, nprocs, &results, NULL, NULL, NULL);
+      free(results);
+
+      if (nprocs == 1) {
+        strong_one = strong;
+        weak_one = weak;
+      }
+      if (rank == 0) {
+        printf("%-6d : %-12.6f : %-10.3f : %-12.6f : %.3f\n", nprocs, strong, strong_one / (nprocs * strong), weak,
+               weak_one / weak);
+      }
+      MPI_Comm_free(&comm);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (nprocs == size) { break; }
+  }
+}
 
 //
-// Main function of the program
+// Main function of the program. The atomic data is shared by the ranks on each
+// node, and each benchmark is split between all of the ranks. With "scaling"
+// as the first argument, the strong and weak scaling of the default
+// integrator are measured as well
 //
 int main(int argc, char **argv) {
+  int rank, size;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  Log_set_mpi_rank(rank, size);
+  Trace_init(getenv("TRACE_FILE"));
 
   geo.ioniz_mode = 9;
-  print_initialise_divider();
+  if (rank == 0) { print_initialise_divider(); }
   Log_set_verbosity(SHOW_LOG);
-  get_atomic_data("data/h10_hetop_standard80.dat");
+  if (shared_init(SHARED_NODE)) { get_atomic_data("data/h10_hetop_standard80.dat"); }
+  share_atomic_data();
 
   Log_set_verbosity(SHOW_ERROR);
-  print_integrate_divider();
+  if (rank == 0) { print_integrate_divider(); }
   gsl_set_error_handler_off();
 
-  double *results_default;
-  double time_default = time_integrator(integrate_default, &results_default, NULL);
-  print_results("Default", time_default, results_default, NULL, 0);
+  double *results_default, balance, calibration_time;
+  double time_default = time_integrator("Default", integrate_default, MPI_COMM_WORLD, 1, &results_default, NULL,
+                                        &balance, &calibration_time);
+  if (rank == 0) {
+    print_results("Default", time_default, results_default, NULL, 0);
+    print_balance(balance, calibration_time);
+  }
 
   TIME_IT("Trapezium", integrate_trap)
   TIME_IT("Simpson's", integrate_simp)
@@ -180,5 +404,11 @@ int main(int argc, char **argv) {
   TIME_IT("Smaller QAGS", integrate_qags_small)
   TIME_IT("Romberg", integrate_romberg)
 
+  free(results_default);
+  if (argc > 1 && strcmp(argv[1], "scaling") == 0) { print_scaling(rank, size); }
+
+  release_atomic_data();
+  MPI_Finalize();
+
   return EXIT_SUCCESS;
 }
@@ -11,6 +11,8 @@ int nlines_macro;               /* Actual number of Macro Atom lines that were r
                                    data assumes that macro lines are read in before non-macro lines */
 int n_inner_tot;                /*The actual number of inner shell ionization cross sections in total */
 
+Atomic_sizes atomic_max;
+
 int nauger;                     /*Actual number of innershell edges for which autoionization is to be computed */
 int nauger_macro;
 
@@ -22,13 +24,17 @@ IonPtr ion;
 
 ConfigPtr xconfig;
 
+Jump_list bbu_jumps, bbd_jumps, bfu_jumps, bfd_jumps;
+
 AugerPtr auger_macro;
 
-LinePtr line, lin_ptr[NLINES];  /* line[] is the actual structure array that contains all the data, *lin_ptr
-                                   is an array which contains a frequency ordered set of ptrs to line */
+LinePtr line;                   /* line[] is the actual structure array that contains all the data */
+int *lin_idx;                   /* The positions in line[] of the lines in frequency order */
 struct lines fast_line;
 
-int nline_min, nline_max, nline_delt;   /* Used to select a range of lines in a frequency band from the lin_ptr array 
+Line_view line_view;
+
+int nline_min, nline_max, nline_delt;   /* Used to select a range of lines in a frequency band from the lin_idx array 
                                            in situations where the frequency range of interest is limited, including for defining which
                                            lines come into play for resonant scattering along a line of sight, and in
                                            calculating band_limit luminosities.  The limits are established by the
@@ -37,7 +43,9 @@ int nline_min, nline_max, nline_delt;   /* Used to select a range of lines in a
 
 int n_coll_stren;
 
-Coll_stren coll_stren[NLINES];
+Coll_stren *coll_stren;
+
+Upsilon_pool upsilon_pool;
 
 int nxphot;                     /*The actual number of ions for which there are VFKY photoionization x-sections */
 double phot_freq_min;           /*The lowest frequency for which photoionization can occur */
@@ -46,48 +54,55 @@ double inner_freq_min;          /*The lowest frequency for which inner shell ion
 int ntop_phot;                  /* The actual number of TopBase photoionzation x-sections */
 int nphot_total;                /* total number of photoionzation x-sections = nxphot + ntop_phot */
 
-Topbase_phot phot_top[NLEVELS];
-TopPhotPtr phot_top_ptr[NLEVELS];       /* Pointers to phot_top in threshold frequency order - this */
+Topbase_phot *phot_top;
+int *phot_top_idx;              /* The positions in phot_top of the x-sections in threshold frequency order */
 
-Topbase_phot inner_cross[N_INNER * NIONS];
-TopPhotPtr inner_cross_ptr[N_INNER * NIONS];
+Topbase_phot *inner_cross;
+int *inner_cross_idx;
 
-Inner_elec_yield inner_elec_yield[N_INNER * NIONS];
+Xsection_pool xsection_pool;
 
-Inner_fluor_yield inner_fluor_yield[N_INNER * NIONS];
+Inner_elec_yield *inner_elec_yield;
 
-struct ground_fracs ground_frac[NIONS];
+Inner_fluor_yield *inner_fluor_yield;
+
+struct ground_fracs *ground_frac;
 
 int ndrecomb;                   //This is the actual number of DR parameters
 
-Drecomb drecomb[NIONS];         //set up the actual structure
+Drecomb *drecomb;               //set up the actual structure
 
-double dr_coeffs[NIONS];        //this will be an array to temprarily store the volumetric dielectronic recombination rate coefficients for the current cell under interest. We may want to make this 2D and store the coefficients for a range of temperatures to interpolate.
+double dr_coeffs[NIONS];        //this will be an array to temprarily store the volumetric dielectronic recombination rate coefficients for the current cell under interest. The coefficients for a range of temperatures are tabulated in rate_tables.
 
 int n_total_rr;
 
-Total_rr total_rr[NIONS];       //Set up the structure
+Total_rr *total_rr;             //Set up the structure
 
 int n_bad_gs_rr;
 
-Bad_gs_rr bad_gs_rr[NIONS];     //Set up the structure
+Bad_gs_rr *bad_gs_rr;           //Set up the structure
 
 int n_dere_di_rate;
 
-Dere_di_rate dere_di_rate[NIONS];       //Set up the structure
+Dere_di_rate *dere_di_rate;     //Set up the structure
 
 double di_coeffs[NIONS];        //This is an array to store the di_coeffs 
 double qrecomb_coeffs[NIONS];   //JM 1508 analogous array for three body recombination 
 
 int gaunt_n_gsqrd;              //The actual number of scaled temperatures
 
-Gaunt_total gaunt_total[MAX_GAUNT_N_GSQRD];     //Set up the structure
+Gaunt_total *gaunt_total;       //Set up the structure
 
 int n_charge_exchange;          //The actual number of scaled temperatures
 
-Charge_exchange charge_exchange[MAX_CHARGE_EXCHANGE];   //Set up the structure
+Charge_exchange *charge_exchange;        //Set up the structure
 
 double charge_exchange_recomb_rates[NIONS];     //An array to store the actual recombination rates for a given temperature - 
 double charge_exchange_ioniz_rates[MAX_CHARGE_EXCHANGE];        //An array to store the actual ionization rates for a given temperature
 
+Rate_tables rate_tables;
+
 int write_atomicdata;
+
+int atomicdata_nthreads;        /* The number of threads used to parse the atomic data files, 0 to choose it */
+int atomicdata_node_readers;    /* The number of processes on this node which read the atomic data, 0 if not known */
@@ -25,6 +25,7 @@
 #undef LINELENGTH
 #endif
 #define LINELENGTH 500
+#define WORD_FORMAT "%499s"     /* Limits the length of a word read into a LINELENGTH buffer */
 
 
 #define MAXWORDS    20
@@ -97,10 +98,14 @@ int
 get_atomic_data (masterfile)
      char masterfile[];
 {
-  FILE *fptr, *mptr;
-  char aline[LINELENGTH];
-  char bline[LINELENGTH];
-  char cline[LINELENGTH];
+  Atomic_file master_file;
+  Atomic_data_file *dfiles, *dfile;
+  Atomic_record *rec;
+  Line_record lrec_local, *lrec;
+  int nfiles, nfiles_max, ifile, irec, nthreads, npoints;
+  char *aline;
+  char *bline;
+  char *cline;
   char file[LINELENGTH];
 
   char word[LINELENGTH];
@@ -137,7 +142,7 @@ get_atomic_data (masterfile)
   int islp, ilv, np;
   char configname[15];
   double e, rl;
-  double xe[NCROSS], xx[NCROSS];
+  double *xe, *xx;
   int nlines_simple;
   int nspline;
   double tmin;
@@ -165,8 +170,7 @@ get_atomic_data (masterfile)
   double dlambda;
 
 
-  /* Initialize the atomic data structures and various counters */
-  init_atomic_data ();
+  /* Initialize the various counters.  The atomic data structures are initialized once the files have been read */
 
   n_elec_yield_tot = 0;         //Counter for electron yield
   gstmin = 0.0;
@@ -193,8 +197,8 @@ get_atomic_data (masterfile)
 /*mflag is set initially to 1, in order to establish that
 macro-lines need to be read in before any "simple" lines.  This
 is so that we can assure that the first lines in the line array
-are macro-lines.   It is important to recognize that the lin_ptr
-structure does not have this property! */
+are macro-lines.   It is important to recognize that the lin_idx
+array does not have this property! */
   mflag = 1;
 
 
@@ -202,7 +206,10 @@ structure does not have this property! */
 
   /* OK now we can try to read in the data from the data files */
 
-  if ((mptr = fopen (masterfile, "r")) == NULL)
+  Trace_begin ("get_atomic_data");
+  Trace_begin ("read masterfile");
+
+  if (atomic_file_open (masterfile, &master_file))
   {
     Error ("Get_atomic_data: Could not find masterfile %s in current directory\n", masterfile);
     exit (1);
@@ -210,100 +217,108 @@ structure does not have this property! */
 
   Log ("Get_atomic_data: Reading from masterfile %s\n", masterfile);
 
-/* Open and read each line in the masterfile in turn */
+/* Read each of the files named in the masterfile into memory and break them into records.
+   The files are independent of one another, so this is done in parallel */
 
-  while (fgets (aline, LINELENGTH, mptr) != NULL)
+  nfiles = nfiles_max = 0;
+  dfiles = NULL;
+
+  while (atomic_file_next_line (&master_file, &aline))
   {
-    if (sscanf (aline, "%s", file) == 1 && file[0] != '#')
+    if (sscanf (aline, WORD_FORMAT, file) == 1 && file[0] != '#')
     {
-
-      /*
-       * Open one of the files designated in the masterfile and begin to read it
-       */
-
-      if ((fptr = fopen (file, "r")) == NULL)
+      if (nfiles == nfiles_max)
       {
-        Error ("Get_atomic_data: Could not open %s in current directory\n", file);
-        exit (1);
+        nfiles_max = (nfiles_max > 0) ? 2 * nfiles_max : 32;
+        if ((dfiles = realloc (dfiles, nfiles_max * sizeof (Atomic_data_file))) == NULL)
+        {
+          Error ("Get_atomic_data: Could not allocate memory for the list of data files\n");
+          exit (1);
+        }
       }
+      dfiles[nfiles].name = strdup (file);
+      nfiles++;
+    }
+  }
 
-      Log_silent ("Get_atomic_data: Reading data from %s\n", file);
-      lineno = 1;
+  atomic_file_close (&master_file);
+  Trace_end ("read masterfile");
 
-      /* Main loop for reading each data file line by line */
+  Trace_begin ("parse_atomic_files");
+  nthreads = parse_atomic_files (dfiles, nfiles);
+  Trace_end ("parse_atomic_files");
+  Log_silent ("Get_atomic_data: Parsed %d data files using %d threads\n", nfiles, nthreads);
 
-      while (fgets (aline, LINELENGTH, fptr) != NULL)
-      {
-        lineno++;
+  for (ifile = 0; ifile < nfiles; ifile++)
+  {
+    if (dfiles[ifile].status == 1)
+    {
+      Error ("Get_atomic_data: Could not open %s in current directory\n", dfiles[ifile].name);
+      exit (1);
+    }
+    else if (dfiles[ifile].status != 0)
+    {
+      Error ("Get_atomic_data: Ran out of memory while parsing %s\n", dfiles[ifile].name);
+      exit (1);
+    }
+  }
+
+/* Count the records of each type, and initialize the atomic data structures with exactly as
+   many entries as can be read into them */
+
+  Trace_begin ("init_atomic_data");
+  count_atomic_records (dfiles, nfiles, &atomic_max);
+  init_atomic_data ();
+
+/* Reserve space for all of the x-section points which were read.  Not all of them are
+   necessarily used, so the pool is compacted once the records have been applied */
+
+  npoints = 0;
+  for (ifile = 0; ifile < nfiles; ifile++)
+    npoints += dfiles[ifile].npoints;
+  xsection_pool_init (npoints);
+  Trace_end ("init_atomic_data");
+
+/* Now apply the records in the order they appear in the masterfile and each file.  The
+   order matters, since for example ions must be read before their levels */
 
-        Debug ("0  %d %s", lineno, aline);
+  Trace_begin ("apply records");
+  for (ifile = 0; ifile < nfiles; ifile++)
+  {
+    dfile = &dfiles[ifile];
+    strcpy (file, dfile->name);
+
+    Log_silent ("Get_atomic_data: Reading data from %s\n", file);
+
+    /* Main loop for applying each record of the file in turn */
+
+    for (irec = 0; irec < dfile->nrecords; irec++)
+    {
+      rec = &dfile->record[irec];
+      aline = rec->line;
+      lineno = rec->lineno;
+
+      Debug ("0  %d %s\n", lineno, aline);
 
-        strcpy (word, "");      /*For reasons which are not clear, word needs to be reinitialized every time to
+      strcpy (word, "");        /*For reasons which are not clear, word needs to be reinitialized every time to
                                    properly deal with blank lines */
+      sscanf (aline, WORD_FORMAT, word);
 
-        if (sscanf (aline, "%s", word) == 0 || strlen (word) == 0)
-          choice = 'c';         /*A blank line, treated like a comment */
-        else if (strncmp (word, "!", 1) == 0)
-          choice = 'c';         /* ! are also treated as  a comment */
-        else if (strncmp (word, "#", 1) == 0)
-          choice = 'c';         /* # is treated as  a comment */
-        else if (strncmp (word, "-", 1) == 0)
-          choice = 'c';         /* # is treated as  a comment */
-        else if (strncmp (word, "Dtype", 5) == 0)
-          choice = 'c';         /* # is treated as  a comment */
-        else if (strncmp (word, "CSTREN", 6) == 0)
-          choice = 'C';         /* It's a collision strength line */
-        else if (strncmp (word, "Element", 5) == 0)
-          choice = 'e';         /* an element */
-        else if (strncmp (word, "Ion", 3) == 0)
-          choice = 'i';         /* An ion */
-        else if (strncmp (word, "LevTop", 6) == 0)
-          choice = 'N';         /* A Level in TopBase format */
-        else if (strncmp (word, "LevMacro", 8) == 0)
-          choice = 'N';         /* A level for a Macro Atom */
-        else if (strncmp (word, "Level", 3) == 0)
-          choice = 'n';         /* A level for a simple ion */
-        else if (strncmp (word, "Phot", 4) == 0)
-          choice = 'w';         /* A record for starting a photionization x-section. Atom Phots are a subset of these */
-        else if (strncmp (word, "Line", 4) == 0)
-          choice = 'r';         /* A simple atom line */
-        else if (strncmp (word, "LinMacro", 8) == 0)
-          choice = 'r';         /* A line for a Macro Atom */
-        else if (strncmp (word, "AugMacro", 7) == 0)
-          choice = 'a';         /* An Auger record for a Macro Atom */
-        else if (strncmp (word, "Frac", 4) == 0)
-          choice = 'f';         /*ground state fractions */
-        else if (strncmp (word, "InnerVYS", 8) == 0)
-          choice = 'I';         /*a set of inner shell photoionization cross sections */
-        else if (strncmp (word, "DR_BADNL", 8) == 0)
-          choice = 'D';         /* a Badnell type dielectronic recombination file */
-        else if (strncmp (word, "DR_SHULL", 8) == 0)
-          choice = 'S';         /* A Shull-type  dielectronic recombination */
-        else if (strncmp (word, "RR_BADNL", 8) == 0)
-          choice = 'T';         /*Its a Badnell type line in the total RR file */
-        else if (strncmp (word, "DI_DERE", 7) == 0)
-          choice = 'd';         /*Its a data file giving direct ionization rates from Dere (2007) */
-        else if (strncmp (word, "RR_SHULL", 8) == 0)
-          choice = 's';         /*Its a Shull type line in the total RR file */
-        else if (strncmp (word, "BAD_GS_RR", 9) == 0)
-          choice = 'G';         /*Its a Badnell resolved ground state RR file */
-        else if (strncmp (word, "FF_GAUNT", 8) == 0)
-          choice = 'g';
-        /*Its a data file giving the temperature averaged gaunt factors from Sutherland (1998) */
-        else if (strncmp (word, "Kelecyield", 10) == 0)
-          choice = 'K';         /*Electron yield from inner shell ionization fro Kaastra and Mewe */
-        else if (strncmp (word, "ChEx", 4) == 0)
-          choice = 'X';         /*Charge exchange */
-//        else if (strncmp (word, "Kphotyield", 10) == 0) 
-//          choice = 'F';           /*Floruescent photon yield from IS ionization from Kaastra and Mewe */
-        else if (strncmp (word, "*", 1) == 0);
-        /* It's a continuation so record type remains same */
-        else
-          choice = 'z';         /* Who knows what it is */
+      if (rec->choice != '*')
+        choice = rec->choice;   /* A continuation record keeps the type of the previous record */
 
+      /* The continuation lines of these records are attached to them while parsing, which is
+         not possible for a continuation record at the very start of a file */
+      if (rec->type == '?' && strchr ("wIaC", choice) != NULL)
+      {
+        Error ("Get_atomic_data: file %s line %d: Continuation record cannot begin a file\n", file, lineno);
+        Error ("Get_atomic_data: %s\n", aline);
+        exit (0);
+      }
 
-        switch (choice)
-        {
+
+      switch (choice)
+      {
 /**
  * @section Elements
  *
@@ -315,24 +330,24 @@ structure does not have this property! */
  * and 12.011 is the atomic weight.
  *
  * */
-        case 'e':
-          if (sscanf (aline, "%*s %d %s %le %le", &ele[nelements].z, ele[nelements].name,
-                      &ele[nelements].abun, &ele[nelements].atomic_weight) != 4)
-          {
-            Error ("Get_atomic_data: file %s line %d: Element line incorrectly formatted\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
-          /* Immediate replace by number density relative to H */
-          ele[nelements].abun = pow (10., ele[nelements].abun - 12.0);
-          nelements++;
-          if (nelements > NELEMENTS)
-          {
-            Error ("getatomic_data: file %s line %d: More elements than allowed. Increase NELEMENTS in atomic.h\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
-          break;
+      case 'e':
+        if (sscanf (aline, "%*s %d %s %le %le", &ele[nelements].z, ele[nelements].name,
+                    &ele[nelements].abun, &ele[nelements].atomic_weight) != 4)
+        {
+          Error ("Get_atomic_data: file %s line %d: Element line incorrectly formatted\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        /* Immediate replace by number density relative to H */
+        ele[nelements].abun = pow (10., ele[nelements].abun - 12.0);
+        nelements++;
+        if (nelements > atomic_max.nelements)
+        {
+          Error ("getatomic_data: file %s line %d: More elements than were counted\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        break;
 
 
 /**
@@ -361,72 +376,72 @@ structure does not have this property! */
  *
  */
 
-        case 'i':
+      case 'i':
 
-          if ((nwords = sscanf (aline, "%*s %*s %d %d %le %le %d %d", &z, &istate, &gg, &p, &nmax, &nlte)) != 6)
-          {
-            Error ("get_atomic_data: file %s line %d: Ion istate line incorrectly formatted\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
+        if ((nwords = sscanf (aline, "%*s %*s %d %d %le %le %d %d", &z, &istate, &gg, &p, &nmax, &nlte)) != 6)
+        {
+          Error ("get_atomic_data: file %s line %d: Ion istate line incorrectly formatted\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
 // Now check that an element line for this ion has already been read
-          n = 0;
-          while (ele[n].z != z && n < nelements)
-            n++;
-          if (n == nelements)
-          {
+        n = 0;
+        while (ele[n].z != z && n < nelements)
+          n++;
+        if (n == nelements)
+        {
 
-            Debug ("get_atomic_data: file %s line %d has ion for unknown element with z %d\n", file, lineno, z);
-            break;
-          }
+          Debug ("get_atomic_data: file %s line %d has ion for unknown element with z %d\n", file, lineno, z);
+          break;
+        }
 
 // Now populate the ion structure
 
-          if (nlte > 0)
-          {                     // Then we want to consider some of these levels as non-lte
-            ion[nions].first_levden = nlte_levels;      /* This is the index to into
-                                                           the levden aray */
-            ion[nions].n_lte_max = nlte;        //Reserve this many elements of levden
-            nlte_levels += nlte;
-            if (nlte_levels > NLTE_LEVELS)
-            {
-              Error ("get_atomic_data: nlte_levels (%d) > NLTE_LEVELS (%d)\n", nlte_levels, NLTE_LEVELS);
-              exit (0);
-            }
-
-          }
-          ion[nions].z = z;
-          ion[nions].istate = istate;
-          ion[nions].g = gg;
-          ion[nions].log_g = log (gg);  //populate the log version - used for freebound integrations
-
-          ion[nions].ip = p * EV2ERGS;
-          ion[nions].nmax = nmax;
-/* Use the keyword IonM to classify the ion as a macro-ion (IonM) or not (simply Ion) */
-          if (ion[nions].g != 1 && ion[nions].istate == (ion[nions].z + 1))     // RG addressing bug #749
-          {
-            Error ("g is >1 for bare ion! setting to 1\n");
-            ion[nions].g = 1;
-          }
-          if (strncmp (word, "IonM", 4) == 0)
-          {
-            ion[nions].macro_info = 1;
-            nions_macro++;
-          }
-          else
+        if (nlte > 0)
+        {                     // Then we want to consider some of these levels as non-lte
+          ion[nions].first_levden = nlte_levels;      /* This is the index to into
+                                                         the levden aray */
+          ion[nions].n_lte_max = nlte;        //Reserve this many elements of levden
+          nlte_levels += nlte;
+          if (nlte_levels > NLTE_LEVELS)
           {
-            ion[nions].macro_info = 0;
-            nions_simple++;
-          }
-          nions++;
-          if (nions == NIONS)
-          {
-            Error
-              ("getatomic_data: file %s line %d: %d ions is more than %d allowed. Increase NIONS in atomic.h\n",
-               file, lineno, nions, NIONS);
+            Error ("get_atomic_data: nlte_levels (%d) > NLTE_LEVELS (%d)\n", nlte_levels, NLTE_LEVELS);
             exit (0);
           }
-          break;
+
+        }
+        ion[nions].z = z;
+        ion[nions].istate = istate;
+        ion[nions].g = gg;
+        ion[nions].log_g = log (gg);  //populate the log version - used for freebound integrations
+
+        ion[nions].ip = p * EV2ERGS;
+        ion[nions].nmax = nmax;
+/* Use the keyword IonM to classify the ion as a macro-ion (IonM) or not (simply Ion) */
+        if (ion[nions].g != 1 && ion[nions].istate == (ion[nions].z + 1))     // RG addressing bug #749
+        {
+          Error ("g is >1 for bare ion! setting to 1\n");
+          ion[nions].g = 1;
+        }
+        if (strncmp (word, "IonM", 4) == 0)
+        {
+          ion[nions].macro_info = 1;
+          nions_macro++;
+        }
+        else
+        {
+          ion[nions].macro_info = 0;
+          nions_simple++;
+        }
+        nions++;
+        if (nions == NIONS)
+        {
+          Error
+            ("getatomic_data: file %s line %d: %d ions is more than %d allowed. Increase NIONS in atomic.h\n",
+             file, lineno, nions, NIONS);
+          exit (0);
+        }
+        break;
 
 /**
  * @section levels Levels or Configurations
@@ -536,9 +551,9 @@ structure does not have this property! */
  * */
 
 
-        case 'N':
+      case 'N':
 /*
-    It's a non-lte level, i.e. one for which we are going to calculate populations, at least for some number of these.
+  It's a non-lte level, i.e. one for which we are going to calculate populations, at least for some number of these.
 	For these, we have to set aside space in the levden array in the plasma structure.  This is used for topbase
 	photoionization and macro atoms
 */
@@ -553,71 +568,71 @@ the program working in both cases, and certainly mixed cases  04apr ksl  */
  * last bit is not actually new.
  */
 
-          if (strncmp (word, "LevTop", 6) == 0)
-          {                     //Its a TOPBASESTYLE level
-            sscanf (aline,
-                    "%*s %d %d %d %d %le %le %le %le %le %15c \n", &zz, &iistate, &islp, &ilv, &e, &exx, &ggg, &qqnum, &rl, configname);
-            istate = iistate;
-            z = zz;
-            gg = ggg;
-            exx *= EV2ERGS;     // Convert energy above ground to ergs
-            mflag = -1;         //record that this is a LevTop not LevMacro read
-            lev_type = 2;       // It's a topbase record
-          }
+        if (strncmp (word, "LevTop", 6) == 0)
+        {                     //Its a TOPBASESTYLE level
+          sscanf (aline,
+                  "%*s %d %d %d %d %le %le %le %le %le %15c \n", &zz, &iistate, &islp, &ilv, &e, &exx, &ggg, &qqnum, &rl, configname);
+          istate = iistate;
+          z = zz;
+          gg = ggg;
+          exx *= EV2ERGS;     // Convert energy above ground to ergs
+          mflag = -1;         //record that this is a LevTop not LevMacro read
+          lev_type = 2;       // It's a topbase record
+        }
 
-          else if (strncmp (word, "LevMacro", 8) == 0)
-          {                     //It's a Macro Atom level (SS)
-            sscanf (aline, "%*s %d %d %d %le %le %le %le %15c \n", &zz, &iistate, &ilv, &e, &exx, &ggg, &rl, configname);
-            islp = -1;          //these indices are not going to be used so just leave
-            qqnum = -1;         //them at -1
-            mflag = 1;          //record Macro read
-            lev_type = 1;       // It's a Macro record
-            istate = iistate;
-            z = zz;
-            gg = ggg;
-            exx *= EV2ERGS;
-          }
-          else
-          {
-            Error ("get_atomic_data: file %s line %d: Level line incorrectly formatted\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-            return (0);
-          }
+        else if (strncmp (word, "LevMacro", 8) == 0)
+        {                     //It's a Macro Atom level (SS)
+          sscanf (aline, "%*s %d %d %d %le %le %le %le %15c \n", &zz, &iistate, &ilv, &e, &exx, &ggg, &rl, configname);
+          islp = -1;          //these indices are not going to be used so just leave
+          qqnum = -1;         //them at -1
+          mflag = 1;          //record Macro read
+          lev_type = 1;       // It's a Macro record
+          istate = iistate;
+          z = zz;
+          gg = ggg;
+          exx *= EV2ERGS;
+        }
+        else
+        {
+          Error ("get_atomic_data: file %s line %d: Level line incorrectly formatted\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+          return (0);
+        }
 
 /* Now check that the ion for this level is known, and that the number of levels does not exceed the maximum
-   specified..  If not break out */
+ specified..  If not break out */
 
-          n = 0;
-          while ((ion[n].z != z || ion[n].istate != istate) && n < nions)
-            n++;
-          if (n == nions)
-          {
+        n = 0;
+        while ((ion[n].z != z || ion[n].istate != istate) && n < nions)
+          n++;
+        if (n == nions)
+        {
 
-            Debug ("get_atomic_data: file %s line %d has level for unknown ion \n", file, lineno);
-            break;
-          }
+          Debug ("get_atomic_data: file %s line %d has level for unknown ion \n", file, lineno);
+          break;
+        }
 
 
-          if (lev_type == 1 && ilv > ion[n].n_lte_max)
-          {
-            Error ("get_atomic_data: macro level %3d ge %3d for z %3d  istate %3d\n", ilv, ion[n].n_lte_max, ion[n].z, ion[n].istate);
-            break;
-          }
+        if (lev_type == 1 && ilv > ion[n].n_lte_max)
+        {
+          Error ("get_atomic_data: macro level %3d ge %3d for z %3d  istate %3d\n", ilv, ion[n].n_lte_max, ion[n].z, ion[n].istate);
+          break;
+        }
 
 /*  So now we know that this level can be associated with an ion.  Now either
-    verify that the level type is the same that has been established previouly
-    or set the level type for this ion.
+  verify that the level type is the same that has been established previouly
+  or set the level type for this ion.
 		   */
 
-          if (ion[n].lev_type == (-1))
-          {
-            ion[n].lev_type = lev_type;
-          }
-          else if (ion[n].lev_type != lev_type)
-          {
-            break;
-          }
+        if (ion[n].lev_type == (-1))
+        {
+          ion[n].lev_type = lev_type;
+        }
+        else if (ion[n].lev_type != lev_type)
+        {
+          break;
+        }
 
 /*
  Now check 1) if it was a LevMacro that there isn't already a LevTop (if there was then
@@ -628,217 +643,217 @@ the program working in both cases, and certainly mixed cases  04apr ksl  */
 
 
 // Next steps should never happen; we have added a more robust mechanism to prevent any kind of mix and match above
-          if (ion[n].macro_info == 1 && mflag == -1)
-          {                     //it is already flagged as macro atom - current read is for LevTop - don't use it (SS)
-            Error ("Get_atomic_data: file %s  Ignoring LevTop data for ion %d - already using Macro Atom data\n", file, n);
-            break;
-          }
-          if (ion[n].macro_info == 0 && mflag == 1)
-          {                     //It is already flagged as simple atom and this is  before MacroAtom data - so ignore.  ksl
-            Error ("Get_atomic_data: file %s  Trying to read MacroAtom data after LevTop data for ion %d. Not allowed\n", file, n);
-            break;
-          }
-
+        if (ion[n].macro_info == 1 && mflag == -1)
+        {                     //it is already flagged as macro atom - current read is for LevTop - don't use it (SS)
+          Error ("Get_atomic_data: file %s  Ignoring LevTop data for ion %d - already using Macro Atom data\n", file, n);
+          break;
+        }
+        if (ion[n].macro_info == 0 && mflag == 1)
+        {                     //It is already flagged as simple atom and this is  before MacroAtom data - so ignore.  ksl
+          Error ("Get_atomic_data: file %s  Trying to read MacroAtom data after LevTop data for ion %d. Not allowed\n", file, n);
+          break;
+        }
 
-          if (mflag == 1)
-          {
-            xconfig[nlevels].macro_info = 1;
 
-            /* Extra check added here to be sure that the level emissivities used in the
-               detailed spectrum calculation won't get messed up. The next loop should
-               never trigger and can probably be deleted but I just want to check it for now.
-               SS June 04. */
+        if (mflag == 1)
+        {
+          xconfig[nlevels].macro_info = 1;
 
-            if (nlevels_macro != nlevels)
-            {
-              Error ("get_atomicdata: Simple level has appeared before macro level. Not allowed.\n");
-              exit (0);
-            }
-            nlevels_macro++;
+          /* Extra check added here to be sure that the level emissivities used in the
+             detailed spectrum calculation won't get messed up. The next loop should
+             never trigger and can probably be deleted but I just want to check it for now.
+             SS June 04. */
 
-            if (nlevels_macro > NLEVELS_MACRO)
-            {
-              Error ("get_atomicdata: Too many macro atom levels. Increase NLEVELS_MACRO. Abort. \n");
-              exit (0);
-            }
+          if (nlevels_macro != nlevels)
+          {
+            Error ("get_atomicdata: Simple level has appeared before macro level. Not allowed.\n");
+            exit (0);
           }
-          else
+          nlevels_macro++;
+
+          if (nlevels_macro > NLEVELS_MACRO)
           {
-            xconfig[nlevels].macro_info = 0;
-            nlevels_simple++;
+            Error ("get_atomicdata: Too many macro atom levels. Increase NLEVELS_MACRO. Abort. \n");
+            exit (0);
           }
+        }
+        else
+        {
+          xconfig[nlevels].macro_info = 0;
+          nlevels_simple++;
+        }
 
-          xconfig[nlevels].z = z;
-          xconfig[nlevels].istate = istate;
-          xconfig[nlevels].isp = islp;
-          xconfig[nlevels].ilv = ilv;
-          xconfig[nlevels].nion = n;
-          xconfig[nlevels].q_num = qqnum;
-          xconfig[nlevels].g = gg;
-          xconfig[nlevels].log_g = log (gg);    //The log version used for integrals in freebound
-          xconfig[nlevels].ex = exx;
-          xconfig[nlevels].rad_rate = rl;
+        xconfig[nlevels].z = z;
+        xconfig[nlevels].istate = istate;
+        xconfig[nlevels].isp = islp;
+        xconfig[nlevels].ilv = ilv;
+        xconfig[nlevels].nion = n;
+        xconfig[nlevels].q_num = qqnum;
+        xconfig[nlevels].g = gg;
+        xconfig[nlevels].log_g = log (gg);    //The log version used for integrals in freebound
+        xconfig[nlevels].ex = exx;
+        xconfig[nlevels].rad_rate = rl;
 
 
-          if (ion[n].n_lte_max > 0)
+        if (ion[n].n_lte_max > 0)
+        {
+          if (ion[n].first_nlte_level < 0)
           {
-            if (ion[n].first_nlte_level < 0)
-            {
-              ion[n].first_nlte_level = nlevels;
-              ion[n].nlte = 1;
-              xconfig[nlevels].nden = ion[n].first_levden;
-            }
-            else if (ion[n].n_lte_max > ion[n].nlte)
-            {
-              xconfig[nlevels].nden = ion[n].first_levden + ion[n].nlte;
-              ion[n].nlte++;
-            }
-            else
-            {
-              xconfig[nlevels].nden = -1;
-            }
+            ion[n].first_nlte_level = nlevels;
+            ion[n].nlte = 1;
+            xconfig[nlevels].nden = ion[n].first_levden;
+          }
+          else if (ion[n].n_lte_max > ion[n].nlte)
+          {
+            xconfig[nlevels].nden = ion[n].first_levden + ion[n].nlte;
+            ion[n].nlte++;
           }
           else
           {
             xconfig[nlevels].nden = -1;
           }
+        }
+        else
+        {
+          xconfig[nlevels].nden = -1;
+        }
 
 
 /* Now associate this config with the levden array where appropriate.  */
 
-          if (ion[n].firstlevel < 0)
-          {
-            ion[n].firstlevel = nlevels;
-            ion[n].nlevels = 1;
-          }
-          else
-            ion[n].nlevels++;
+        if (ion[n].firstlevel < 0)
+        {
+          ion[n].firstlevel = nlevels;
+          ion[n].nlevels = 1;
+        }
+        else
+          ion[n].nlevels++;
 
-          nlevels++;
+        nlevels++;
 
-          if (nlevels > NLEVELS)
-          {
-            Error ("getatomic_data: file %s line %d: More energy levels than allowed. Increase NLEVELS in atomic.h\n", file, lineno);
-            exit (0);
-          }
-          break;
+        if (nlevels > atomic_max.nlevels)
+        {
+          Error ("getatomic_data: file %s line %d: More energy levels than were counted\n", file, lineno);
+          exit (0);
+        }
+        break;
 
-        case 'n':              // Its an "LTE" level
+      case 'n':              // Its an "LTE" level
 
-          if (sscanf (aline, "%*s %d %d %d %le %le\n", &zz, &iistate, &qnum, &gg, &exx) == 5)   //IT's KURUCZSTYLE
-          {
-            istate = iistate;
-            z = zz;
-            exx *= EV2ERGS;
-            qqnum = ilv = qnum;
-            lev_type = 0;       // It's a Kurucz-style record
+        if (sscanf (aline, "%*s %d %d %d %le %le\n", &zz, &iistate, &qnum, &gg, &exx) == 5)   //IT's KURUCZSTYLE
+        {
+          istate = iistate;
+          z = zz;
+          exx *= EV2ERGS;
+          qqnum = ilv = qnum;
+          lev_type = 0;       // It's a Kurucz-style record
 
-          }
-          else                  // Read an OLDSTYLE level description
-          if (sscanf (aline, "%*s  %d %le %le\n", &qnum, &gg, &exx) == 3)
-          {
-            exx *= EV2ERGS;
-            qqnum = ilv = qnum;
-            lev_type = -2;      // It's an old style record, one which is only here for backward compatibility
-          }
-          else
-          {
-            Error ("get_atomic_data: file %s line %d: Level line incorrectly formatted\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-            return (0);
-          }
+        }
+        else                  // Read an OLDSTYLE level description
+        if (sscanf (aline, "%*s  %d %le %le\n", &qnum, &gg, &exx) == 3)
+        {
+          exx *= EV2ERGS;
+          qqnum = ilv = qnum;
+          lev_type = -2;      // It's an old style record, one which is only here for backward compatibility
+        }
+        else
+        {
+          Error ("get_atomic_data: file %s line %d: Level line incorrectly formatted\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+          return (0);
+        }
 /* Check whether the ion for this level is known.  If not, skip the level */
 
 // Next section is identical already to case N
-          n = 0;
-          while ((ion[n].z != z || ion[n].istate != istate) && n < nions)
-            n++;
-          if (n == nions)
-          {
+        n = 0;
+        while ((ion[n].z != z || ion[n].istate != istate) && n < nions)
+          n++;
+        if (n == nions)
+        {
 
-            Debug ("get_atomic_data: file %s line %d has level for unknown ion \n", file, lineno);
-            break;
+          Debug ("get_atomic_data: file %s line %d has level for unknown ion \n", file, lineno);
+          break;
 
-          }
+        }
 
-          /* Now either set the type of level that will be used for this ion or set it if
-           * a level type has not been established
-           */
+        /* Now either set the type of level that will be used for this ion or set it if
+         * a level type has not been established
+         */
 
-          if (ion[n].lev_type == (-1))
-          {
-            ion[n].lev_type = lev_type;
-          }
-          else if (ion[n].lev_type != lev_type)
-          {
+        if (ion[n].lev_type == (-1))
+        {
+          ion[n].lev_type = lev_type;
+        }
+        else if (ion[n].lev_type != lev_type)
+        {
 
-            break;
-          }
+          break;
+        }
 //  End section known to be idential to case N
 
 
 /* Check whether this is a macro-ion.  If it is a macro-ion, but the level appears to be described as a
 simple level (i.e without a keyword LeVMacro), then skip it, since a macro-ion has to have all the levels
 described as macro-levels. */
-          if (ion[n].macro_info == 1)
-          {
-            Error ("get_atomic_data: file %s line %d has simple level for ion[%d], which is a macro-ion\n", file, lineno, n);
-            break;
-          }
+        if (ion[n].macro_info == 1)
+        {
+          Error ("get_atomic_data: file %s line %d has simple level for ion[%d], which is a macro-ion\n", file, lineno, n);
+          break;
+        }
 /* Check to prevent one from adding simple levels to an ionized that already has some nlte levels.  Note that
-   an ion may have simple levels, i.e. levels with no entries in the plasma structure levden array, but this
-   will only be the case if there are too many of this type of level.
+ an ion may have simple levels, i.e. levels with no entries in the plasma structure levden array, but this
+ will only be the case if there are too many of this type of level.
 */
-          if (ion[n].nlte > 0)
-          {
-            Error ("get_atomic_data:  file %s line %d has simple level for ion[%d], which has non_lte_levels\n", file, lineno, n);
-            break;
-          }
+        if (ion[n].nlte > 0)
+        {
+          Error ("get_atomic_data:  file %s line %d has simple level for ion[%d], which has non_lte_levels\n", file, lineno, n);
+          break;
+        }
 
 /*  Check whether we already have too many levels specified for this ion. If so, skip */
-          if (ion[n].nmax == ion[n].nlevels)
-          {
+        if (ion[n].nmax == ion[n].nlevels)
+        {
 
-            Debug ("get_atomic_data: file %s line %d has level exceeding the number allowed for ion[%d]\n", file, lineno, n);
+          Debug ("get_atomic_data: file %s line %d has level exceeding the number allowed for ion[%d]\n", file, lineno, n);
 
-            break;
-          }
+          break;
+        }
 //  So now we know that this level can be associated with an ion
 
-          xconfig[nlevels].z = z;
-          xconfig[nlevels].istate = istate;
-          xconfig[nlevels].isp = islp;
-          xconfig[nlevels].ilv = ilv;
-          xconfig[nlevels].nion = n;    //Internal index to ion structure
-          xconfig[nlevels].q_num = qqnum;
-          xconfig[nlevels].g = gg;
-          xconfig[nlevels].ex = exx;
-          if (ion[n].firstlevel < 0)
-          {
-            ion[n].firstlevel = nlevels;
-            ion[n].nlevels = 1;
-          }
-          else
-            ion[n].nlevels++;
+        xconfig[nlevels].z = z;
+        xconfig[nlevels].istate = istate;
+        xconfig[nlevels].isp = islp;
+        xconfig[nlevels].ilv = ilv;
+        xconfig[nlevels].nion = n;    //Internal index to ion structure
+        xconfig[nlevels].q_num = qqnum;
+        xconfig[nlevels].g = gg;
+        xconfig[nlevels].ex = exx;
+        if (ion[n].firstlevel < 0)
+        {
+          ion[n].firstlevel = nlevels;
+          ion[n].nlevels = 1;
+        }
+        else
+          ion[n].nlevels++;
 
 
 /* Now declare that this level has no corresponding element in the levden array which is part
-   of the plasma stucture.  To do this set config[].ndent to -1
+ of the plasma stucture.  To do this set config[].ndent to -1
 */
 
-          xconfig[nlevels].nden = -1;
+        xconfig[nlevels].nden = -1;
 
-          xconfig[nlevels].rad_rate = 0.0;      // ?? Set emission oscillator strength for the level to zero
+        xconfig[nlevels].rad_rate = 0.0;      // ?? Set emission oscillator strength for the level to zero
 
-          nlevels_simple++;
-          nlevels++;
-          if (nlevels > NLEVELS)
-          {
-            Error ("getatomic_data: file %s line %d: More energy levels than allowed. Increase NLEVELS in atomic.h\n", file, lineno);
-            exit (0);
-          }
-          break;
+        nlevels_simple++;
+        nlevels++;
+        if (nlevels > atomic_max.nlevels)
+        {
+          Error ("getatomic_data: file %s line %d: More energy levels than were counted\n", file, lineno);
+          exit (0);
+        }
+        break;
 
 
 
@@ -921,544 +936,491 @@ described as macro-levels. */
  *   		one need modify only the higher level elements_ions file
  */
 
-        case 'w':
-          if (strncmp (word, "PhotMacS", 8) == 0)
+      case 'w':
+        if (strncmp (word, "PhotMacS", 8) == 0)
+        {
+          // It's a Macro atom entry - similar format to TOPBASE - see below (SS)
+          sscanf (aline, "%*s %d %d %d %d %le %d \n", &z, &istate, &levl, &levu, &exx, &np);
+          Log_silent ("Get_atomic_data:PhotMacS  %d %d %d %d %le %d Start\n", z, istate, levl, levu, exx, np);
+          islp = -1;
+          ilv = -1;
+
+          if (np > NCROSS)
           {
-            // It's a Macro atom entry - similar format to TOPBASE - see below (SS)
-            sscanf (aline, "%*s %d %d %d %d %le %d \n", &z, &istate, &levl, &levu, &exx, &np);
-            Log_silent ("Get_atomic_data:PhotMacS  %d %d %d %d %le %d Start\n", z, istate, levl, levu, exx, np);
-            islp = -1;
-            ilv = -1;
+            Error ("Get_atomicdata: More x-sections (%d) to be read in than maximum allowed (%d).  Increase NCROSS\n", np, NCROSS);
+            Error ("Get_atomic_data: %s\n", aline);
+            exit (0);
+          }
 
-            if (np > NCROSS)
-            {
-              Error ("Get_atomicdata: More x-sections (%d) to be read in than maximum allowed (%d).  Increase NCROSS\n", np, NCROSS);
-              Error ("Get_atomic_data: %s\n", aline);
-              exit (0);
-            }
-
-            for (n = 0; n < np; n++)
-            {
-              //Read the photo. records but do nothing with them until verifyina a valid level
-              if (fgets (aline, LINELENGTH, fptr) == NULL)
-              {
-                Error ("Get_atomic_data: Problem reading topbase photoionization record\n");
-                Error ("Get_atomic_data: %s\n", aline);
-                exit (0);
-              }
-              sscanf (aline, "%*s %le %le", &xe[n], &xx[n]);
-              lineno++;
-            }
+          //The photo. records were read with this one, but do nothing with them until verifying a valid level
+          if (rec->np < np)
+          {
+            Error ("Get_atomic_data: Problem reading topbase photoionization record\n");
+            Error ("Get_atomic_data: %s\n", aline);
+            exit (0);
+          }
+          xe = &dfile->xe[rec->index];
+          xx = &dfile->xx[rec->index];
+          lineno += rec->np;
 
-            // Locate upper state
-            n = 0;
-            while ((xconfig[n].z != z || xconfig[n].istate != (istate + 1)      //note that the upper config will (SS)
-                    || xconfig[n].ilv != levu) && n < nlevels)
-            {                   //be the next ion up (istate +1) (SS)
-              n++;
-            }
+          // Locate upper state
+          n = 0;
+          while ((xconfig[n].z != z || xconfig[n].istate != (istate + 1)      //note that the upper config will (SS)
+                  || xconfig[n].ilv != levu) && n < nlevels)
+          {                   //be the next ion up (istate +1) (SS)
+            n++;
+          }
 
-            if (n == nlevels)
-            {
-              Log_silent ("Get_atomic_data: PhotMacS No configuration found to match upper state for phot. line %d\n", lineno);
-              break;            //Need to match the configuration for macro atoms - break if not found.
-            }
-            else
-            {
-              Log_silent ("Get_atomic_data: PhotMacS Matched upper level configuration  %d %d %d %d %d %d %d\n", xconfig[n].z, z,
-                          xconfig[n].istate, (istate + 1), xconfig[n].ilv, levu, n);
-            }
+          if (n == nlevels)
+          {
+            Log_silent ("Get_atomic_data: PhotMacS No configuration found to match upper state for phot. line %d\n", lineno);
+            break;            //Need to match the configuration for macro atoms - break if not found.
+          }
+          else
+          {
+            Log_silent ("Get_atomic_data: PhotMacS Matched upper level configuration  %d %d %d %d %d %d %d\n", xconfig[n].z, z,
+                        xconfig[n].istate, (istate + 1), xconfig[n].ilv, levu, n);
+          }
 
 
-            // Locate lower state
-            m = 0;
-            while ((xconfig[m].z != z || xconfig[m].istate != istate    //Now searching for the lower
-                    || xconfig[m].ilv != levl) && m < nlevels)  //configuration (SS)
-              m++;
-            if (m == nlevels)
-            {
-              Log_silent ("Get_atomic_data: PhotMacS No configuration found to match lower state (%d) for phot. line %d\n", levl, lineno);
-              break;            //Need to match the configuration for macro atoms - break if not found.
-            }
-            else
-            {
-              Log_silent ("Get_atomic_data: PhotMacS Matched lower level configuration (%d) for phot. line %d\n", levl, lineno);
-            }
+          // Locate lower state
+          m = 0;
+          while ((xconfig[m].z != z || xconfig[m].istate != istate    //Now searching for the lower
+                  || xconfig[m].ilv != levl) && m < nlevels)  //configuration (SS)
+            m++;
+          if (m == nlevels)
+          {
+            Log_silent ("Get_atomic_data: PhotMacS No configuration found to match lower state (%d) for phot. line %d\n", levl, lineno);
+            break;            //Need to match the configuration for macro atoms - break if not found.
+          }
+          else
+          {
+            Log_silent ("Get_atomic_data: PhotMacS Matched lower level configuration (%d) for phot. line %d\n", levl, lineno);
+          }
 
-            // Populate upper state info
-            phot_top[ntop_phot].uplev = n;      //store the level in the upper ion (SS)
-            xconfig[n].bfd_jump[xconfig[n].n_bfd_jump] = ntop_phot;     //record the line index as a downward bf Macro Atom jump (SS)
-            phot_top[ntop_phot].down_index = xconfig[n].n_bfd_jump;     //record jump index in the photoionization structure
-            xconfig[n].n_bfd_jump += 1; //note that there is one more downwards bf jump available (SS)
-            if (xconfig[n].n_bfd_jump > NBFJUMPS)
-            {
-              Error ("get_atomic_data: PhotMacS Too many downward b-f jump for ion %d\n", xconfig[n].istate);
-              exit (0);
-            }
+          // Populate upper state info
+          phot_top[ntop_phot].uplev = n;      //store the level in the upper ion (SS)
+          jump_list_add (&bfd_jumps, n, ntop_phot);   //record the line index as a downward bf Macro Atom jump (SS)
+          phot_top[ntop_phot].down_index = xconfig[n].n_bfd_jump;     //record jump index in the photoionization structure
+          xconfig[n].n_bfd_jump += 1; //note that there is one more downwards bf jump available (SS)
 
 
-            // Populate lower state info
-            phot_top[ntop_phot].nlev = m;       //store lower configuration then find upper configuration(SS)
-            xconfig[m].bfu_jump[xconfig[m].n_bfu_jump] = ntop_phot;     //record the line index as an upward bf Macro Atom jump (SS)
-            phot_top[ntop_phot].up_index = xconfig[m].n_bfu_jump;       //record the jump index in the photoionization structure
-            xconfig[m].n_bfu_jump += 1; //note that there is one more upwards bf jump available (SS)
-            if (xconfig[m].n_bfu_jump > NBFJUMPS)
-            {
-              Error ("get_atomic_data: PhotMacS Too many upward b-f jump for ion %d\n", xconfig[m].istate);
-              exit (0);
-            }
+          // Populate lower state info
+          phot_top[ntop_phot].nlev = m;       //store lower configuration then find upper configuration(SS)
+          jump_list_add (&bfu_jumps, m, ntop_phot);   //record the line index as an upward bf Macro Atom jump (SS)
+          phot_top[ntop_phot].up_index = xconfig[m].n_bfu_jump;       //record the jump index in the photoionization structure
+          xconfig[m].n_bfu_jump += 1; //note that there is one more upwards bf jump available (SS)
 
 
-            phot_top[ntop_phot].nion = xconfig[m].nion;
-            phot_top[ntop_phot].z = z;
-            phot_top[ntop_phot].istate = istate;
-            phot_top[ntop_phot].np = np;
-            phot_top[ntop_phot].nlast = -1;
-            phot_top[ntop_phot].macro_info = 1;
+          phot_top[ntop_phot].nion = xconfig[m].nion;
+          phot_top[ntop_phot].z = z;
+          phot_top[ntop_phot].istate = istate;
+          phot_top[ntop_phot].np = np;
+          phot_top[ntop_phot].macro_info = 1;
 
-            if (ion[xconfig[m].nion].phot_info == -1)
-            {
-              ion[xconfig[m].nion].phot_info = 1;       /* Mark this ion as using TOPBASE photo */
-              ion[xconfig[m].nion].ntop_first = ntop_phot;
-            }
+          if (ion[xconfig[m].nion].phot_info == -1)
+          {
+            ion[xconfig[m].nion].phot_info = 1;       /* Mark this ion as using TOPBASE photo */
+            ion[xconfig[m].nion].ntop_first = ntop_phot;
+          }
 
-            /* next line sees if the topbase level just read in is the ground state -
-               if it is, the ion structure element ntop_ground is set to that topbase level number
-               note that m is the lower level here */
-            if (m == xconfig[ion[xconfig[n].nion].first_nlte_level].ilv)
-            {
-              ion[xconfig[n].nion].ntop_ground = ntop_phot;
-            }
+          /* next line sees if the topbase level just read in is the ground state -
+             if it is, the ion structure element ntop_ground is set to that topbase level number
+             note that m is the lower level here */
+          if (m == xconfig[ion[xconfig[n].nion].first_nlte_level].ilv)
+          {
+            ion[xconfig[n].nion].ntop_ground = ntop_phot;
+          }
 
-            ion[xconfig[m].nion].ntop++;
+          ion[xconfig[m].nion].ntop++;
 
-            // Finish up this section by storing the photionization data properly
-            Log_silent ("Get_atomic_data:PhotMacS  %d %d %d %d %le %d   Success\n", z, istate, levl, levu, exx, np);
+          // Finish up this section by storing the photionization data properly
+          Log_silent ("Get_atomic_data:PhotMacS  %d %d %d %d %le %d   Success\n", z, istate, levl, levu, exx, np);
 
-            for (n = 0; n < np; n++)
-            {
-              phot_top[ntop_phot].freq[n] = xe[n] * EV2ERGS / PLANCK;   // convert from eV to freqency
-              phot_top[ntop_phot].log_freq[n] = log (xe[n] * EV2ERGS / PLANCK); // log version
-              phot_top[ntop_phot].x[n] = xx[n]; // leave cross sections in  CGS
-              phot_top[ntop_phot].log_x[n] = log (xx[n]);       // log version
-            }
-            if (phot_freq_min > phot_top[ntop_phot].freq[0])
-              phot_freq_min = phot_top[ntop_phot].freq[0];
+          xsection_pool_add (&phot_top[ntop_phot], np, xe, xx);
+          if (phot_freq_min > xsection_pool.freq[phot_top[ntop_phot].offset])
+            phot_freq_min = xsection_pool.freq[phot_top[ntop_phot].offset];
 
 
-            ntop_phot_macro++;
-            ntop_phot++;
-            nphot_total++;
+          ntop_phot_macro++;
+          ntop_phot++;
+          nphot_total++;
 
-            if (nphot_total > NTOP_PHOT)
-            {
-              Error ("get_atomicdata: More macro photoionization cross sections that NTOP_PHOT (%d).  Increase in atomic.h\n", NTOP_PHOT);
-              exit (0);
-            }
-            break;
+          if (nphot_total > NTOP_PHOT)
+          {
+            Error ("get_atomicdata: More macro photoionization cross sections that NTOP_PHOT (%d).  Increase in atomic.h\n", NTOP_PHOT);
+            exit (0);
           }
+          break;
+        }
+
+        else if (strncmp (word, "PhotTopS", 8) == 0)
+        {
+          // It's a TOPBASE style photoionization record, beginning with the summary record
+          sscanf (aline, "%*s %d %d %d %d %le %d\n", &z, &istate, &islp, &ilv, &exx, &np);
 
-          else if (strncmp (word, "PhotTopS", 8) == 0)
+          if (np > NCROSS)
           {
-            // It's a TOPBASE style photoionization record, beginning with the summary record
-            sscanf (aline, "%*s %d %d %d %d %le %d\n", &z, &istate, &islp, &ilv, &exx, &np);
+            Error ("Get_atomicdata: More x-sections (%d) to be read in than maximum allowed (%d).  Increase NCROSS\n", np, NCROSS);
+            Error ("Get_atomic_data: %s\n", aline);
+            exit (0);
+          }
 
-            if (np > NCROSS)
-            {
-              Error ("Get_atomicdata: More x-sections (%d) to be read in than maximum allowed (%d).  Increase NCROSS\n", np, NCROSS);
-              Error ("Get_atomic_data: %s\n", aline);
-              exit (0);
-            }
+          //The topbase photoionization records were read with this one
+          if (rec->np < np)
+          {
+            Error ("Get_atomic_data: Problem reading topbase photoionization record\n");
+            Error ("Get_atomic_data: %s\n", aline);
+            exit (0);
+          }
+          xe = &dfile->xe[rec->index];
+          xx = &dfile->xx[rec->index];
+          lineno += rec->np;
 
-            for (n = 0; n < np; n++)
-            {                   //Read the topbase photoionization records
-              if (fgets (aline, LINELENGTH, fptr) == NULL)
-              {
-                Error ("Get_atomic_data: Problem reading topbase photoionization record\n");
-                Error ("Get_atomic_data: %s\n", aline);
-                exit (0);
-              }
-              sscanf (aline, "%*s %le %le", &xe[n], &xx[n]);
-              lineno++;
+          n = 0;
 
-            }
 
-            n = 0;
+          /* additional check to assure that records were
+           * only matched with levels whose density was being tracked in levden.  This
+           * is now necesary since a change was made to use topbase levels for calculating
+           * partition functions
+           */
 
+          while ((xconfig[n].nden == -1
+                  || xconfig[n].z != z || xconfig[n].istate != istate || xconfig[n].isp != islp || xconfig[n].ilv != ilv) && n < nlevels)
+            n++;
+          if (n == nlevels)
+          {
 
-            /* additional check to assure that records were
-             * only matched with levels whose density was being tracked in levden.  This
-             * is now necesary since a change was made to use topbase levels for calculating
-             * partition functions
-             */
+            Debug ("No level found to match PhotTop data in file %s on line %d. Data ignored.\n", file, lineno);
+            break;            // There was no pre-existing ion
+          }
+          if (ion[xconfig[n].nion].macro_info == 0)   //this is not a macro atom level (SS)
+          {
+            phot_top[ntop_phot].nlev = n;     // level associated with this crossection.
+            phot_top[ntop_phot].nion = xconfig[n].nion;
+            phot_top[ntop_phot].z = z;
+            phot_top[ntop_phot].istate = istate;
+            phot_top[ntop_phot].np = np;
+            phot_top[ntop_phot].macro_info = 0;
 
-            while ((xconfig[n].nden == -1
-                    || xconfig[n].z != z || xconfig[n].istate != istate || xconfig[n].isp != islp || xconfig[n].ilv != ilv) && n < nlevels)
-              n++;
-            if (n == nlevels)
+            /* next line sees if the topbase level just read in is the ground state -
+               if it is, the ion structure element ntop_ground is set to that topbase level number */
+            if (islp == xconfig[ion[xconfig[n].nion].first_nlte_level].isp && ilv == xconfig[ion[xconfig[n].nion].first_nlte_level].ilv)
             {
-
-              Debug ("No level found to match PhotTop data in file %s on line %d. Data ignored.\n", file, lineno);
-              break;            // There was no pre-existing ion
+              ion[xconfig[n].nion].ntop_ground = ntop_phot;
             }
-            if (ion[xconfig[n].nion].macro_info == 0)   //this is not a macro atom level (SS)
-            {
-              phot_top[ntop_phot].nlev = n;     // level associated with this crossection.
-              phot_top[ntop_phot].nion = xconfig[n].nion;
-              phot_top[ntop_phot].z = z;
-              phot_top[ntop_phot].istate = istate;
-              phot_top[ntop_phot].np = np;
-              phot_top[ntop_phot].nlast = -1;
-              phot_top[ntop_phot].macro_info = 0;
-
-              /* next line sees if the topbase level just read in is the ground state -
-                 if it is, the ion structure element ntop_ground is set to that topbase level number */
-              if (islp == xconfig[ion[xconfig[n].nion].first_nlte_level].isp && ilv == xconfig[ion[xconfig[n].nion].first_nlte_level].ilv)
-              {
-                ion[xconfig[n].nion].ntop_ground = ntop_phot;
-              }
 
 
-              if (ion[xconfig[n].nion].phot_info == -1)
-              {
-                ion[xconfig[n].nion].phot_info = 1;     /* Mark this ion as using TOPBASE photo */
-                ion[xconfig[n].nion].ntop_first = ntop_phot;
-
-              }
-              else if (ion[xconfig[n].nion].phot_info == (0))
-              {
-                Error
-                  ("Get_atomic_data: file %s VFKY and Topbase photoionization x-sections in wrong order for nion %d\n",
-                   file, xconfig[n].nion);
-                Error ("             Read topbase x-sections before VFKY if using both types!!\n");
-                exit (0);
-              }
-              ion[xconfig[n].nion].ntop++;
-              for (n = 0; n < np; n++)
-              {
-                phot_top[ntop_phot].freq[n] = xe[n] * EV2ERGS / PLANCK; // convert from eV to freqency
-                phot_top[ntop_phot].log_freq[n] = log (xe[n] * EV2ERGS / PLANCK);       // log version
-
-                phot_top[ntop_phot].x[n] = xx[n];       // leave cross sections in  CGS
-                phot_top[ntop_phot].log_x[n] = log (xx[n]);     // log version
-
-              }
-              if (phot_freq_min > phot_top[ntop_phot].freq[0])
-                phot_freq_min = phot_top[ntop_phot].freq[0];
-
-
-              ntop_phot_simple++;
-              ntop_phot++;
-              nphot_total++;
+            if (ion[xconfig[n].nion].phot_info == -1)
+            {
+              ion[xconfig[n].nion].phot_info = 1;     /* Mark this ion as using TOPBASE photo */
+              ion[xconfig[n].nion].ntop_first = ntop_phot;
 
-              /* check to assure we did not exceed the allowed number of photoionization records */
-              if (nphot_total > NTOP_PHOT)
-              {
-                Error
-                  ("get_atomicdata: More TopBase photoionization cross sections that NTOP_PHOT (%d).  Increase in atomic.h\n", NTOP_PHOT);
-                exit (0);
-              }
             }
-            else
+            else if (ion[xconfig[n].nion].phot_info == (0))
             {
               Error
-                ("Get_atomic_data: photoionisation data ignored since previously read Macro Atom input for the same ion. File: %s line: %d \n",
-                 file, lineno);
-            }
-            break;
-          }
-
-
-          /* Check that there is an ion which has the same ionization state as this record
-             otherwise it must be a VFKY style record and so read with that format */
-
-          else if (strncmp (word, "PhotVfkyS", 8) == 0)
-          {
-            // It's a VFKY style photoionization record, beginning with the summary record
-            sscanf (aline, "%*s %d %d %d %d %le %d\n", &z, &istate, &islp, &ilv, &exx, &np);
-            for (n = 0; n < np; n++)
-            {
-              //Read the cross-sections                     
-              if (fgets (aline, LINELENGTH, fptr) == NULL)
-              {
-                Error ("Get_atomic_data: Problem reading Vfky photoionization record\n");
-                Error ("Get_atomic_data: %s\n", aline);
-                exit (0);
-              }
-              sscanf (aline, "%*s %le %le", &xe[n], &xx[n]);
-              lineno++;
-
+                ("Get_atomic_data: file %s VFKY and Topbase photoionization x-sections in wrong order for nion %d\n",
+                 file, xconfig[n].nion);
+              Error ("             Read topbase x-sections before VFKY if using both types!!\n");
+              exit (0);
             }
+            ion[xconfig[n].nion].ntop++;
+            xsection_pool_add (&phot_top[ntop_phot], np, xe, xx);
+            if (phot_freq_min > xsection_pool.freq[phot_top[ntop_phot].offset])
+              phot_freq_min = xsection_pool.freq[phot_top[ntop_phot].offset];
 
-            for (nion = 0; nion < nions; nion++)
-            {
-              if (ion[nion].z == z && ion[nion].istate == istate && ion[nion].macro_info != 1)
-              {
-                if (ion[nion].phot_info == -1)
-                {
-                  /* Then there is a match */
-                  phot_top[nphot_total].nlev = ion[nion].firstlevel;    // ground state
-                  if (phot_top[nphot_total].nlev == -1)
-                  {
-                    Error ("get_atomicdata: Connecting a photoionization x-section to non-existent level z %3d istate %3d ex %8.3g\n", z,
-                           istate, exx);
-                  }
-                  phot_top[nphot_total].nion = nion;
-                  phot_top[nphot_total].z = z;
-                  phot_top[nphot_total].istate = istate;
-                  phot_top[nphot_total].np = np;
-                  phot_top[nphot_total].nlast = -1;
-                  phot_top[nphot_total].macro_info = 0;
-
-                  ion[nion].phot_info = 0;      /* Mark this ion as using VFKY photo */
-                  ion[nion].nxphot = nphot_total;
-
-                  for (n = 0; n < np; n++)
-                  {
-                    phot_top[nphot_total].freq[n] = xe[n] * EV2ERGS / PLANCK;   // convert from eV to freqency
-                    phot_top[nphot_total].log_freq[n] = log (xe[n] * EV2ERGS / PLANCK); // log version
-
-                    phot_top[nphot_total].x[n] = xx[n]; // leave cross sections in  CGS
-                    phot_top[nphot_total].log_x[n] = log (xx[n]);       // log version
-
-                  }
-                  if (phot_freq_min > phot_top[ntop_phot].freq[0])
-                    phot_freq_min = phot_top[ntop_phot].freq[0];
-                  nxphot++;
-                  nphot_total++;
-                }
 
-                else if (ion[nion].phot_info == 1 && ion[nion].macro_info != 1)
-                  /* We already have a topbase cross section, but the VFKY
-                     data is superior for the ground state, so we replace that data with the current data
-                     JM 1508 -- don't do this with macro-atoms for the moment */
-                {
-                  phot_top[ion[nion].ntop_ground].nlev = ion[nion].firstlevel;  // ground state
-                  phot_top[ion[nion].ntop_ground].nion = nion;
-                  phot_top[ion[nion].ntop_ground].z = z;
-                  phot_top[ion[nion].ntop_ground].istate = istate;
-                  phot_top[ion[nion].ntop_ground].np = np;
-                  phot_top[ion[nion].ntop_ground].nlast = -1;
-                  phot_top[ion[nion].ntop_ground].macro_info = 0;
-                  ion[nion].phot_info = 2;      //We mark this as having hybrid data - VFKY ground, TB excited, potentially VFKY innershell
-                  for (n = 0; n < np; n++)
-                  {
-                    phot_top[ion[nion].ntop_ground].freq[n] = xe[n] * EV2ERGS / PLANCK; // convert from eV to freqency
-                    phot_top[ion[nion].ntop_ground].log_freq[n] = log (xe[n] * EV2ERGS / PLANCK);       // convert from eV to freqency
-
-                    phot_top[ion[nion].ntop_ground].x[n] = xx[n];       // leave cross sections in  CGS
-                    phot_top[ion[nion].ntop_ground].log_x[n] = log (xx[n]);     // leave cross sections in  CGS
-
-                  }
-                  if (phot_freq_min > phot_top[ion[nion].ntop_ground].freq[0])
-                    phot_freq_min = phot_top[ion[nion].ntop_ground].freq[0];
-                  Debug
-                    ("Get_atomic_data: file %s  Replacing ground state topbase photoionization for ion %d with VFKY photoionization\n",
-                     file, nion);
-                }
-              }
-            }
+            ntop_phot_simple++;
+            ntop_phot++;
+            nphot_total++;
 
-            if (nxphot > NIONS)
-            {
-              Error ("getatomic_data: file %s line %d: More photoionization edges than IONS.\n", file, lineno);
-              exit (0);
-            }
+            /* check to assure we did not exceed the allowed number of photoionization records */
             if (nphot_total > NTOP_PHOT)
             {
-              Error ("get_atomicdata: More photoionization cross sections that NTOP_PHOT (%d).  Increase in atomic.h\n", NTOP_PHOT);
+              Error
+                ("get_atomicdata: More TopBase photoionization cross sections that NTOP_PHOT (%d).  Increase in atomic.h\n", NTOP_PHOT);
               exit (0);
             }
-
-            break;
           }
           else
           {
-            Error ("get_atomic_data: file %s line %d: photoionization line incorrectly formatted\n", file, lineno);
-            Log ("Make sure you are using the tabulated verner cross sections (photo_vfky_tabulated.data)\n");
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
+            Error
+              ("Get_atomic_data: photoionisation data ignored since previously read Macro Atom input for the same ion. File: %s line: %d \n",
+               file, lineno);
           }
+          break;
+        }
 
-          /* Input inner shell cross section data */
 
+        /* Check that there is an ion which has the same ionization state as this record
+           otherwise it must be a VFKY style record and so read with that format */
 
+        else if (strncmp (word, "PhotVfkyS", 8) == 0)
+        {
+          // It's a VFKY style photoionization record, beginning with the summary record
+          sscanf (aline, "%*s %d %d %d %d %le %d\n", &z, &istate, &islp, &ilv, &exx, &np);
 
-        case 'I':
-          if (sscanf (aline, "%*s %d %d %d %d %le %d\n", &z, &istate, &in, &il, &exx, &np) != 6)
+          if (np > NCROSS)
           {
-            Error ("Inner shell ionization data incorrectly formatted\n");
+            Error ("Get_atomicdata: More x-sections (%d) to be read in than maximum allowed (%d).  Increase NCROSS\n", np, NCROSS);
             Error ("Get_atomic_data: %s\n", aline);
             exit (0);
           }
-          for (n = 0; n < np; n++)
+
+          //The cross-sections were read with this record
+          if (rec->np < np)
           {
-            //Read the topbase photoionization records
-            if (fgets (aline, LINELENGTH, fptr) == NULL)
-            {
-              Error ("Get_atomic_data: Problem reading VY inner shell record\n");
-              Error ("Get_atomic_data: %s\n", aline);
-              exit (0);
-            }
-            sscanf (aline, "%*s %le %le", &xe[n], &xx[n]);
-            lineno++;
+            Error ("Get_atomic_data: Problem reading Vfky photoionization record\n");
+            Error ("Get_atomic_data: %s\n", aline);
+            exit (0);
           }
+          xe = &dfile->xe[rec->index];
+          xx = &dfile->xx[rec->index];
+          lineno += rec->np;
+
           for (nion = 0; nion < nions; nion++)
           {
             if (ion[nion].z == z && ion[nion].istate == istate && ion[nion].macro_info != 1)
             {
-              /* Then there is a match */
-              inner_cross[n_inner_tot].nlev = ion[nion].firstlevel;     //All these are for the ground state
-              inner_cross[n_inner_tot].nion = nion;
-              inner_cross[n_inner_tot].np = np;
-              inner_cross[n_inner_tot].z = z;
-              inner_cross[n_inner_tot].istate = istate;
-              inner_cross[n_inner_tot].n = in;
-              inner_cross[n_inner_tot].l = il;
-              inner_cross[n_inner_tot].nlast = -1;
-              ion[nion].n_inner++;      /*Increment the number of inner shells */
-              ion[nion].nxinner[ion[nion].n_inner] = n_inner_tot;
-              for (n = 0; n < np; n++)
+              if (ion[nion].phot_info == -1)
               {
-                inner_cross[n_inner_tot].freq[n] = xe[n] * EV2ERGS / PLANCK;    // convert from eV to freqency
-                inner_cross[n_inner_tot].log_freq[n] = log (xe[n] * EV2ERGS / PLANCK);  // convert from eV to freqency
-
-                inner_cross[n_inner_tot].x[n] = xx[n];  // leave cross sections in  CGS
-                inner_cross[n_inner_tot].log_x[n] = log (xx[n]);        // leave cross sections in  CGS
-
+                /* Then there is a match */
+                phot_top[nphot_total].nlev = ion[nion].firstlevel;    // ground state
+                if (phot_top[nphot_total].nlev == -1)
+                {
+                  Error ("get_atomicdata: Connecting a photoionization x-section to non-existent level z %3d istate %3d ex %8.3g\n", z,
+                         istate, exx);
+                }
+                phot_top[nphot_total].nion = nion;
+                phot_top[nphot_total].z = z;
+                phot_top[nphot_total].istate = istate;
+                phot_top[nphot_total].np = np;
+                phot_top[nphot_total].macro_info = 0;
+
+                ion[nion].phot_info = 0;      /* Mark this ion as using VFKY photo */
+                ion[nion].nxphot = nphot_total;
+
+                xsection_pool_add (&phot_top[nphot_total], np, xe, xx);
+                if (phot_freq_min > xsection_pool.freq[phot_top[ntop_phot].offset])
+                  phot_freq_min = xsection_pool.freq[phot_top[ntop_phot].offset];
+                nxphot++;
+                nphot_total++;
               }
-              if (inner_freq_min > inner_cross[n_inner_tot].freq[0])
-                inner_freq_min = inner_cross[n_inner_tot].freq[0];
-              n_inner_tot++;
 
+              else if (ion[nion].phot_info == 1 && ion[nion].macro_info != 1)
+                /* We already have a topbase cross section, but the VFKY
+                   data is superior for the ground state, so we replace that data with the current data
+                   JM 1508 -- don't do this with macro-atoms for the moment */
+              {
+                phot_top[ion[nion].ntop_ground].nlev = ion[nion].firstlevel;  // ground state
+                phot_top[ion[nion].ntop_ground].nion = nion;
+                phot_top[ion[nion].ntop_ground].z = z;
+                phot_top[ion[nion].ntop_ground].istate = istate;
+                phot_top[ion[nion].ntop_ground].np = np;
+                phot_top[ion[nion].ntop_ground].macro_info = 0;
+                ion[nion].phot_info = 2;      //We mark this as having hybrid data - VFKY ground, TB excited, potentially VFKY innershell
+                xsection_pool_add (&phot_top[ion[nion].ntop_ground], np, xe, xx);
+                if (phot_freq_min > xsection_pool.freq[phot_top[ion[nion].ntop_ground].offset])
+                  phot_freq_min = xsection_pool.freq[phot_top[ion[nion].ntop_ground].offset];
+                Debug
+                  ("Get_atomic_data: file %s  Replacing ground state topbase photoionization for ion %d with VFKY photoionization\n",
+                   file, nion);
+              }
             }
           }
-          if (n_inner_tot > N_INNER * NIONS)
+
+          if (nxphot > NIONS)
           {
-            Error ("getatomic_data: file %s line %d: Inner edges than we have room for.\n", file, lineno);
+            Error ("getatomic_data: file %s line %d: More photoionization edges than IONS.\n", file, lineno);
             exit (0);
           }
+          if (nphot_total > NTOP_PHOT)
+          {
+            Error ("get_atomicdata: More photoionization cross sections that NTOP_PHOT (%d).  Increase in atomic.h\n", NTOP_PHOT);
+            exit (0);
+          }
+
           break;
+        }
+        else
+        {
+          Error ("get_atomic_data: file %s line %d: photoionization line incorrectly formatted\n", file, lineno);
+          Log ("Make sure you are using the tabulated verner cross sections (photo_vfky_tabulated.data)\n");
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+
+        /* Input inner shell cross section data */
+
+
+
+      case 'I':
+        if (sscanf (aline, "%*s %d %d %d %d %le %d\n", &z, &istate, &in, &il, &exx, &np) != 6)
+        {
+          Error ("Inner shell ionization data incorrectly formatted\n");
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        //The inner shell x-sections were read with this record
+        if (rec->np < np)
+        {
+          Error ("Get_atomic_data: Problem reading VY inner shell record\n");
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        xe = &dfile->xe[rec->index];
+        xx = &dfile->xx[rec->index];
+        lineno += rec->np;
+        for (nion = 0; nion < nions; nion++)
+        {
+          if (ion[nion].z == z && ion[nion].istate == istate && ion[nion].macro_info != 1)
+          {
+            /* Then there is a match */
+            if (n_inner_tot == atomic_max.ninner)
+            {
+              Error ("getatomic_data: file %s line %d: Inner edges than we have room for.\n", file, lineno);
+              exit (0);
+            }
+            inner_cross[n_inner_tot].nlev = ion[nion].firstlevel;     //All these are for the ground state
+            inner_cross[n_inner_tot].nion = nion;
+            inner_cross[n_inner_tot].np = np;
+            inner_cross[n_inner_tot].z = z;
+            inner_cross[n_inner_tot].istate = istate;
+            inner_cross[n_inner_tot].n = in;
+            inner_cross[n_inner_tot].l = il;
+            ion[nion].n_inner++;      /*Increment the number of inner shells */
+            ion[nion].nxinner[ion[nion].n_inner] = n_inner_tot;
+            xsection_pool_add (&inner_cross[n_inner_tot], np, xe, xx);
+            if (inner_freq_min > xsection_pool.freq[inner_cross[n_inner_tot].offset])
+              inner_freq_min = xsection_pool.freq[inner_cross[n_inner_tot].offset];
+            n_inner_tot++;
+
+          }
+        }
+        break;
 
 /**
  * @section Auger macro-atom data
  */
-        case 'a':
-          if (sscanf (aline, "%*s %d %d %d %d %le %d\n", &z, &istate, &levl, &levu, &Avalue_auger, &ne_records) != 6)
+      case 'a':
+        if (sscanf (aline, "%*s %d %d %d %d %le %d\n", &z, &istate, &levl, &levu, &Avalue_auger, &ne_records) != 6)
+        {
+          Error ("Auger macro-atom input incorrectly formatted\n");
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+
+        /* check we haven't asked for too many Auger electron pathways */
+        if (ne_records > NAUGER_ELECTRONS)
+        {
+          Error ("Too many Auger electron records specified (%d), should be < NAUGER_ELECTRONS (%d)\n", ne_records, NAUGER_ELECTRONS);
+          exit (0);
+        }
+
+        if (nauger_macro < atomic_max.nauger_macro)
+        {
+          //need to identify the configurations associated with the current and target levels 
+          n = 0;
+          while ((xconfig[n].z != z || xconfig[n].istate != istate || xconfig[n].ilv != levu) && n < nlevels)
+            n++;
+
+          /* check we've found a valid macro-atom level */
+          if (n == nlevels)
           {
-            Error ("Auger macro-atom input incorrectly formatted\n");
-            Error ("Get_atomic_data: %s\n", aline);
+            Error_silent ("Get_atomic_data: No configuration found to match Auger record %d\n", lineno);
             exit (0);
           }
+          if (xconfig[n].macro_info == -1)
+          {
+            Error ("Getatomic_data: Macro Atom Auger data supplied for config %d\n but there is no suitable level data\n", n);
+            exit (0);
+          }
+
+          /* copy information into the auger macro structure */
+          auger_macro[nauger_macro].z = z;
+          auger_macro[nauger_macro].istate = istate;
+          auger_macro[nauger_macro].nconfig = n;
+          auger_macro[nauger_macro].iauger = nauger_macro;
+          auger_macro[nauger_macro].nauger = 0;
+          auger_macro[nauger_macro].Avalue_auger = Avalue_auger;
+          xconfig[n].iauger = nauger_macro;
 
-          /* check we haven't asked for too many Auger electron pathways */
-          if (ne_records > NAUGER_ELECTRONS)
+          /* we now need to read the next line of Auger data which should be of form 
+             AugNels 26 24 -1 -1 -1 -1
+             the length depends on the variable ne_records
+           */
+          if (rec->nextra < 1)
           {
-            Error ("Too many Auger electron records specified (%d), should be < NAUGER_ELECTRONS (%d)\n", ne_records, NAUGER_ELECTRONS);
+            Error ("Get_atomic_data: Problem reading Auger macro-atom record\n");
+            Error ("Get_atomic_data: %s\n", aline);
             exit (0);
           }
+          aline = rec->extra[0];
+
+          /* at the moment we a maximum of 4 auger electrons ejected but this could 
+             be expanded by reading in more entries here */
+          nwords = sscanf (aline, "%*s %d %d %le %le %le %le",
+                           &z, &istate, &auger_branches[0], &auger_branches[1], &auger_branches[2], &auger_branches[3]);
 
-          if (nauger_macro < NAUGER_MACRO)
+          if (nwords != ne_records + 2)
           {
-            //need to identify the configurations associated with the current and target levels 
-            n = 0;
-            while ((xconfig[n].z != z || xconfig[n].istate != istate || xconfig[n].ilv != levu) && n < nlevels)
-              n++;
+            Error ("Auger macro-atom input incorrectly formatted\n");
+            Error ("Get_atomic_data: %s\n", aline);
+            exit (0);
+          }
 
-            /* check we've found a valid macro-atom level */
-            if (n == nlevels)
-            {
-              Error_silent ("Get_atomic_data: No configuration found to match Auger record %d\n", lineno);
-              exit (0);
-            }
-            if (xconfig[n].macro_info == -1)
+          /* cycle through each of the possible ion stages we can go to and populate the 
+             branching ratio arrays */
+          for (m = 0; m < ne_records; m++)
+          {
+            if (auger_branches[m] <= 0)
             {
-              Error ("Getatomic_data: Macro Atom Auger data supplied for config %d\n but there is no suitable level data\n", n);
-              exit (0);
+              auger_macro[nauger_macro].branching_ratio[m] = 0.0;
             }
 
-            /* copy information into the auger macro structure */
-            auger_macro[nauger_macro].z = z;
-            auger_macro[nauger_macro].istate = istate;
-            auger_macro[nauger_macro].nconfig = n;
-            auger_macro[nauger_macro].iauger = nauger_macro;
-            auger_macro[nauger_macro].nauger = 0;
-            auger_macro[nauger_macro].Avalue_auger = Avalue_auger;
-            xconfig[n].iauger = nauger_macro;
-
-            /* we now need to read the next line of Auger data which should be of form 
-               AugNels 26 24 -1 -1 -1 -1
-               the length depends on the variable ne_records
-             */
-            if (fgets (aline, LINELENGTH, fptr) == NULL)
+            else
             {
-              Error ("Get_atomic_data: Problem reading Auger macro-atom record\n");
-              Error ("Get_atomic_data: %s\n", aline);
-              exit (0);
-            }
+              auger_macro[nauger_macro].nauger++;
 
-            /* at the moment we a maximum of 4 auger electrons ejected but this could 
-               be expanded by reading in more entries here */
-            nwords = sscanf (aline, "%*s %d %d %le %le %le %le",
-                             &z, &istate, &auger_branches[0], &auger_branches[1], &auger_branches[2], &auger_branches[3]);
+              /* the data is supplied as a branching ratio so copy over */
+              auger_macro[nauger_macro].branching_ratio[m] = auger_branches[m];
 
-            if (nwords != ne_records + 2)
-            {
-              Error ("Auger macro-atom input incorrectly formatted\n");
-              Error ("Get_atomic_data: %s\n", aline);
-              exit (0);
-            }
+              /* for the moment, we are assuming Auger ionization occurs to the ground state of the 
+                 target ion */
+              target_istate = istate + 1 + m;
 
-            /* cycle through each of the possible ion stages we can go to and populate the 
-               branching ratio arrays */
-            for (m = 0; m < ne_records; m++)
-            {
-              if (auger_branches[m] <= 0)
+              n = 0;
+              while ((xconfig[n].z != z || xconfig[n].istate != target_istate || xconfig[n].ilv != 1) && n < nlevels)
+                n++;
+              if (n == nlevels)
               {
-                auger_macro[nauger_macro].branching_ratio[m] = 0.0;
+                Error ("Get_atomic_data: No target ion configuration found to match Auger macro record %d\n", lineno);
+                exit (0);
               }
 
-              else
-              {
-                auger_macro[nauger_macro].nauger++;
-
-                /* the data is supplied as a branching ratio so copy over */
-                auger_macro[nauger_macro].branching_ratio[m] = auger_branches[m];
-
-                /* for the moment, we are assuming Auger ionization occurs to the ground state of the 
-                   target ion */
-                target_istate = istate + 1 + m;
-
-                n = 0;
-                while ((xconfig[n].z != z || xconfig[n].istate != target_istate || xconfig[n].ilv != 1) && n < nlevels)
-                  n++;
-                if (n == nlevels)
-                {
-                  Error ("Get_atomic_data: No target ion configuration found to match Auger macro record %d\n", lineno);
-                  exit (0);
-                }
-
-                auger_macro[nauger_macro].nconfig_target[m] = n;
-              }
+              auger_macro[nauger_macro].nconfig_target[m] = n;
             }
-
-            /* also record the number of possible auger jumps in the config structure */
-            xconfig[n].nauger = auger_macro[nauger_macro].nauger;
-            nauger_macro++;
-          }
-          else
-          {
-            Error ("getatomic_data: file %s line %d: More Auger macro-atom records than allowed. Increase NAUGER_MACRO in atomic.h\n", file,
-                   lineno);
-            exit (0);
           }
 
-          break;
+          /* also record the number of possible auger jumps in the config structure */
+          xconfig[n].nauger = auger_macro[nauger_macro].nauger;
+          nauger_macro++;
+        }
+        else
+        {
+          Error ("getatomic_data: file %s line %d: More Auger macro-atom records than were counted\n", file,
+                 lineno);
+          exit (0);
+        }
+
+        break;
 
 
 
-          /*Input data for innershell ionization followed by
-             Auger effect */
+        /*Input data for innershell ionization followed by
+           Auger effect */
 /**
  * @section Auger
  */
@@ -1641,210 +1603,231 @@ described as macro-levels. */
  *   Basically this was accomplished by checking both the upper and lower level and breaking
  *   out if either was not accounted for.
 */
-        case 'r':
-          if (strncmp (word, "LinMacro", 8) == 0)
-          {                     //It's a macro atoms line(SS)
-            if (mflag != 1)
-            {
-              Error ("get_atomicdata: Can't read macro-line after some simple lines. Reorder the input files!\n");
-              exit (0);
-            }
+      case 'r':
+        /* Lines were normally parsed when the file was read; a continuation record is parsed here */
+        if (rec->type == 'r')
+        {
+          lrec = &dfile->lines[rec->index];
+        }
+        else
+        {
+          parse_line_record (aline, word, &lrec_local);
+          lrec = &lrec_local;
+        }
 
-            mflag = 1;          //flag to identify macro atom case (SS)
-            nwords = sscanf (aline, "%*s %d %d %le %le %le %le %le %le %d %d", &z, &istate, &freq, &f, &gl, &gu, &el, &eu, &levl, &levu);
-            if (nwords != 10)
-            {
-              Error ("get_atomic_data: file %s line %d: LinMacro line incorrectly formatted\n", file, lineno);
-              Error ("Get_atomic_data: %s\n", aline);
-              exit (0);
-            }
+        if (strncmp (word, "LinMacro", 8) == 0)
+        {                     //It's a macro atoms line(SS)
+          if (mflag != 1)
+          {
+            Error ("get_atomicdata: Can't read macro-line after some simple lines. Reorder the input files!\n");
+            exit (0);
+          }
 
-            el = EV2ERGS * el;
-            eu = EV2ERGS * eu;
-            //need to identify the configurations associated with the upper and lower levels (SS)
-            n = 0;
-            while ((xconfig[n].z != z || xconfig[n].istate != istate || xconfig[n].ilv != levl) && n < nlevels)
-              n++;
-            if (n == nlevels)
-            {
-              Error_silent ("Get_atomic_data: LinMacro No configuration found to match lower level of line %d\n", lineno);
-              break;
-            }
+          mflag = 1;          //flag to identify macro atom case (SS)
+          nwords = lrec->nwords;
+          z = lrec->z;
+          istate = lrec->istate;
+          freq = lrec->wave;
+          f = lrec->f;
+          gl = lrec->gl;
+          gu = lrec->gu;
+          el = lrec->el;
+          eu = lrec->eu;
+          levl = lrec->levl;
+          levu = lrec->levu;
+          if (nwords != 10)
+          {
+            Error ("get_atomic_data: file %s line %d: LinMacro line incorrectly formatted\n", file, lineno);
+            Error ("Get_atomic_data: %s\n", aline);
+            exit (0);
+          }
 
+          el = EV2ERGS * el;
+          eu = EV2ERGS * eu;
+          //need to identify the configurations associated with the upper and lower levels (SS)
+          n = 0;
+          while ((xconfig[n].z != z || xconfig[n].istate != istate || xconfig[n].ilv != levl) && n < nlevels)
+            n++;
+          if (n == nlevels)
+          {
+            Error_silent ("Get_atomic_data: LinMacro No configuration found to match lower level of line %d\n", lineno);
+            break;
+          }
 
-            m = 0;
-            while ((xconfig[m].z != z || xconfig[m].istate != istate || xconfig[m].ilv != levu) && m < nlevels)
-              m++;
-            if (m == nlevels)
-            {
-              Error_silent ("Get_atomic_data: LinMacro No configuration found to match upper level of line %d\n", lineno);
-              break;
-            }
 
-            /* Now that we know this is a valid transition for the macro atom record the data */
+          m = 0;
+          while ((xconfig[m].z != z || xconfig[m].istate != istate || xconfig[m].ilv != levu) && m < nlevels)
+            m++;
+          if (m == nlevels)
+          {
+            Error_silent ("Get_atomic_data: LinMacro No configuration found to match upper level of line %d\n", lineno);
+            break;
+          }
 
-            nconfigl = n;       //record lower configuration (SS)
-            xconfig[n].bbu_jump[xconfig[n].n_bbu_jump] = nlines;        //record the line index as an upward bb Macro Atom jump(SS)
-            line[nlines].down_index = xconfig[n].n_bbu_jump;    //record the index for the jump in the line structure
-            xconfig[n].n_bbu_jump += 1; //note that there is one more upwards jump available (SS)
-            if (xconfig[n].n_bbu_jump > NBBJUMPS)
-            {
-              Error ("get_atomic_data: Too many upward b-b jumps for ion %d\n", xconfig[n].istate);
-              exit (0);
-            }
+          /* Now that we know this is a valid transition for the macro atom record the data */
 
-            nconfigu = m;       //record upper configuration (SS)
-            xconfig[m].bbd_jump[xconfig[m].n_bbd_jump] = nlines;        //record the line index as a downward bb Macro Atom jump (SS)
-            line[nlines].up_index = xconfig[m].n_bbd_jump;      //record jump index in line structure
-            xconfig[m].n_bbd_jump += 1; //note that there is one more downwards jump available (SS)
-            if (xconfig[m].n_bbd_jump > NBBJUMPS)
-            {
-              Error ("get_atomic_data: Too many downward b-b jumps for ion %d\n", xconfig[m].istate);
-              exit (0);
-            }
+          nconfigl = n;       //record lower configuration (SS)
+          jump_list_add (&bbu_jumps, n, nlines);      //record the line index as an upward bb Macro Atom jump(SS)
+          line[nlines].down_index = xconfig[n].n_bbu_jump;    //record the index for the jump in the line structure
+          xconfig[n].n_bbu_jump += 1; //note that there is one more upwards jump available (SS)
 
+          nconfigu = m;       //record upper configuration (SS)
+          jump_list_add (&bbd_jumps, m, nlines);      //record the line index as a downward bb Macro Atom jump (SS)
+          line[nlines].up_index = xconfig[m].n_bbd_jump;      //record jump index in line structure
+          xconfig[m].n_bbd_jump += 1; //note that there is one more downwards jump available (SS)
 
-          }
-          else
-          {                     //It's not a macro atom line (SS)
+
+        }
+        else
+        {                     //It's not a macro atom line (SS)
 // It would have been better to define mflag = 0 since that is what we want to set
 // macro_info to if it is an old-style line, but keep it this way for now.  ksl
-            mflag = -1;         //a flag to mark this as not a macro atom case (SS)
-            nconfigl = -1;
-            nconfigu = -1;
-            nwords = sscanf (aline, "%*s %d %2d %le %le %le %le %le %le %d %d", &z, &istate, &freq, &f, &gl, &gu, &el, &eu, &levl, &levu);
-            if (nwords == 6)
-            {
-              el = 0.0;
-              eu = PLANCK * VLIGHT / (freq * 1e-8);     // Convert Angstroms to ergs
-              levl = -1;
-              levu = -1;
+          mflag = -1;         //a flag to mark this as not a macro atom case (SS)
+          nconfigl = -1;
+          nconfigu = -1;
+          nwords = lrec->nwords;
+          z = lrec->z;
+          istate = lrec->istate;
+          freq = lrec->wave;
+          f = lrec->f;
+          gl = lrec->gl;
+          gu = lrec->gu;
+          el = lrec->el;
+          eu = lrec->eu;
+          levl = lrec->levl;
+          levu = lrec->levu;
+          if (nwords == 6)
+          {
+            el = 0.0;
+            eu = PLANCK * VLIGHT / (freq * 1e-8);     // Convert Angstroms to ergs
+            levl = -1;
+            levu = -1;
+
+          }
+          else if (nwords == 8)
+          {                   // Then the file contains the energy levels of the transitions
 
-            }
-            else if (nwords == 8)
-            {                   // Then the file contains the energy levels of the transitions
+            el = EV2ERGS * el;
+            eu = EV2ERGS * eu;
+            levl = -1;
+            levu = -1;
+          }
+          else if (nwords == 10)
+          {                   // Then the file contains energy levels and level numbers
+            el = EV2ERGS * el;
+            eu = EV2ERGS * eu;
+          }
 
-              el = EV2ERGS * el;
-              eu = EV2ERGS * eu;
-              levl = -1;
-              levu = -1;
-            }
-            else if (nwords == 10)
-            {                   // Then the file contains energy levels and level numbers
-              el = EV2ERGS * el;
-              eu = EV2ERGS * eu;
-            }
+          else
+          {
+            Error ("get_atomic_data: file %s line %d: Resonance line incorrectly formatted\n", file, lineno);
+            Error ("Get_atomic_data: %s\n", aline);
+            exit (0);
+          }
+        }
 
-            else
+        if (el > eu)
+          Error ("get_atomic_data: file %s line %d : line has el (%f) > eu (%f)\n", file, lineno, el, eu);
+        for (n = 0; n < nions; n++)
+        {
+          if (ion[n].z == z && ion[n].istate == istate)
+          {                   /* Then there is a match */
+            if (gl == 0 || gu == 0 || freq == 0)
             {
-              Error ("get_atomic_data: file %s line %d: Resonance line incorrectly formatted\n", file, lineno);
-              Error ("Get_atomic_data: %s\n", aline);
-              exit (0);
+              Error_silent ("getatomic_data: line input freq, gl or gu = 0: %s\n", aline);
+              break;
             }
-          }
-
-          if (el > eu)
-            Error ("get_atomic_data: file %s line %d : line has el (%f) > eu (%f)\n", file, lineno, el, eu);
-          for (n = 0; n < nions; n++)
-          {
-            if (ion[n].z == z && ion[n].istate == istate)
-            {                   /* Then there is a match */
-              if (gl == 0 || gu == 0 || freq == 0)
+            if (f <= 0)
+            {
+              Error_silent ("getatomic_data: line input f odd (may be OK if Macro): %s\n", aline);
+              if (mflag == -1)
               {
-                Error_silent ("getatomic_data: line input freq, gl or gu = 0: %s\n", aline);
                 break;
               }
-              if (f <= 0)
-              {
-                Error_silent ("getatomic_data: line input f odd (may be OK if Macro): %s\n", aline);
-                if (mflag == -1)
-                {
-                  break;
-                }
-              }
-              //
-              //define macro atom case (SS)
+            }
+            //
+            //define macro atom case (SS)
 /* XXXX  04 April ksl -- Right now have enforced a clean separation between macro-ions and simple-ions
 but this is proably not what we want if we move all bf & fb transitions to macro-ion approach.  We
 would like to have simple lines for macro-ions */
-              if (ion[n].macro_info == 1 && mflag == -1)
-              {
-                /* count how many times this happens to report to user */
-                simple_line_ignore[n] += 1;
-                break;
-              }
-              if (ion[n].macro_info == -1 && mflag == 1)
-              {
-                Error ("Getatomic_data: Macro Atom line data supplied for ion %d\n but there is no suitable level data\n", n);
-                exit (0);
-              }
-              line[nlines].nion = n;
-              line[nlines].z = z;
-              line[nlines].istate = istate;
-              line[nlines].freq = VLIGHT / (freq * 1e-8);       /* convert Angstroms to frequency */
-              line[nlines].f = f;
-              line[nlines].gl = gl;
-              line[nlines].gu = gu;
-              line[nlines].levl = levl;
-              line[nlines].levu = levu;
-              line[nlines].el = el;
-              line[nlines].eu = eu;
-              line[nlines].nconfigl = nconfigl;
-              line[nlines].nconfigu = nconfigu;
-              line[nlines].coll_index = -999;   // We start assuming there is no collisional strength data
-              if (mflag == -1)
-              {
-                line[nlines].macro_info = 0;    // It's an old-style line`
-                nlines_simple++;
-              }
-              else
-              {
-                line[nlines].macro_info = 1;    //It's a macro line
-                nlines_macro++;
-              }
-              nlines++;
+            if (ion[n].macro_info == 1 && mflag == -1)
+            {
+              /* count how many times this happens to report to user */
+              simple_line_ignore[n] += 1;
+              break;
             }
+            if (ion[n].macro_info == -1 && mflag == 1)
+            {
+              Error ("Getatomic_data: Macro Atom line data supplied for ion %d\n but there is no suitable level data\n", n);
+              exit (0);
+            }
+            line[nlines].nion = n;
+            line[nlines].z = z;
+            line[nlines].istate = istate;
+            line[nlines].freq = VLIGHT / (freq * 1e-8);       /* convert Angstroms to frequency */
+            line[nlines].f = f;
+            line[nlines].gl = gl;
+            line[nlines].gu = gu;
+            line[nlines].levl = levl;
+            line[nlines].levu = levu;
+            line[nlines].el = el;
+            line[nlines].eu = eu;
+            line[nlines].nconfigl = nconfigl;
+            line[nlines].nconfigu = nconfigu;
+            line[nlines].coll_index = -999;   // We start assuming there is no collisional strength data
+            if (mflag == -1)
+            {
+              line[nlines].macro_info = 0;    // It's an old-style line`
+              nlines_simple++;
+            }
+            else
+            {
+              line[nlines].macro_info = 1;    //It's a macro line
+              nlines_macro++;
+            }
+            nlines++;
           }
-          if (nlines > NLINES)
-          {
-            Error ("getatomic_data: file %s line %d: More lines than allowed. Increase NLINES in atomic.h\n", file, lineno);
-            exit (0);
-          }
-          break;
+        }
+        if (nlines > atomic_max.nlines)
+        {
+          Error ("getatomic_data: file %s line %d: More lines than were counted\n", file, lineno);
+          exit (0);
+        }
+        break;
 
 /** @section Ground state fractions
  */
-        case 'f':
-          if (sscanf
-              (aline,
-               "%*s %d %d %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le",
-               &z, &istate, &the_ground_frac[0], &the_ground_frac[1],
-               &the_ground_frac[2], &the_ground_frac[3],
-               &the_ground_frac[4], &the_ground_frac[5],
-               &the_ground_frac[6], &the_ground_frac[7],
-               &the_ground_frac[8], &the_ground_frac[9],
-               &the_ground_frac[10], &the_ground_frac[11],
-               &the_ground_frac[12], &the_ground_frac[13],
-               &the_ground_frac[14], &the_ground_frac[15],
-               &the_ground_frac[16], &the_ground_frac[17], &the_ground_frac[18], &the_ground_frac[19]) != 22)
-          {
-            Error ("get_atomic_data: file %s line %d ground state fracs   frac table incorrectly formatted\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
-          for (n = 0; n < nions; n++)
-          {
-            if (ion[n].z == z && ion[n].istate == istate)
-            {                   /* Then there is a match */
-              ground_frac[n].z = z;
-              ground_frac[n].istate = istate;
-              for (j = 0; j < 20; j++)
-              {
-                ground_frac[n].frac[j] = the_ground_frac[j];
-              }
+      case 'f':
+        if (sscanf
+            (aline,
+             "%*s %d %d %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le",
+             &z, &istate, &the_ground_frac[0], &the_ground_frac[1],
+             &the_ground_frac[2], &the_ground_frac[3],
+             &the_ground_frac[4], &the_ground_frac[5],
+             &the_ground_frac[6], &the_ground_frac[7],
+             &the_ground_frac[8], &the_ground_frac[9],
+             &the_ground_frac[10], &the_ground_frac[11],
+             &the_ground_frac[12], &the_ground_frac[13],
+             &the_ground_frac[14], &the_ground_frac[15],
+             &the_ground_frac[16], &the_ground_frac[17], &the_ground_frac[18], &the_ground_frac[19]) != 22)
+        {
+          Error ("get_atomic_data: file %s line %d ground state fracs   frac table incorrectly formatted\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        for (n = 0; n < nions; n++)
+        {
+          if (ion[n].z == z && ion[n].istate == istate)
+          {                   /* Then there is a match */
+            ground_frac[n].z = z;
+            ground_frac[n].istate = istate;
+            for (j = 0; j < 20; j++)
+            {
+              ground_frac[n].frac[j] = the_ground_frac[j];
             }
           }
-          break;
+        }
+        break;
 
 
 
@@ -1867,57 +1850,57 @@ would like to have simple lines for macro-ions */
  *
  */
 
-        case 'D':              /* Dielectronic recombination data read in. */
-          nparam = sscanf (aline, "%*s %s %d %d %le %le %le %le %le %le %le %le %le", &drflag, &z, &ne, &drp[0], &drp[1], &drp[2], &drp[3], &drp[4], &drp[5], &drp[6], &drp[7], &drp[8]);       //split and assign the line
-          nparam -= 3;          //take 4 off the nparam to give the number of actual parameters
-          if (nparam > 9 || nparam < 1) //     trap errors - not as robust as usual because there are a varaible number of parameters...
-          {
-            Error ("Something wrong with dielectronic recombination data\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
+      case 'D':              /* Dielectronic recombination data read in. */
+        nparam = sscanf (aline, "%*s %s %d %d %le %le %le %le %le %le %le %le %le", &drflag, &z, &ne, &drp[0], &drp[1], &drp[2], &drp[3], &drp[4], &drp[5], &drp[6], &drp[7], &drp[8]);       //split and assign the line
+        nparam -= 3;          //take 4 off the nparam to give the number of actual parameters
+        if (nparam > 9 || nparam < 1) //     trap errors - not as robust as usual because there are a varaible number of parameters...
+        {
+          Error ("Something wrong with dielectronic recombination data\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
 
-          istate = ne;          //         get the ionisation state we are recombining from
+        istate = ne;          //         get the ionisation state we are recombining from
 
-          for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        {
+          if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
           {
-            if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
+            if (ion[n].drflag == 0)   //This is the first time we have dealt with this ion
             {
-              if (ion[n].drflag == 0)   //This is the first time we have dealt with this ion
-              {
-                drecomb[ndrecomb].nion = n;     //put the ion number into the DR structure
-                drecomb[ndrecomb].nparam = nparam;      //Put the number of parameters we ware going to read in, into the DR structure so we know what to iterate over later
-                ion[n].nxdrecomb = ndrecomb;    //put the number of the DR into the ion
-                drecomb[ndrecomb].type = DRTYPE_BADNELL;        //define the type of data
-                ndrecomb++;     //increment the counter of number of dielectronic recombination parameter sets
-                ion[n].drflag++;        //increment the flag by 1. We will do this rather than simply setting it to 1 so we will get errors if we do this more than once....
+              drecomb[ndrecomb].nion = n;     //put the ion number into the DR structure
+              drecomb[ndrecomb].nparam = nparam;      //Put the number of parameters we ware going to read in, into the DR structure so we know what to iterate over later
+              ion[n].nxdrecomb = ndrecomb;    //put the number of the DR into the ion
+              drecomb[ndrecomb].type = DRTYPE_BADNELL;        //define the type of data
+              ndrecomb++;     //increment the counter of number of dielectronic recombination parameter sets
+              ion[n].drflag++;        //increment the flag by 1. We will do this rather than simply setting it to 1 so we will get errors if we do this more than once....
 
-              }
-              if (drflag == 'E')        // this ion has no parameters, so it must be the first time through
-              {
+            }
+            if (drflag == 'E')        // this ion has no parameters, so it must be the first time through
+            {
 
-                n1 = ion[n].nxdrecomb;  //     Get the pointer to the correct bit of the recombination coefficient array. This should already be set from the first time through
-                for (n2 = 0; n2 < nparam; n2++)
-                {
-                  drecomb[n1].e[n2] = drp[n2];  //we are getting e parameters
-                }
+              n1 = ion[n].nxdrecomb;  //     Get the pointer to the correct bit of the recombination coefficient array. This should already be set from the first time through
+              for (n2 = 0; n2 < nparam; n2++)
+              {
+                drecomb[n1].e[n2] = drp[n2];  //we are getting e parameters
+              }
 
 
-              }
-              else if (drflag == 'C')   //                  must be the second time though, so no need to read in all the other things
+            }
+            else if (drflag == 'C')   //                  must be the second time though, so no need to read in all the other things
+            {
+              n1 = ion[n].nxdrecomb;  //     Get the pointer to the correct bit of the recombination coefficient array. This should already be set from the first time through
+              for (n2 = 0; n2 < nparam; n2++)
               {
-                n1 = ion[n].nxdrecomb;  //     Get the pointer to the correct bit of the recombination coefficient array. This should already be set from the first time through
-                for (n2 = 0; n2 < nparam; n2++)
-                {
-                  drecomb[n1].c[n2] = drp[n2];  //           we are getting e parameters
-                }
+                drecomb[n1].c[n2] = drp[n2];  //           we are getting e parameters
               }
+            }
 
-            }                   //close if statement that selects appropriate ion to add data to
-          }                     //close loop over ions
+          }                   //close if statement that selects appropriate ion to add data to
+        }                     //close loop over ions
 
 
-          break;
+        break;
 
 /** @section Dielectronic Recombination - type 2
  * This section reads in type 2 dielectronic recombination rates.
@@ -1937,40 +1920,40 @@ would like to have simple lines for macro-ions */
 
 
 
-        case 'S':
-          nparam = sscanf (aline, "%*s %d %d %le %le %le %le ", &z, &ne, &drp[0], &drp[1], &drp[2], &drp[3]);   //split and assign the line
-          nparam -= 2;          //take 4 off the nparam to give the number of actual parameters
-          if (nparam > 4 || nparam < 1) //     trap errors - not as robust as usual because there are a varaible number of parameters...
-          {
-            Error ("Something wrong with dielectronic recombination data\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
+      case 'S':
+        nparam = sscanf (aline, "%*s %d %d %le %le %le %le ", &z, &ne, &drp[0], &drp[1], &drp[2], &drp[3]);   //split and assign the line
+        nparam -= 2;          //take 4 off the nparam to give the number of actual parameters
+        if (nparam > 4 || nparam < 1) //     trap errors - not as robust as usual because there are a varaible number of parameters...
+        {
+          Error ("Something wrong with dielectronic recombination data\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
 
-          istate = ne;          //         get the ionisation state we are recombining from
+        istate = ne;          //         get the ionisation state we are recombining from
 
-          for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        {
+          if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
           {
-            if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
+            if (ion[n].drflag == 0)   //This is the first time we have dealt with this ion
             {
-              if (ion[n].drflag == 0)   //This is the first time we have dealt with this ion
-              {
-                drecomb[ndrecomb].nion = n;     //put the ion number into the DR structure
-                drecomb[ndrecomb].nparam = nparam;      //Put the number of parameters we ware going to read in, into the DR structure so we know what to iterate over later
-                ion[n].nxdrecomb = ndrecomb;    //put the number of the DR into the ion
-                drecomb[ndrecomb].type = DRTYPE_SHULL;  //define the type of data
-                ndrecomb++;     //increment the counter of number of dielectronic recombination parameter sets
-                ion[n].drflag++;        //increment the flag by 1. We will do this rather than simply setting it to 1 so we will get errors if we do this more than once....
+              drecomb[ndrecomb].nion = n;     //put the ion number into the DR structure
+              drecomb[ndrecomb].nparam = nparam;      //Put the number of parameters we ware going to read in, into the DR structure so we know what to iterate over later
+              ion[n].nxdrecomb = ndrecomb;    //put the number of the DR into the ion
+              drecomb[ndrecomb].type = DRTYPE_SHULL;  //define the type of data
+              ndrecomb++;     //increment the counter of number of dielectronic recombination parameter sets
+              ion[n].drflag++;        //increment the flag by 1. We will do this rather than simply setting it to 1 so we will get errors if we do this more than once....
 
-              }
-              n1 = ion[n].nxdrecomb;    //     Get the pointer to the correct bit of the recombination coefficient array. This should already be set from the first time through
-              for (n2 = 0; n2 < nparam; n2++)
-              {
-                drecomb[n1].shull[n2] = drp[n2];        //we are getting e parameters
-              }
+            }
+            n1 = ion[n].nxdrecomb;    //     Get the pointer to the correct bit of the recombination coefficient array. This should already be set from the first time through
+            for (n2 = 0; n2 < nparam; n2++)
+            {
+              drecomb[n1].shull[n2] = drp[n2];        //we are getting e parameters
             }
           }
-          break;
+        }
+        break;
 
 /**
  * @section total radiative Recombination rates from Chianti - type 1 and 2
@@ -1993,52 +1976,52 @@ would like to have simple lines for macro-ions */
  * @endverbatim
  * */
 
-        case 'T':              /*Badnell type total raditive rate coefficients read in */
+      case 'T':              /*Badnell type total raditive rate coefficients read in */
 
-          nparam = sscanf (aline, "%*s %d %d %d %le %le %le %le %le %le", &z, &ne, &w, &btrr[0], &btrr[1], &btrr[2], &btrr[3], &btrr[4], &btrr[5]);     //split and assign the line
-          nparam -= 3;          //take 4 off the nparam to give the number of actual parameters
-          if (nparam > 6 || nparam < 1) //     trap errors - not as robust as usual because there are a varaible number of parameters...
-          {
-            Error ("Something wrong with badnell total RR data\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
+        nparam = sscanf (aline, "%*s %d %d %d %d %le %le %le %le %le %le", &z, &ne, &w, &w, &btrr[0], &btrr[1], &btrr[2], &btrr[3], &btrr[4], &btrr[5]);        //split and assign the line
+        nparam -= 4;          //take 4 off the nparam to give the number of actual parameters
+        if (nparam > 6 || nparam < 1) //     trap errors - not as robust as usual because there are a varaible number of parameters...
+        {
+          Error ("Something wrong with badnell total RR data\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
 
-          istate = ne;          //         get the traditional ionisation state
-          for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        istate = ne;          //         get the traditional ionisation state
+        for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        {
+          if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
           {
-            if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
+            if (ion[n].total_rrflag == 0)     // this ion has no parameters, so it must be the first time through
             {
-              if (ion[n].total_rrflag == 0)     // this ion has no parameters, so it must be the first time through
-              {
-                total_rr[n_total_rr].nion = n;  //put the ion number into the bad_t_rr structure
-                ion[n].nxtotalrr = n_total_rr;  /*put the number of the bad_t_rr into the ion
-                                                   structure so we can go either way. */
-                total_rr[n_total_rr].type = RRTYPE_BADNELL;
-                for (n1 = 0; n1 < nparam; n1++)
-                {
-                  total_rr[n_total_rr].params[n1] = btrr[n1];   //we are getting  parameters
-                }
-                ion[n].total_rrflag++;  //increment the flag by 1. We will do this rather than simply setting it to 1 so we will get errors if we do this more than once....
-                n_total_rr++;   //increment the counter of number of dielectronic recombination parameter sets
-              }
-              else if (ion[n].total_rrflag > 0) //       unexpected second line matching z and charge
+              total_rr[n_total_rr].nion = n;  //put the ion number into the bad_t_rr structure
+              ion[n].nxtotalrr = n_total_rr;  /*put the number of the bad_t_rr into the ion
+                                                 structure so we can go either way. */
+              total_rr[n_total_rr].type = RRTYPE_BADNELL;
+              for (n1 = 0; n1 < nparam; n1++)
               {
-                Error ("More than one badnell total RR rate for ion %i\n", n);
-                Error ("Get_atomic_data: %s\n", aline);
-                exit (0);
-              }
-              else              //if flag is not a positive number, we have a problem
-              {
-                Error ("Total radiative recombination flag giving odd results\n");
-                exit (0);
+                total_rr[n_total_rr].params[n1] = btrr[n1];   //we are getting  parameters
               }
-            }                   //close if statement that selects appropriate ion to add data to
-          }                     //close loop over ions
+              ion[n].total_rrflag++;  //increment the flag by 1. We will do this rather than simply setting it to 1 so we will get errors if we do this more than once....
+              n_total_rr++;   //increment the counter of number of dielectronic recombination parameter sets
+            }
+            else if (ion[n].total_rrflag > 0) //       unexpected second line matching z and charge
+            {
+              Error ("More than one badnell total RR rate for ion %i\n", n);
+              Error ("Get_atomic_data: %s\n", aline);
+              exit (0);
+            }
+            else              //if flag is not a positive number, we have a problem
+            {
+              Error ("Total radiative recombination flag giving odd results\n");
+              exit (0);
+            }
+          }                   //close if statement that selects appropriate ion to add data to
+        }                     //close loop over ions
 
 
 
-          break;
+        break;
 
 /**
  * @section Total radiative recombination - type 3
@@ -2057,48 +2040,48 @@ would like to have simple lines for macro-ions */
 
 
 
-        case 's':
-          nparam = sscanf (aline, "%*s %d %d %le %le ", &z, &ne, &btrr[0], &btrr[1]);   //split and assign the line
-          nparam -= 2;          //take 4 off the nparam to give the number of actual parameters
-          if (nparam > 6 || nparam < 1) //     trap errors - not as robust as usual because there are a varaible number of parameters...
-          {
-            Error ("Something wrong with shull total RR data\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
+      case 's':
+        nparam = sscanf (aline, "%*s %d %d %le %le ", &z, &ne, &btrr[0], &btrr[1]);   //split and assign the line
+        nparam -= 2;          //take 4 off the nparam to give the number of actual parameters
+        if (nparam > 6 || nparam < 1) //     trap errors - not as robust as usual because there are a varaible number of parameters...
+        {
+          Error ("Something wrong with shull total RR data\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
 
-          istate = ne;          //         get the traditional ionisation state
-          for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        istate = ne;          //         get the traditional ionisation state
+        for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        {
+          if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
           {
-            if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
+            if (ion[n].total_rrflag == 0)     // this ion has no parameters, so it must be the first time through
             {
-              if (ion[n].total_rrflag == 0)     // this ion has no parameters, so it must be the first time through
-              {
-                total_rr[n_total_rr].nion = n;  //put the ion number into the bad_t_rr structure
-                ion[n].nxtotalrr = n_total_rr;  /*put the number of the bad_t_rr into the ion
-                                                   structure so we can go either way. */
-                total_rr[n_total_rr].type = RRTYPE_SHULL;
-                for (n1 = 0; n1 < nparam; n1++)
-                {
-                  total_rr[n_total_rr].params[n1] = btrr[n1];   //we are getting  parameters
-                }
-                ion[n].total_rrflag++;  //increment the flag by 1. We will do this rather than simply setting it to 1 so we will get errors if we do this more than once....
-                n_total_rr++;   //increment the counter of number of dielectronic recombination parameter sets
-              }
-              else if (ion[n].total_rrflag > 0) //       unexpected second line matching z and charge
-              {
-                Error ("More than one total RR rate for ion %i\n", n);
-                Error ("Get_atomic_data: %s\n", aline);
-                exit (0);
-              }
-              else              //if flag is not a positive number, we have a problem
+              total_rr[n_total_rr].nion = n;  //put the ion number into the bad_t_rr structure
+              ion[n].nxtotalrr = n_total_rr;  /*put the number of the bad_t_rr into the ion
+                                                 structure so we can go either way. */
+              total_rr[n_total_rr].type = RRTYPE_SHULL;
+              for (n1 = 0; n1 < nparam; n1++)
               {
-                Error ("Total radiative recombination flag giving odd results\n");
-                exit (0);
+                total_rr[n_total_rr].params[n1] = btrr[n1];   //we are getting  parameters
               }
-            }                   //close if statement that selects appropriate ion to add data to
-          }                     //close loop over ions
-          break;
+              ion[n].total_rrflag++;  //increment the flag by 1. We will do this rather than simply setting it to 1 so we will get errors if we do this more than once....
+              n_total_rr++;   //increment the counter of number of dielectronic recombination parameter sets
+            }
+            else if (ion[n].total_rrflag > 0) //       unexpected second line matching z and charge
+            {
+              Error ("More than one total RR rate for ion %i\n", n);
+              Error ("Get_atomic_data: %s\n", aline);
+              exit (0);
+            }
+            else              //if flag is not a positive number, we have a problem
+            {
+              Error ("Total radiative recombination flag giving odd results\n");
+              exit (0);
+            }
+          }                   //close if statement that selects appropriate ion to add data to
+        }                     //close loop over ions
+        break;
 
 
 /**
@@ -2119,84 +2102,84 @@ would like to have simple lines for macro-ions */
 
  */
 
-        case 'G':
-          nparam = sscanf (aline, "%*s %s %d %d %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le", &gsflag, &z, &ne, &gstemp[0], &gstemp[1], &gstemp[2], &gstemp[3], &gstemp[4], &gstemp[5], &gstemp[6], &gstemp[7], &gstemp[8], &gstemp[9], &gstemp[10], &gstemp[11], &gstemp[12], &gstemp[13], &gstemp[14], &gstemp[15], &gstemp[16], &gstemp[17], &gstemp[18]);   //split and assign the line
-          nparam -= 3;          //take 4 off the nparam to give the number of actual parameters
-          if (nparam > 19 || nparam < 1)        //     trap errors - not as robust as usual because there are a varaible number of parameters...
-          {
-            Error ("Something wrong with badnell GS RR data\n");
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
-          istate = z - ne + 1;  //         get the traditional ionisation state
-          for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+      case 'G':
+        nparam = sscanf (aline, "%*s %s %d %d %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le", &gsflag, &z, &ne, &gstemp[0], &gstemp[1], &gstemp[2], &gstemp[3], &gstemp[4], &gstemp[5], &gstemp[6], &gstemp[7], &gstemp[8], &gstemp[9], &gstemp[10], &gstemp[11], &gstemp[12], &gstemp[13], &gstemp[14], &gstemp[15], &gstemp[16], &gstemp[17], &gstemp[18]);   //split and assign the line
+        nparam -= 3;          //take 4 off the nparam to give the number of actual parameters
+        if (nparam > 19 || nparam < 1)        //     trap errors - not as robust as usual because there are a varaible number of parameters...
+        {
+          Error ("Something wrong with badnell GS RR data\n");
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        istate = z - ne + 1;  //         get the traditional ionisation state
+        for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        {
+          if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
           {
-            if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
+            if (ion[n].bad_gs_rr_t_flag == 0 && ion[n].bad_gs_rr_r_flag == 0) //This is first set of this type of data for this ion
             {
-              if (ion[n].bad_gs_rr_t_flag == 0 && ion[n].bad_gs_rr_r_flag == 0) //This is first set of this type of data for this ion
-              {
-                bad_gs_rr[n_bad_gs_rr].nion = n;        //put the ion number into the bad_t_rr structure
-                ion[n].nxbadgsrr = n_bad_gs_rr; //put the number of the bad_t_rr into the ion structure so we can go either way.
-                n_bad_gs_rr++;  //increment the counter of number of ground state RR
-              }
-              /*Now work out what type of line it is, and where it needs to go */
-              if (gsflag == 'T')        //it is a temperature line
+              bad_gs_rr[n_bad_gs_rr].nion = n;        //put the ion number into the bad_t_rr structure
+              ion[n].nxbadgsrr = n_bad_gs_rr; //put the number of the bad_t_rr into the ion structure so we can go either way.
+              n_bad_gs_rr++;  //increment the counter of number of ground state RR
+            }
+            /*Now work out what type of line it is, and where it needs to go */
+            if (gsflag == 'T')        //it is a temperature line
+            {
+              if (ion[n].bad_gs_rr_t_flag == 0)       //and we need a temp line for this ion
               {
-                if (ion[n].bad_gs_rr_t_flag == 0)       //and we need a temp line for this ion
-                {
-                  if (gstemp[0] > gstmin)
-                    gstmin = gstemp[0];
-                  if (gstemp[18] < gstmax)
-                    gstmax = gstemp[18];
-                  ion[n].bad_gs_rr_t_flag = 1;  //set the flag
-                  for (n1 = 0; n1 < nparam; n1++)
-                  {
-                    bad_gs_rr[ion[n].nxbadgsrr].temps[n1] = gstemp[n1];
-                  }
-                }
-                else if (ion[n].bad_gs_rr_t_flag == 1)  //we already have a temp line for this ion
-                {
-                  Error ("More than one temp line for badnell GS RR rate for ion %i\n", n);
-                  Error ("Get_atomic_data: %s\n", aline);
-                  exit (0);
-                }
-                else            //some other odd thing had happened
+                if (gstemp[0] > gstmin)
+                  gstmin = gstemp[0];
+                if (gstemp[18] < gstmax)
+                  gstmax = gstemp[18];
+                ion[n].bad_gs_rr_t_flag = 1;  //set the flag
+                for (n1 = 0; n1 < nparam; n1++)
                 {
-                  Error ("Get_atomic_data: %s\n", aline);
-                  exit (0);
+                  bad_gs_rr[ion[n].nxbadgsrr].temps[n1] = gstemp[n1];
                 }
               }
-              else if (gsflag == 'R')   //it is a rate line
+              else if (ion[n].bad_gs_rr_t_flag == 1)  //we already have a temp line for this ion
               {
-                if (ion[n].bad_gs_rr_r_flag == 0)       //and we need a rate line for this ion
-                {
-                  ion[n].bad_gs_rr_r_flag = 1;  //set the flag
-                  for (n1 = 0; n1 < nparam; n1++)
-                  {
-                    bad_gs_rr[ion[n].nxbadgsrr].rates[n1] = gstemp[n1];
-                  }
-                }
-                else if (ion[n].bad_gs_rr_r_flag == 1)  //we already have a rate line for this ion
-                {
-                  Error ("More than one rate line for badnell GS RR rate for ion %i\n", n);
-                  Error ("Get_atomic_data: %s\n", aline);
-                  exit (0);
-                }
-                else            //some other odd thing had happened
+                Error ("More than one temp line for badnell GS RR rate for ion %i\n", n);
+                Error ("Get_atomic_data: %s\n", aline);
+                exit (0);
+              }
+              else            //some other odd thing had happened
+              {
+                Error ("Get_atomic_data: %s\n", aline);
+                exit (0);
+              }
+            }
+            else if (gsflag == 'R')   //it is a rate line
+            {
+              if (ion[n].bad_gs_rr_r_flag == 0)       //and we need a rate line for this ion
+              {
+                ion[n].bad_gs_rr_r_flag = 1;  //set the flag
+                for (n1 = 0; n1 < nparam; n1++)
                 {
-                  Error ("Get_atomic_data: %s\n", aline);
-                  exit (0);
+                  bad_gs_rr[ion[n].nxbadgsrr].rates[n1] = gstemp[n1];
                 }
               }
-              else              //We have some problem with this line
+              else if (ion[n].bad_gs_rr_r_flag == 1)  //we already have a rate line for this ion
+              {
+                Error ("More than one rate line for badnell GS RR rate for ion %i\n", n);
+                Error ("Get_atomic_data: %s\n", aline);
+                exit (0);
+              }
+              else            //some other odd thing had happened
               {
                 Error ("Get_atomic_data: %s\n", aline);
                 exit (0);
               }
-            }                   //end of loop over dealing with data for a discovered ion
-          }                     //end of loop over ions
+            }
+            else              //We have some problem with this line
+            {
+              Error ("Get_atomic_data: %s\n", aline);
+              exit (0);
+            }
+          }                   //end of loop over dealing with data for a discovered ion
+        }                     //end of loop over ions
 
-          break;
+        break;
 
 /**
  * @section gaunt factor
@@ -2216,30 +2199,30 @@ would like to have simple lines for macro-ions */
 * @endverbatim
 
  */
-        case 'g':
-          nparam = sscanf (aline, "%*s %le %le %le %le %le", &gsqrdtemp, &gfftemp, &s1temp, &s2temp, &s3temp);  //split and assign the line
-          if (nparam > 5 || nparam < 1) //     trap errors
-          {
-            Error ("Something wrong with sutherland gaunt data\n");
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
-          if (gaunt_n_gsqrd == 0 || gsqrdtemp > gaunt_total[gaunt_n_gsqrd - 1].log_gsqrd)       //We will use it if it's our first piece of data or is in order
-          {
-            gaunt_total[gaunt_n_gsqrd].log_gsqrd = gsqrdtemp;   //The scaled electron temperature squared for this array
-            gaunt_total[gaunt_n_gsqrd].gff = gfftemp;
-            gaunt_total[gaunt_n_gsqrd].s1 = s1temp;
-            gaunt_total[gaunt_n_gsqrd].s2 = s2temp;
-            gaunt_total[gaunt_n_gsqrd].s3 = s3temp;
-            gaunt_n_gsqrd++;
-          }
-          else
-          {
-            Error ("Something wrong with gaunt data\n");
-            Error ("Get_atomic_data %s\n", aline);
-            exit (0);
-          }
-          break;
+      case 'g':
+        nparam = sscanf (aline, "%*s %le %le %le %le %le", &gsqrdtemp, &gfftemp, &s1temp, &s2temp, &s3temp);  //split and assign the line
+        if (nparam > 5 || nparam < 1) //     trap errors
+        {
+          Error ("Something wrong with sutherland gaunt data\n");
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        if (gaunt_n_gsqrd == 0 || gsqrdtemp > gaunt_total[gaunt_n_gsqrd - 1].log_gsqrd)       //We will use it if it's our first piece of data or is in order
+        {
+          gaunt_total[gaunt_n_gsqrd].log_gsqrd = gsqrdtemp;   //The scaled electron temperature squared for this array
+          gaunt_total[gaunt_n_gsqrd].gff = gfftemp;
+          gaunt_total[gaunt_n_gsqrd].s1 = s1temp;
+          gaunt_total[gaunt_n_gsqrd].s2 = s2temp;
+          gaunt_total[gaunt_n_gsqrd].s3 = s3temp;
+          gaunt_n_gsqrd++;
+        }
+        else
+        {
+          Error ("Something wrong with gaunt data\n");
+          Error ("Get_atomic_data %s\n", aline);
+          exit (0);
+        }
+        break;
 /**
  * @section direct (collisional) ionization data from Dere 07.
  * #Title: Ionization rate coefficients for elements H to Zn (Dere+, 2007)
@@ -2253,42 +2236,42 @@ would like to have simple lines for macro-ions */
  * #Column x1-X20      (F7.4)  Scaled temperature 1 (1)        [ucd=phys.temperature]
  * #Column rho1 -rho20   (F8.4)  ? Scaled rate coefficient 1 (2) [ucd=arith.rate;phys.atmol.collisional]
  */
-        case 'd':
-          nparam = sscanf (aline, "%*s %d %d %d %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le", &z, &istate, &nspline, &et, &tmin, &temp[0], &temp[1], &temp[2], &temp[3], &temp[4], &temp[5], &temp[6], &temp[7], &temp[8], &temp[9], &temp[10], &temp[11], &temp[12], &temp[13], &temp[14], &temp[15], &temp[16], &temp[17], &temp[18], &temp[19], &temp[20], &temp[21], &temp[22], &temp[23], &temp[24], &temp[25], &temp[26], &temp[27], &temp[28], &temp[29], &temp[30], &temp[31], &temp[32], &temp[33], &temp[34], &temp[35], &temp[36], &temp[37], &temp[38], &temp[39]);     //split and assign the line
+      case 'd':
+        nparam = sscanf (aline, "%*s %d %d %d %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le", &z, &istate, &nspline, &et, &tmin, &temp[0], &temp[1], &temp[2], &temp[3], &temp[4], &temp[5], &temp[6], &temp[7], &temp[8], &temp[9], &temp[10], &temp[11], &temp[12], &temp[13], &temp[14], &temp[15], &temp[16], &temp[17], &temp[18], &temp[19], &temp[20], &temp[21], &temp[22], &temp[23], &temp[24], &temp[25], &temp[26], &temp[27], &temp[28], &temp[29], &temp[30], &temp[31], &temp[32], &temp[33], &temp[34], &temp[35], &temp[36], &temp[37], &temp[38], &temp[39]);     //split and assign the line
 
-          if (nparam != 5 + (nspline * 2))      //     trap errors
-          {
-            Error ("Something wrong with Dere DI data\n");
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
-          for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        if (nparam != 5 + (nspline * 2))      //     trap errors
+        {
+          Error ("Something wrong with Dere DI data\n");
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        {
+          if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
           {
-            if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
+            if (ion[n].dere_di_flag == 0)     //This is first set of this type of data for this ion
             {
-              if (ion[n].dere_di_flag == 0)     //This is first set of this type of data for this ion
+              ion[n].dere_di_flag = 1;
+              dere_di_rate[n_dere_di_rate].nion = n;  //put the ion number into the dere_di_rate structure
+              ion[n].nxderedi = n_dere_di_rate;       //put the number of the dere_di_rate into the ion structure so we can go either way.
+              dere_di_rate[n_dere_di_rate].xi = et;
+              dere_di_rate[n_dere_di_rate].min_temp = tmin;
+              dere_di_rate[n_dere_di_rate].nspline = nspline;
+              for (n1 = 0; n1 < nspline; n1++)
               {
-                ion[n].dere_di_flag = 1;
-                dere_di_rate[n_dere_di_rate].nion = n;  //put the ion number into the dere_di_rate structure
-                ion[n].nxderedi = n_dere_di_rate;       //put the number of the dere_di_rate into the ion structure so we can go either way.
-                dere_di_rate[n_dere_di_rate].xi = et;
-                dere_di_rate[n_dere_di_rate].min_temp = tmin;
-                dere_di_rate[n_dere_di_rate].nspline = nspline;
-                for (n1 = 0; n1 < nspline; n1++)
-                {
-                  dere_di_rate[n_dere_di_rate].temps[n1] = temp[n1];
-                  dere_di_rate[n_dere_di_rate].rates[n1] = temp[n1 + nspline] * 1e-6;
+                dere_di_rate[n_dere_di_rate].temps[n1] = temp[n1];
+                dere_di_rate[n_dere_di_rate].rates[n1] = temp[n1 + nspline] * 1e-6;
 
-                }
-                n_dere_di_rate++;       //increment the counter of number of ground state RR
-              }
-              else
-              {
-                Error ("Get_atomic_data: More than one Dere DI rate for ion %i\n", n);
               }
+              n_dere_di_rate++;       //increment the counter of number of ground state RR
+            }
+            else
+            {
+              Error ("Get_atomic_data: More than one Dere DI rate for ion %i\n", n);
             }
           }
-          break;
+        }
+        break;
 
 /**
  * @section Electron yield - goes with auger ionization rates
@@ -2304,45 +2287,45 @@ would like to have simple lines for macro-ions */
 
 */
 
-        case 'K':
-          nparam =
-            sscanf (aline,
-                    "%*s %d %d %d %d %le %le %le %le %le %le %le %le %le %le %le %le",
-                    &z, &istate, &in, &il, &I, &Ea, &temp[0],
-                    &temp[1], &temp[2], &temp[3], &temp[4], &temp[5], &temp[6], &temp[7], &temp[8], &temp[9]);
-          if (nparam != 16)
-          {
-            Error ("Something wrong with electron yield data\n");
-            Error ("Get_atomic_data %s\n", aline);
-            exit (0);
-          }
-          for (n = 0; n < n_inner_tot; n++)
+      case 'K':
+        nparam =
+          sscanf (aline,
+                  "%*s %d %d %d %d %le %le %le %le %le %le %le %le %le %le %le %le",
+                  &z, &istate, &in, &il, &I, &Ea, &temp[0],
+                  &temp[1], &temp[2], &temp[3], &temp[4], &temp[5], &temp[6], &temp[7], &temp[8], &temp[9]);
+        if (nparam != 16)
+        {
+          Error ("Something wrong with electron yield data\n");
+          Error ("Get_atomic_data %s\n", aline);
+          exit (0);
+        }
+        for (n = 0; n < n_inner_tot; n++)
+        {
+          if (inner_cross[n].z == z && inner_cross[n].istate == istate && inner_cross[n].n == in && inner_cross[n].l == il)
           {
-            if (inner_cross[n].z == z && inner_cross[n].istate == istate && inner_cross[n].n == in && inner_cross[n].l == il)
+            if (inner_cross[n].n_elec_yield == -1)    /*This is the first yield data for this vacancy */
             {
-              if (inner_cross[n].n_elec_yield == -1)    /*This is the first yield data for this vacancy */
-              {
-                inner_elec_yield[n_elec_yield_tot].nion = n;    /*This yield refers to this ion */
-                inner_cross[n].n_elec_yield = n_elec_yield_tot;
-                inner_elec_yield[n_elec_yield_tot].z = z;
-                inner_elec_yield[n_elec_yield_tot].istate = istate;
-                inner_elec_yield[n_elec_yield_tot].n = in;
-                inner_elec_yield[n_elec_yield_tot].l = il;
-                inner_elec_yield[n_elec_yield_tot].I = I * EV2ERGS;
-                inner_elec_yield[n_elec_yield_tot].Ea = Ea * EV2ERGS;
-                for (n1 = 0; n1 < 10; n1++)
-                {
-                  inner_elec_yield[n_elec_yield_tot].prob[n1] = temp[n1] / 10000.0;
-                }
-                n_elec_yield_tot++;
-              }
-              else
+              inner_elec_yield[n_elec_yield_tot].nion = n;    /*This yield refers to this ion */
+              inner_cross[n].n_elec_yield = n_elec_yield_tot;
+              inner_elec_yield[n_elec_yield_tot].z = z;
+              inner_elec_yield[n_elec_yield_tot].istate = istate;
+              inner_elec_yield[n_elec_yield_tot].n = in;
+              inner_elec_yield[n_elec_yield_tot].l = il;
+              inner_elec_yield[n_elec_yield_tot].I = I * EV2ERGS;
+              inner_elec_yield[n_elec_yield_tot].Ea = Ea * EV2ERGS;
+              for (n1 = 0; n1 < 10; n1++)
               {
-                Error ("Get_atomic_data: more than one electron yield record for inner_cross %i z=%i istate=%i\n", n, z, istate);
+                inner_elec_yield[n_elec_yield_tot].prob[n1] = temp[n1] / 10000.0;
               }
+              n_elec_yield_tot++;
+            }
+            else
+            {
+              Error ("Get_atomic_data: more than one electron yield record for inner_cross %i z=%i istate=%i\n", n, z, istate);
             }
           }
-          break;
+        }
+        break;
 
 /**
 * @section Charge exchange recombination and ionization state
@@ -2363,44 +2346,44 @@ would like to have simple lines for macro-ions */
 
 */
 
-        case 'X':
-          nparam =
-            sscanf (aline,
-                    "%*s %d %d %d %d %le %le %le %le %le %le %le %le", &z, &istate, &z2, &istate2, &a, &b, &c, &d, &tmin, &tmax, &delta_E,
-                    &delta_E_ovr_k);
-          if (nparam != 12)
-          {
-            Error ("Something wrong with charge exchange data\n");
-            Error ("Get_atomic_data %s\n", aline);
-            exit (0);
-          }
-          charge_exchange[n_charge_exchange].nion1 = charge_exchange[n_charge_exchange].nion2 = -1;
-          for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+      case 'X':
+        nparam =
+          sscanf (aline,
+                  "%*s %d %d %d %d %le %le %le %le %le %le %le %le", &z, &istate, &z2, &istate2, &a, &b, &c, &d, &tmin, &tmax, &delta_E,
+                  &delta_E_ovr_k);
+        if (nparam != 12)
+        {
+          Error ("Something wrong with charge exchange data\n");
+          Error ("Get_atomic_data %s\n", aline);
+          exit (0);
+        }
+        charge_exchange[n_charge_exchange].nion1 = charge_exchange[n_charge_exchange].nion2 = -1;
+        for (n = 0; n < nions; n++)   //Loop over ions to find the correct place to put the data
+        {
+          if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
           {
-            if (ion[n].z == z && ion[n].istate == istate)       // this works out which ion we are dealing with
-            {
-              charge_exchange[n_charge_exchange].nion1 = n;
-            }
-            else if (ion[n].z == z2 && ion[n].istate == istate2)
-            {
-              charge_exchange[n_charge_exchange].nion2 = n;
-            }
+            charge_exchange[n_charge_exchange].nion1 = n;
           }
-          if (charge_exchange[n_charge_exchange].nion1 > -1 && charge_exchange[n_charge_exchange].nion2 > -1)   //Only read in if we have both ions in our data
+          else if (ion[n].z == z2 && ion[n].istate == istate2)
           {
-            charge_exchange[n_charge_exchange].a = a;
-            charge_exchange[n_charge_exchange].b = b;
-            charge_exchange[n_charge_exchange].c = c;
-            charge_exchange[n_charge_exchange].d = d;
-            charge_exchange[n_charge_exchange].tmax = tmax;
-            charge_exchange[n_charge_exchange].tmin = tmin;
-            charge_exchange[n_charge_exchange].energy_defect = delta_E * EV2ERGS;
-            charge_exchange[n_charge_exchange].delta_e_ovr_k = delta_E_ovr_k;
-            if (ion[charge_exchange[n_charge_exchange].nion1].z == 1)   //Assign *recombination* tates only to the televant ion. 
-              ion[charge_exchange[n_charge_exchange].nion2].n_ch_ex = n_charge_exchange;
-            n_charge_exchange++;
+            charge_exchange[n_charge_exchange].nion2 = n;
           }
-          break;
+        }
+        if (charge_exchange[n_charge_exchange].nion1 > -1 && charge_exchange[n_charge_exchange].nion2 > -1)   //Only read in if we have both ions in our data
+        {
+          charge_exchange[n_charge_exchange].a = a;
+          charge_exchange[n_charge_exchange].b = b;
+          charge_exchange[n_charge_exchange].c = c;
+          charge_exchange[n_charge_exchange].d = d;
+          charge_exchange[n_charge_exchange].tmax = tmax;
+          charge_exchange[n_charge_exchange].tmin = tmin;
+          charge_exchange[n_charge_exchange].energy_defect = delta_E * EV2ERGS;
+          charge_exchange[n_charge_exchange].delta_e_ovr_k = delta_E_ovr_k;
+          if (ion[charge_exchange[n_charge_exchange].nion1].z == 1)   //Assign *recombination* tates only to the televant ion. 
+            ion[charge_exchange[n_charge_exchange].nion2].n_ch_ex = n_charge_exchange;
+          n_charge_exchange++;
+        }
+        break;
 
 /**
  * @section Fluorescent photon yield from inner shell ionization - not currently used but read in.
@@ -2416,37 +2399,37 @@ would like to have simple lines for macro-ions */
  * Kphotyield 5 1 1 0 1.690e+01 7.129e-01
  * @endverbatim
  
-        case 'F':
-          nparam = sscanf (aline, "%*s %d %d %d %d %le %le ", &z, &istate, &in, &il, &energy, &yield);
-          if (nparam != 6)
-          {
-            Error ("Something wrong with fluorescent yield data\n");
-            Error ("Get_atomic_data %s\n", aline);
-            exit (0);
-          }
-          for (n = 0; n < n_inner_tot; n++)
+      case 'F':
+        nparam = sscanf (aline, "%*s %d %d %d %d %le %le ", &z, &istate, &in, &il, &energy, &yield);
+        if (nparam != 6)
+        {
+          Error ("Something wrong with fluorescent yield data\n");
+          Error ("Get_atomic_data %s\n", aline);
+          exit (0);
+        }
+        for (n = 0; n < n_inner_tot; n++)
+        {
+          if (inner_cross[n].z == z && inner_cross[n].istate == istate && inner_cross[n].n == in && inner_cross[n].l == il)
           {
-            if (inner_cross[n].z == z && inner_cross[n].istate == istate && inner_cross[n].n == in && inner_cross[n].l == il)
+            if (inner_cross[n].n_fluor_yield == -1)   //This is the first yield data for this vacancy 
             {
-              if (inner_cross[n].n_fluor_yield == -1)   //This is the first yield data for this vacancy 
-              {
-                inner_fluor_yield[n_fluor_yield_tot].nion = n;  //This yield refers to this ion 
-                inner_cross[n].n_fluor_yield = n_fluor_yield_tot;
-                inner_fluor_yield[n_fluor_yield_tot].z = z;
-                inner_fluor_yield[n_fluor_yield_tot].istate = istate;
-                inner_fluor_yield[n_fluor_yield_tot].n = in;
-                inner_fluor_yield[n_fluor_yield_tot].l = il;
-                inner_fluor_yield[n_fluor_yield_tot].freq = energy / HEV;
-                inner_fluor_yield[n_fluor_yield_tot].yield = yield;
-                n_fluor_yield_tot++;
-              }
-              else
-              {
-                Error ("Get_atomic_data: more than one fluorescent yield record for inner_cross %i\n", n);
-              }
+              inner_fluor_yield[n_fluor_yield_tot].nion = n;  //This yield refers to this ion 
+              inner_cross[n].n_fluor_yield = n_fluor_yield_tot;
+              inner_fluor_yield[n_fluor_yield_tot].z = z;
+              inner_fluor_yield[n_fluor_yield_tot].istate = istate;
+              inner_fluor_yield[n_fluor_yield_tot].n = in;
+              inner_fluor_yield[n_fluor_yield_tot].l = il;
+              inner_fluor_yield[n_fluor_yield_tot].freq = energy / HEV;
+              inner_fluor_yield[n_fluor_yield_tot].yield = yield;
+              n_fluor_yield_tot++;
+            }
+            else
+            {
+              Error ("Get_atomic_data: more than one fluorescent yield record for inner_cross %i\n", n);
             }
           }
-          break;
+        }
+        break;
 		  */
 
 /**
@@ -2476,128 +2459,152 @@ SCUPS    1.132e-01   2.708e-01   5.017e-01   8.519e-01   1.478e+00
 
  *		  */
 
-        case 'C':
-          Debug ("A  %d %s", lineno, aline);
-          lineno++;
-          if (fgets (bline, LINELENGTH, fptr) == NULL)
-          {
-            Error ("Get_atomic_data: Problem reading collision strength record 2 in line %d of %s\n", lineno, file);
-            Error ("Get_atomic_data: %s\n", aline);
-            Exit (0);
-            //exit (0);
-          }
-          Debug ("B  %d %s", lineno, aline);
-          lineno++;
-          if (fgets (cline, LINELENGTH, fptr) == NULL)
-          {
-            Error ("Get_atomic_data: Problem reading collision strength record 2 in line %d of %s\n", lineno, file);
-            Error ("Get_atomic_data: %s\n", aline);
-            Exit (0);
-            //exit (0);
-          }
-          Debug ("C  %d %s", lineno, aline);
-
-          /* Finished reading the data for a collision strength */
+      case 'C':
+        Debug ("A  %d %s\n", lineno, aline);
+        lineno++;
+        if (rec->nextra < 1)
+        {
+          Error ("Get_atomic_data: Problem reading collision strength record 2 in line %d of %s\n", lineno, file);
+          Error ("Get_atomic_data: %s\n", aline);
+          Exit (0);
+          //exit (0);
+        }
+        Debug ("B  %d %s\n", lineno, aline);
+        lineno++;
+        if (rec->nextra < 2)
+        {
+          Error ("Get_atomic_data: Problem reading collision strength record 2 in line %d of %s\n", lineno, file);
+          Error ("Get_atomic_data: %s\n", aline);
+          Exit (0);
+          //exit (0);
+        }
+        Debug ("C  %d %s\n", lineno, aline);
+        bline = rec->extra[0];
+        cline = rec->extra[1];
+
+        /* Finished reading the data for a collision strength */
+
+        nparam =
+          (sscanf
+           (aline,
+            "%*s %*s %d %2d %le %le %le %le %le %le %d %d %d %d %le %le %le %d %d %le",
+            &z, &istate, &wave, &f, &gl, &gu, &el, &eu, &levl, &levu, &c_l, &c_u, &en, &gf, &hlt, &np, &type, &sp));
+        if (nparam != 18)
+        {
+          Error ("Get_atomic_data: file %s line %d: Collision strength line incorrectly formatted\n", file, lineno);
+          Error ("Get_atomic_data: %s\n", aline);
+          exit (0);
+        }
+        for (n = 0; n < nlines; n++)  //loop over all the lines we have read in - look for a match
+        {
+          dlambda = fabs (wave - VLIGHT * 1e8 / line[n].freq);
 
-          nparam =
-            (sscanf
-             (aline,
-              "%*s %*s %d %2d %le %le %le %le %le %le %d %d %d %d %le %le %le %d %d %le",
-              &z, &istate, &wave, &f, &gl, &gu, &el, &eu, &levl, &levu, &c_l, &c_u, &en, &gf, &hlt, &np, &type, &sp));
-          if (nparam != 18)
-          {
-            Error ("Get_atomic_data: file %s line %d: Collision strength line incorrectly formatted\n", file, lineno);
-            Error ("Get_atomic_data: %s\n", aline);
-            exit (0);
-          }
-          for (n = 0; n < nlines; n++)  //loop over all the lines we have read in - look for a match
+          if (line[n].z == z && line[n].istate == istate && dlambda < 2e-6
+              && line[n].levl == levl && line[n].levu == levu && line[n].gl == gl && line[n].gu == gu && line[n].f == f)
           {
-            dlambda = fabs (wave - VLIGHT * 1e8 / line[n].freq);
-
-            if (line[n].z == z && line[n].istate == istate && dlambda < 2e-6
-                && line[n].levl == levl && line[n].levu == levu && line[n].gl == gl && line[n].gu == gu && line[n].f == f)
+            if (line[n].coll_index > -1)      //We already have a collision strength record from this line - throw an error and quit
             {
-              if (line[n].coll_index > -1)      //We already have a collision strength record from this line - throw an error and quit
-              {
-                Error ("Get_atomic_data More than one collision strength record for line %i\n", n);
-                Error ("Get_atomic_data: %s\n", aline);
-                exit (0);
-              }
+              Error ("Get_atomic_data More than one collision strength record for line %i\n", n);
+              Error ("Get_atomic_data: %s\n", aline);
+              exit (0);
+            }
 
 
-              /* The number of allowd entries in atomic.h needs to be greater than the number one is trying to read in.
-               * If this needs to be increased be sure to modify the scanf line below
-               */
-              if (np > N_COLL_STREN_PTS)
-              {
-                Error ("Get_atomic_data: np %d > %d N_COLL_STREN_PTS in file %s line %d\n", np, N_COLL_STREN_PTS, file, lineno);
-                np = N_COLL_STREN_PTS;
-              }
+            /* The number of allowd entries in atomic.h needs to be greater than the number one is trying to read in.
+             * If this needs to be increased be sure to modify the scanf line below
+             */
+            if (np > N_COLL_STREN_PTS)
+            {
+              Error ("Get_atomic_data: np %d > %d N_COLL_STREN_PTS in file %s line %d\n", np, N_COLL_STREN_PTS, file, lineno);
+              np = N_COLL_STREN_PTS;
+            }
 
-              coll_stren[n_coll_stren].n = n_coll_stren;
-              coll_stren[n_coll_stren].lower = c_l;
-              coll_stren[n_coll_stren].upper = c_u;
-              coll_stren[n_coll_stren].energy = en;
-              coll_stren[n_coll_stren].gf = gf;
-              coll_stren[n_coll_stren].hi_t_lim = hlt;
-              coll_stren[n_coll_stren].n_points = np;
-              coll_stren[n_coll_stren].type = type;
-              coll_stren[n_coll_stren].scaling_param = sp;
-
-              line[n].coll_index = n_coll_stren;        //point the line to its matching collision strength
-
-              nparam =
-                sscanf (bline,
-                        "%*s %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le",
-                        &temp[0], &temp[1], &temp[2], &temp[3],
-                        &temp[4], &temp[5], &temp[6], &temp[7],
-                        &temp[8], &temp[9], &temp[10], &temp[11],
-                        &temp[12], &temp[13], &temp[14], &temp[15], &temp[16], &temp[17], &temp[18], &temp[19]);
-
-              for (nn = 0; nn < np; nn++)
-              {
-                coll_stren[n_coll_stren].sct[nn] = temp[nn];
-              }
+            coll_stren[n_coll_stren].n = n_coll_stren;
+            coll_stren[n_coll_stren].lower = c_l;
+            coll_stren[n_coll_stren].upper = c_u;
+            coll_stren[n_coll_stren].energy = en;
+            coll_stren[n_coll_stren].gf = gf;
+            coll_stren[n_coll_stren].hi_t_lim = hlt;
+            coll_stren[n_coll_stren].n_points = np;
+            coll_stren[n_coll_stren].type = type;
+            coll_stren[n_coll_stren].scaling_param = sp;
+
+            line[n].coll_index = n_coll_stren;        //point the line to its matching collision strength
+
+            nparam =
+              sscanf (bline,
+                      "%*s %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le",
+                      &temp[0], &temp[1], &temp[2], &temp[3],
+                      &temp[4], &temp[5], &temp[6], &temp[7],
+                      &temp[8], &temp[9], &temp[10], &temp[11],
+                      &temp[12], &temp[13], &temp[14], &temp[15], &temp[16], &temp[17], &temp[18], &temp[19]);
+
+            for (nn = 0; nn < np; nn++)
+            {
+              coll_stren[n_coll_stren].sct[nn] = temp[nn];
+            }
 
-              nparam =
-                sscanf (cline,
-                        "%*s %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le",
-                        &temp[0], &temp[1], &temp[2], &temp[3],
-                        &temp[4], &temp[5], &temp[6], &temp[7],
-                        &temp[8], &temp[9], &temp[10], &temp[11],
-                        &temp[12], &temp[13], &temp[14], &temp[15], &temp[16], &temp[17], &temp[18], &temp[19]);
+            nparam =
+              sscanf (cline,
+                      "%*s %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le %le",
+                      &temp[0], &temp[1], &temp[2], &temp[3],
+                      &temp[4], &temp[5], &temp[6], &temp[7],
+                      &temp[8], &temp[9], &temp[10], &temp[11],
+                      &temp[12], &temp[13], &temp[14], &temp[15], &temp[16], &temp[17], &temp[18], &temp[19]);
 
-              for (nn = 0; nn < np; nn++)
-              {
-                coll_stren[n_coll_stren].scups[nn] = temp[nn];
-              }
-              n_coll_stren++;
+            for (nn = 0; nn < np; nn++)
+            {
+              coll_stren[n_coll_stren].scups[nn] = temp[nn];
             }
+            n_coll_stren++;
           }
-          break;
-
-        case 'c':              /* It was a comment line so do nothing */
-          break;
-        case 'z':
-
-        default:
-          Error ("get_atomicdata: (Case default) Could not interpret line %d in file %s: %s %d \n", lineno, file, aline, LINELENGTH);
-          break;
         }
+        break;
 
-        strcpy (aline, "");
+      case 'c':              /* It was a comment line so do nothing */
+        break;
+      case 'z':
+
+      default:
+        Error ("get_atomicdata: (Case default) Could not interpret line %d in file %s: %s %d \n", lineno, file, aline, LINELENGTH);
+        break;
       }
+    }
+
+    free_atomic_data_file (dfile);
+  }
+  free (dfiles);
+  Trace_end ("apply records");
 
-      fclose (fptr);
+  Trace_begin ("compact tables");
+  npoints = xsection_pool_compact ();
+  Log_silent ("Get_atomic_data: Stored %d photoionization x-section points\n", npoints);
+
+/* Some line records, for example simple lines for macro-atom ions, are ignored, so return the
+   unused part of the line tables now the number of lines is known.  The spare entry is kept */
+
+  if (nlines < atomic_max.nlines)
+  {
+    atomic_max.nlines = nlines;
+    line = (LinePtr) shared_realloc (line, nlines + 1, sizeof (line_dummy));
+    lin_idx = (int *) shared_realloc (lin_idx, nlines + 1, sizeof (int));
+    if (line == NULL || lin_idx == NULL)
+    {
+      Error ("Get_atomic_data: Could not resize the line structure to %d lines\n", nlines);
+      exit (0);
     }
-    /*End of do loop for reading a particular file of data */
   }
 
-/* End of main do loop for reading all of the the data. At this point we can close
-   the masterfile
- */
+/* Now all of the Macro Atom jumps are known, build the lists of the jumps from each configuration */
+
+  jump_list_build (&bbu_jumps, nlevels);
+  jump_list_build (&bbd_jumps, nlevels);
+  jump_list_build (&bfu_jumps, nlevels);
+  jump_list_build (&bfd_jumps, nlevels);
+  Trace_end ("compact tables");
+
+/* End of main do loop for reading all of the the data. */
 
-  fclose (mptr);
 /* OK now summarize the data that has been read*/
 
   n_elec_yield_tot = 0;         //Reset this numnber, we are now going to use it to check we have yields for all inner shells
@@ -2712,6 +2719,16 @@ exit if there is an element with no ions */
   }
 
 
+/* Calculate the coefficients of each line which do not depend on temperature */
+
+  Trace_begin ("line_coefficients");
+  for (n = 0; n < nlines; n++)
+  {
+    line_coefficients (&line[n]);
+  }
+  Trace_end ("line_coefficients");
+
+
 /* Now attempt to associate lines with levels. If an association is found use, create
 a total emission oscillator strength for the level....really ought to be radiative lifefime */
 
@@ -2721,6 +2738,7 @@ a total emission oscillator strength for the level....really ought to be radiati
  so the check is avoided by checking the macro_info flag SS
 */
 
+  Trace_begin ("match levels");
   ierr = 0;
 
   for (n = 0; n < nlines; n++)
@@ -2823,13 +2841,14 @@ or zero so that simple checks of true and false can be used for them */
     }
 
   }
+  Trace_end ("match levels");
 
 /* Finally evaluate how close we are to limits set in the structures */
 
-  Log ("get_atomic_data: Evaluation:  There are %6d elements     while %6d are currently allowed\n", nelements, NELEMENTS);
+  Log ("get_atomic_data: Evaluation:  There are %6d elements     while %6d were allocated\n", nelements, atomic_max.nelements);
   Log ("get_atomic_data: Evaluation:  There are %6d ions         while %6d are currently allowed\n", nions, NIONS);
-  Log ("get_atomic_data: Evaluation:  There are %6d levels       while %6d are currently allowed\n", nlevels, NLEVELS);
-  Log ("get_atomic_data: Evaluation:  There are %6d lines        while %6d are currently allowed\n", nlines, NLINES);
+  Log ("get_atomic_data: Evaluation:  There are %6d levels       while %6d were allocated\n", nlevels, atomic_max.nlevels);
+  Log ("get_atomic_data: Evaluation:  There are %6d lines        while %6d were allocated\n", nlines, atomic_max.nlines);
   Log ("get_atomic_data: Evaluation:  There are %6d macro levels while %6d are currently allowed\n", nlevels_macro, NLEVELS_MACRO);
 
   bb_max = 0;
@@ -2848,8 +2867,11 @@ or zero so that simple checks of true and false can be used for them */
   }
 
 
-  Log ("get_atomic_data: Evaluation:  The maximum value bb jumps is %d while %d are currently allowed\n", bb_max, NBBJUMPS);
-  Log ("get_atomic_data: Evaluation:  The maximum value bf jumps is %d while %d are currently allowed\n", bb_max, NBBJUMPS);
+  Log ("get_atomic_data: Evaluation:  The maximum value bb jumps is %d\n", bb_max);
+  Log ("get_atomic_data: Evaluation:  The maximum value bf jumps is %d\n", bf_max);
+  Log ("get_atomic_data: Evaluation:  The Macro Atom jump lists hold %d bb and %d bf jumps in %.3g MB\n",
+       bbu_jumps.njumps + bbd_jumps.njumps, bfu_jumps.njumps + bfd_jumps.njumps,
+       1.e-6 * sizeof (int) * (4 * (nlevels + 1) + bbu_jumps.njumps + bbd_jumps.njumps + bfu_jumps.njumps + bfd_jumps.njumps));
 
 /* Now, write the data to a file so you can check it later if you wish */
 /* this is controlled by one of the -d flag modes, defined in atomic.h */
@@ -2882,6 +2904,7 @@ or zero so that simple checks of true and false can be used for them */
    */
 
   /* Index the lines */
+  Trace_begin ("index tables");
   index_lines ();
 
 /* Index the topbase photoionization structure by threshold freqeuncy */
@@ -2890,9 +2913,13 @@ or zero so that simple checks of true and false can be used for them */
 /* Index the topbase photoionization structure by threshold freqeuncy */
   if (n_inner_tot > 0)
     index_inner_cross ();
+  Trace_end ("index tables");
 
-
+  Trace_begin ("check_xsections");
   check_xsections ();           // debug routine, only prints if verbosity > 4
+  Trace_end ("check_xsections");
+
+  Trace_end ("get_atomic_data");
 
   return (0);
 }
@@ -24,6 +24,52 @@
 #define MAXWORDS    20
 
 
+/**********************************************************/
+/**
+ * @brief      Allocate one of the tables of atomic data
+ *
+ * @param [in] void *table   The current table, which is freed
+ * @param [in] size_t size   The size of one entry of the table
+ * @param [in] int n   The number of entries which can be read into the table
+ * @param [in] char *name   The name of the table, for logging and for finding it once it is shared
+ * @return     The new table
+ *
+ * @details
+ * The table has one entry more than can be read, see Atomic_sizes.
+ * The program exits if the memory cannot be allocated.
+ *
+ * The tables are allocated with shared_calloc, so that they can be
+ * moved into shared memory by share_atomic_data.  They must not hold
+ * pointers.
+ *
+ **********************************************************/
+
+static void *
+allocate_atomic_table (table, size, n, name)
+     void *table;
+     size_t size;
+     int n;
+     char *name;
+{
+  shared_free (table);
+  table = shared_calloc (name, n + 1, size);
+
+  if (table == NULL)
+  {
+    Error ("There is a problem in allocating memory for the %s structure\n", name);
+    exit (0);
+  }
+  else
+  {
+    Log_silent
+      ("Allocated %10d bytes for each of %6d elements of %11s totaling %10.1f Mb \n", (int) size, n + 1, name, 1.e-6 * (n + 1) * size);
+  }
+
+  return (table);
+}
+
+
+
 /**********************************************************/
 /**
  * @brief      routine to initialze the data structures 
@@ -34,6 +80,9 @@
  *
  * @details
  *
+ * The tables are allocated with the sizes in atomic_max, which
+ * get_atomic_data sets from the number of records of each type
+ * in the data files before calling this routine.
  *
  * ### Notes ###
  *
@@ -54,97 +103,32 @@ init_atomic_data ()
 
 /* Allocate structures for storage of data */
 
-  if (ele != NULL)
-  {
-    free (ele);
-  }
-  ele = (ElemPtr) calloc (sizeof (ele_dummy), NELEMENTS);
-
-  if (ele == NULL)
-  {
-    Error ("There is a problem in allocating memory for the element structure\n");
-    exit (0);
-  }
-  else
-  {
-    Log_silent
-      ("Allocated %10d bytes for each of %6d elements of   elements totaling %10.0f Mb \n",
-       sizeof (ele_dummy), NELEMENTS, 1.e-6 * NELEMENTS * sizeof (ele_dummy));
-  }
-
-
-  if (ion != NULL)
-  {
-    free (ion);
-  }
-  ion = (IonPtr) calloc (sizeof (ion_dummy), NIONS);
-
-  if (ion == NULL)
-  {
-    Error ("There is a problem in allocating memory for the ion structure\n");
-    exit (0);
-  }
-  else
-  {
-    Log_silent
-      ("Allocated %10d bytes for each of %6d elements of       ions totaling %10.1f Mb \n",
-       sizeof (ion_dummy), NIONS, 1.e-6 * NIONS * sizeof (ion_dummy));
-  }
-
-
-  if (xconfig != NULL)
-  {
-    free (xconfig);
-  }
-  xconfig = (ConfigPtr) calloc (sizeof (config_dummy), NLEVELS);
-
-  if (xconfig == NULL)
-  {
-    Error ("There is a problem in allocating memory for the config structure\n");
-    exit (0);
-  }
-  else
-  {
-    Log_silent
-      ("Allocated %10d bytes for each of %6d elements of     config totaling %10.1f Mb \n",
-       sizeof (config_dummy), NLEVELS, 1.e-6 * NLEVELS * sizeof (config_dummy));
-  }
-
-  if (line != NULL)
-  {
-    free (line);
-  }
-  line = (LinePtr) calloc (sizeof (line_dummy), NLINES);
-
-  if (line == NULL)
-  {
-    Error ("There is a problem in allocating memory for the line structure\n");
-    exit (0);
-  }
-  else
-  {
-    Log_silent
-      ("Allocated %10d bytes for each of %6d elements of       line totaling %10.1f Mb \n",
-       sizeof (line_dummy), NLINES, 1.e-6 * NLINES * sizeof (line_dummy));
-  }
-
-  if (auger_macro != NULL)
-  {
-    free (auger_macro);
-  }
-  auger_macro = (AugerPtr) calloc (sizeof (auger_dummy), NAUGER_MACRO);
-
-  if (auger_macro == NULL)
-  {
-    Error ("There is a problem in allocating memory for the line structure\n");
-    exit (0);
-  }
-  else
-  {
-    Log_silent
-      ("Allocated %10d bytes for each of %6d elements of auger_macro totaling %10.1f Mb \n",
-       sizeof (auger_dummy), NAUGER_MACRO, 1.e-6 * NAUGER_MACRO * sizeof (auger_dummy));
-  }
+  ele = (ElemPtr) allocate_atomic_table (ele, sizeof (ele_dummy), atomic_max.nelements, "elements");
+  ion = (IonPtr) allocate_atomic_table (ion, sizeof (ion_dummy), atomic_max.nions, "ions");
+  xconfig = (ConfigPtr) allocate_atomic_table (xconfig, sizeof (config_dummy), atomic_max.nlevels, "config");
+  line = (LinePtr) allocate_atomic_table (line, sizeof (line_dummy), atomic_max.nlines, "line");
+  lin_idx = (int *) allocate_atomic_table (lin_idx, sizeof (int), atomic_max.nlines, "lin_idx");
+  coll_stren = (Coll_stren *) allocate_atomic_table (coll_stren, sizeof (Coll_stren), atomic_max.ncoll_stren, "coll_stren");
+  phot_top = (Topbase_phot *) allocate_atomic_table (phot_top, sizeof (Topbase_phot), atomic_max.nphot, "phot_top");
+  phot_top_idx = (int *) allocate_atomic_table (phot_top_idx, sizeof (int), atomic_max.nphot, "phot_top_idx");
+  inner_cross = (Topbase_phot *) allocate_atomic_table (inner_cross, sizeof (Topbase_phot), atomic_max.ninner, "inner_cross");
+  inner_cross_idx = (int *) allocate_atomic_table (inner_cross_idx, sizeof (int), atomic_max.ninner, "inner_cross_idx");
+  inner_elec_yield =
+    (Inner_elec_yield *) allocate_atomic_table (inner_elec_yield, sizeof (Inner_elec_yield), atomic_max.ninner, "elec_yield");
+  inner_fluor_yield =
+    (Inner_fluor_yield *) allocate_atomic_table (inner_fluor_yield, sizeof (Inner_fluor_yield), atomic_max.ninner, "fluor_yield");
+  auger_macro = (AugerPtr) allocate_atomic_table (auger_macro, sizeof (auger_dummy), atomic_max.nauger_macro, "auger_macro");
+
+  /* The tables of fits have a fixed size */
+
+  ground_frac = (struct ground_fracs *) allocate_atomic_table (ground_frac, sizeof (struct ground_fracs), NIONS, "ground_frac");
+  drecomb = (Drecomb *) allocate_atomic_table (drecomb, sizeof (Drecomb), NIONS, "drecomb");
+  total_rr = (Total_rr *) allocate_atomic_table (total_rr, sizeof (Total_rr), NIONS, "total_rr");
+  bad_gs_rr = (Bad_gs_rr *) allocate_atomic_table (bad_gs_rr, sizeof (Bad_gs_rr), NIONS, "bad_gs_rr");
+  dere_di_rate = (Dere_di_rate *) allocate_atomic_table (dere_di_rate, sizeof (Dere_di_rate), NIONS, "dere_di_rate");
+  gaunt_total = (Gaunt_total *) allocate_atomic_table (gaunt_total, sizeof (Gaunt_total), MAX_GAUNT_N_GSQRD, "gaunt_total");
+  charge_exchange =
+    (Charge_exchange *) allocate_atomic_table (charge_exchange, sizeof (Charge_exchange), MAX_CHARGE_EXCHANGE, "charge_exchange");
 
 
   /* Initialize variables */
@@ -154,7 +138,7 @@ init_atomic_data ()
   phot_freq_min = VERY_BIG;
   inner_freq_min = VERY_BIG;
 
-  for (n = 0; n < NELEMENTS; n++)
+  for (n = 0; n <= atomic_max.nelements; n++)
   {
     strcpy (ele[n].name, "none");
     ele[n].z = (-1);
@@ -164,7 +148,7 @@ init_atomic_data ()
     ele[n].istate_max = (-1);
   }
 
-  for (n = 0; n < NIONS; n++)
+  for (n = 0; n <= atomic_max.nions; n++)
   {
     ion[n].z = (-1);
     ion[n].istate = (-1);
@@ -205,7 +189,7 @@ init_atomic_data ()
      are only used in some circumstances
    */
 
-  for (n = 0; n < NLEVELS; n++)
+  for (n = 0; n <= atomic_max.nphot; n++)
   {
     phot_top[n].nlev = (-1);
     phot_top[n].uplev = (-1);
@@ -216,23 +200,11 @@ init_atomic_data ()
     phot_top[n].z = (-1);       //atomic number
     phot_top[n].np = (-1);      //number of points in the fit
     phot_top[n].macro_info = (-1);      //Initialise - don't know if using Macro Atoms or not: set to -1 (SS)
-    for (j = 0; j < NCROSS; j++)        //initialise the crooss sectiond
-    {
-      phot_top[n].freq[j] = (-1);
-      phot_top[n].log_freq[j] = (-1);
-      phot_top[n].x[j] = (-1);
-      phot_top[n].log_x[j] = (-1);
-
-    }
-    phot_top[n].f = (-1);       //last frequency
-    phot_top[n].log_f = (-1);   //log of last frequency    
-    phot_top[n].sigma = 0.0;    //last cross section
-    phot_top[n].log_sigma = -1.0;       //log of last cross section
-
+    phot_top[n].offset = (-1);  //no points in the x-section pool
   }
 
 
-  for (n = 0; n < NIONS * N_INNER; n++) //Initialise atomic arrasy with dimension NIONS*NINNER
+  for (n = 0; n <= atomic_max.ninner; n++) //Initialise the inner shell x-sections and yields
   {
     inner_cross[n].nlev = (-1);
     inner_cross[n].uplev = (-1);
@@ -247,21 +219,17 @@ init_atomic_data ()
       inner_elec_yield[n].prob[j] = 0.0;
     inner_cross[n].np = (-1);
     inner_cross[n].macro_info = (-1);   //Initialise - don't know if using Macro Atoms or not: set to -1 (SS)
-    for (j = 0; j < NCROSS; j++)
-    {
-      inner_cross[n].freq[j] = (-1);
-      inner_cross[n].x[j] = (-1);
-      inner_cross[n].log_freq[j] = (-1);
-      inner_cross[n].log_x[j] = (-1);
-    }
-    inner_cross[n].f = (-1);
-    inner_cross[n].sigma = 0.0;
-    inner_cross[n].log_f = (-1);
-    inner_cross[n].log_sigma = 0.0;
+    inner_cross[n].offset = (-1);
   }
 
+  xsection_pool_init (0);     //empty the pool which holds the x-section points
+  jump_list_init (&bbu_jumps, "bbu_jumps");   //and the lists of Macro Atom jumps
+  jump_list_init (&bbd_jumps, "bbd_jumps");
+  jump_list_init (&bfu_jumps, "bfu_jumps");
+  jump_list_init (&bfd_jumps, "bfd_jumps");
+
 
-  for (i = 0; i < NLEVELS; i++)
+  for (i = 0; i <= atomic_max.nlevels; i++)
   {
     xconfig[i].n_bbu_jump = 0;  // initialising the number of jumps from each level to 0. (SS)
     xconfig[i].n_bbd_jump = 0;
@@ -271,7 +239,7 @@ init_atomic_data ()
     xconfig[i].nauger = 0;
   }
 
-  for (n = 0; n < NLINES; n++)
+  for (n = 0; n <= atomic_max.nlines; n++)
   {
     line[n].freq = -1;
     line[n].f = -1;
@@ -282,7 +250,7 @@ init_atomic_data ()
     line[n].coll_index = -999;
   }
 
-  for (n = 0; n < NAUGER_MACRO; n++)
+  for (n = 0; n <= atomic_max.nauger_macro; n++)
   {
     auger_macro[n].z = -1;
     auger_macro[n].nion = -1;
@@ -377,7 +345,7 @@ init_atomic_data ()
 
 
 /* The following lines initialise the collision strengths */
-  for (n = 0; n < NLINES; n++)
+  for (n = 0; n <= atomic_max.ncoll_stren; n++)
   {
     coll_stren[n].n = -1;       //Internal index
     coll_stren[n].lower = -1;   //The lower energy level - this is in Chianti notation and is currently unused
@@ -393,6 +361,8 @@ init_atomic_data ()
       coll_stren[n].sct[n1] = 0.0;      //The scaled temperature points in the fit
       coll_stren[n].scups[n1] = 0.0;
     }
+    coll_stren[n].n_table = 0;  //There is no table of upsilon until build_upsilon_tables is called
+    coll_stren[n].table_offset = -1;
   }
 
 
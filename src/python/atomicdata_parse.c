@@ -0,0 +1,600 @@
+
+/***********************************************************/
+/** @file  atomicdata_parse.c
+ *
+ * @brief  Routines which read the atomic data files and break
+ * them into records before they are used by get_atomic_data
+ *
+ * The files named in the masterfile are independent of one
+ * another on disk, so they are read and parsed here in parallel,
+ * using one thread per file.  Nothing in this file changes the
+ * atomic data structures themselves; that is left to
+ * get_atomic_data, which applies the records in masterfile order.
+ *
+ ***********************************************************/
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "atomic.h"
+#include "log.h"
+// If routines are added cproto > atomic_proto.h should be run
+#include "atomic_proto.h"
+
+#ifdef LINELENGTH
+#undef LINELENGTH
+#endif
+#define LINELENGTH 500
+#define WORD_FORMAT "%499s"     /* Limits the length of a word read into a LINELENGTH buffer */
+
+
+
+/**********************************************************/
+/**
+ * @brief      Determine the type of an atomic data record from its keyword
+ *
+ * @param [in] char *word   The first word of the record
+ * @return     A single character which identifies the type of record
+ *
+ * @details
+ *
+ * The characters returned are those used in the switch statement
+ * in get_atomic_data.  A blank line, or one which begins with
+ * !, #, - or Dtype is treated as a comment, 'c'.  A record which begins
+ * with * is a continuation of the previous record type, and '*' is
+ * returned so that the caller can retain the previous type.  Anything
+ * which cannot be identified is returned as 'z'.
+ *
+ **********************************************************/
+
+char
+atomic_record_type (word)
+     char *word;
+{
+  char choice;
+
+  if (strlen (word) == 0)
+    choice = 'c';               /*A blank line, treated like a comment */
+  else if (strncmp (word, "!", 1) == 0)
+    choice = 'c';               /* ! are also treated as  a comment */
+  else if (strncmp (word, "#", 1) == 0)
+    choice = 'c';               /* # is treated as  a comment */
+  else if (strncmp (word, "-", 1) == 0)
+    choice = 'c';               /* # is treated as  a comment */
+  else if (strncmp (word, "Dtype", 5) == 0)
+    choice = 'c';               /* # is treated as  a comment */
+  else if (strncmp (word, "CSTREN", 6) == 0)
+    choice = 'C';               /* It's a collision strength line */
+  else if (strncmp (word, "Element", 5) == 0)
+    choice = 'e';               /* an element */
+  else if (strncmp (word, "Ion", 3) == 0)
+    choice = 'i';               /* An ion */
+  else if (strncmp (word, "LevTop", 6) == 0)
+    choice = 'N';               /* A Level in TopBase format */
+  else if (strncmp (word, "LevMacro", 8) == 0)
+    choice = 'N';               /* A level for a Macro Atom */
+  else if (strncmp (word, "Level", 3) == 0)
+    choice = 'n';               /* A level for a simple ion */
+  else if (strncmp (word, "Phot", 4) == 0)
+    choice = 'w';               /* A record for starting a photionization x-section. Atom Phots are a subset of these */
+  else if (strncmp (word, "Line", 4) == 0)
+    choice = 'r';               /* A simple atom line */
+  else if (strncmp (word, "LinMacro", 8) == 0)
+    choice = 'r';               /* A line for a Macro Atom */
+  else if (strncmp (word, "AugMacro", 7) == 0)
+    choice = 'a';               /* An Auger record for a Macro Atom */
+  else if (strncmp (word, "Frac", 4) == 0)
+    choice = 'f';               /*ground state fractions */
+  else if (strncmp (word, "InnerVYS", 8) == 0)
+    choice = 'I';               /*a set of inner shell photoionization cross sections */
+  else if (strncmp (word, "DR_BADNL", 8) == 0)
+    choice = 'D';               /* a Badnell type dielectronic recombination file */
+  else if (strncmp (word, "DR_SHULL", 8) == 0)
+    choice = 'S';               /* A Shull-type  dielectronic recombination */
+  else if (strncmp (word, "RR_BADNL", 8) == 0)
+    choice = 'T';               /*Its a Badnell type line in the total RR file */
+  else if (strncmp (word, "DI_DERE", 7) == 0)
+    choice = 'd';               /*Its a data file giving direct ionization rates from Dere (2007) */
+  else if (strncmp (word, "RR_SHULL", 8) == 0)
+    choice = 's';               /*Its a Shull type line in the total RR file */
+  else if (strncmp (word, "BAD_GS_RR", 9) == 0)
+    choice = 'G';               /*Its a Badnell resolved ground state RR file */
+  else if (strncmp (word, "FF_GAUNT", 8) == 0)
+    choice = 'g';
+  /*Its a data file giving the temperature averaged gaunt factors from Sutherland (1998) */
+  else if (strncmp (word, "Kelecyield", 10) == 0)
+    choice = 'K';               /*Electron yield from inner shell ionization fro Kaastra and Mewe */
+  else if (strncmp (word, "ChEx", 4) == 0)
+    choice = 'X';               /*Charge exchange */
+//  else if (strncmp (word, "Kphotyield", 10) == 0)
+//    choice = 'F';           /*Floruescent photon yield from IS ionization from Kaastra and Mewe */
+  else if (strncmp (word, "*", 1) == 0)
+    choice = '*';               /* It's a continuation so record type remains same */
+  else
+    choice = 'z';               /* Who knows what it is */
+
+  return (choice);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Parse a line record, either a LinMacro record or one of the simple Line formats
+ *
+ * @param [in] char *aline   The record
+ * @param [in] char *word   The first word of the record
+ * @param [out] Line_record *lrec   The parsed values
+ * @return     The number of fields which were read
+ *
+ * @details
+ *
+ * The checks on the number of fields, and the conversion of the
+ * values read, are carried out when the record is used in get_atomic_data.
+ * Fields which were not read are returned as zero.
+ *
+ **********************************************************/
+
+int
+parse_line_record (aline, word, lrec)
+     char *aline;
+     char *word;
+     Line_record *lrec;
+{
+  memset (lrec, 0, sizeof (Line_record));
+
+  if (strncmp (word, "LinMacro", 8) == 0)
+  {
+    lrec->nwords = sscanf (aline, "%*s %d %d %le %le %le %le %le %le %d %d", &lrec->z, &lrec->istate, &lrec->wave, &lrec->f,
+                           &lrec->gl, &lrec->gu, &lrec->el, &lrec->eu, &lrec->levl, &lrec->levu);
+  }
+  else
+  {
+    lrec->nwords = sscanf (aline, "%*s %d %2d %le %le %le %le %le %le %d %d", &lrec->z, &lrec->istate, &lrec->wave, &lrec->f,
+                           &lrec->gl, &lrec->gu, &lrec->el, &lrec->eu, &lrec->levl, &lrec->levu);
+  }
+
+  return (lrec->nwords);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add space for one more record, line or x-section point to a parsed file
+ *
+ * @param [in, out] void **array   The array to be extended
+ * @param [in, out] int *nmax   The current size of the array
+ * @param [in] int n   The number of elements that are in use
+ * @param [in] size_t size   The size of an element of the array
+ * @return     0 if there is room for element n, 1 if memory could not be allocated
+ *
+ **********************************************************/
+
+static int
+grow_parse_array (void **array, int *nmax, int n, size_t size)
+{
+  void *new_array;
+  int new_max;
+
+  if (n < *nmax)
+    return (0);
+
+  new_max = (*nmax > 0) ? 2 * (*nmax) : 1024;
+  if ((new_array = realloc (*array, new_max * size)) == NULL)
+    return (1);
+
+  *array = new_array;
+  *nmax = new_max;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Read one of the atomic data files and break it into records
+ *
+ * @param [in, out] Atomic_data_file *dfile   The file to parse, with the name already set
+ * @return     The status of the file, 0 if it was parsed
+ *
+ * @details
+ *
+ * Each line of the file which would have been read by the main loop in
+ * get_atomic_data becomes a record.  The lines which follow some
+ * records are attached to the record they belong to:
+ *
+ * * the x-section points of PhotMacS, PhotTopS, PhotVfkyS and InnerVYS
+ *   records are parsed into the xe and xx arrays of the file
+ * * the branching ratios which follow an AugMacro record, and the SCT
+ *   and SCUPS lines which follow a CSTREN record, are kept as extra lines
+ *
+ * Line records are also parsed here, since there are many of them.
+ *
+ * ### Notes ###
+ *
+ * The line numbers which are stored with each record are those which
+ * get_atomic_data has always reported, so that messages do not change.
+ *
+ * Since this routine may be run in several threads at once, it
+ * must not write any messages. Any problem is recorded in the status
+ * of the file, and the records are checked as they are applied.
+ *
+ **********************************************************/
+
+int
+parse_atomic_file (dfile)
+     Atomic_data_file *dfile;
+{
+  char *aline, *xline;
+  char word[LINELENGTH];
+  char choice;
+  int lineno;
+  int n, np, nmax;
+  Atomic_record *rec;
+
+  dfile->record = NULL;
+  dfile->lines = NULL;
+  dfile->xe = dfile->xx = NULL;
+  dfile->nrecords = dfile->nrecords_max = 0;
+  dfile->nline_records = dfile->nline_records_max = 0;
+  dfile->npoints = dfile->npoints_max = 0;
+
+  if (atomic_file_open (dfile->name, &dfile->contents))
+  {
+    dfile->status = 1;
+    return (dfile->status);
+  }
+
+  dfile->status = 0;
+  choice = '?';                 /* A continuation at the start of the file cannot be resolved here */
+  lineno = 1;
+
+  while (atomic_file_next_line (&dfile->contents, &aline))
+  {
+    lineno++;
+
+    if (grow_parse_array ((void **) &dfile->record, &dfile->nrecords_max, dfile->nrecords, sizeof (Atomic_record)))
+    {
+      dfile->status = 2;
+      return (dfile->status);
+    }
+
+    rec = &dfile->record[dfile->nrecords++];
+
+    strcpy (word, "");
+    sscanf (aline, WORD_FORMAT, word);
+
+    rec->line = aline;
+    rec->extra[0] = rec->extra[1] = NULL;
+    rec->nextra = 0;
+    rec->lineno = lineno;
+    rec->choice = atomic_record_type (word);
+    rec->np = 0;
+    rec->index = -1;
+
+    if (rec->choice != '*')
+      choice = rec->choice;
+    rec->type = choice;
+
+    switch (choice)
+    {
+    case 'w':
+      if (strncmp (word, "PhotMacS", 8) != 0 && strncmp (word, "PhotTopS", 8) != 0 && strncmp (word, "PhotVfkyS", 8) != 0)
+        break;
+      /* Otherwise fall through, since the x-sections are read in the same way as those for inner shells */
+    case 'I':
+      if (sscanf (aline, "%*s %*d %*d %*d %*d %*e %d", &np) != 1)
+        np = 0;
+
+      rec->index = dfile->npoints;
+      for (n = 0; n < np && atomic_file_next_line (&dfile->contents, &xline); n++)
+      {
+        nmax = dfile->npoints_max;    /* xe and xx are always the same size */
+        if (grow_parse_array ((void **) &dfile->xe, &dfile->npoints_max, dfile->npoints, sizeof (double))
+            || grow_parse_array ((void **) &dfile->xx, &nmax, dfile->npoints, sizeof (double)))
+        {
+          dfile->status = 2;
+          return (dfile->status);
+        }
+
+        dfile->xe[dfile->npoints] = dfile->xx[dfile->npoints] = 0.0;
+        sscanf (xline, "%*s %le %le", &dfile->xe[dfile->npoints], &dfile->xx[dfile->npoints]);
+        dfile->npoints++;
+      }
+      rec->np = n;
+      lineno += n;
+      break;
+
+    case 'a':
+      if (atomic_file_next_line (&dfile->contents, &rec->extra[0]))
+        rec->nextra = 1;
+      break;
+
+    case 'C':
+      lineno += 2;
+      for (n = 0; n < 2 && atomic_file_next_line (&dfile->contents, &rec->extra[n]); n++)
+        rec->nextra++;
+      break;
+
+    case 'r':
+      if (grow_parse_array ((void **) &dfile->lines, &dfile->nline_records_max, dfile->nline_records, sizeof (Line_record)))
+      {
+        dfile->status = 2;
+        return (dfile->status);
+      }
+      rec->index = dfile->nline_records++;
+      parse_line_record (aline, word, &dfile->lines[rec->index]);
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  return (dfile->status);
+}
+
+
+
+/* The list of files which remain to be parsed, shared between the threads */
+
+struct parse_queue
+{
+  Atomic_data_file *dfiles;
+  int nfiles;
+  int next;
+  pthread_mutex_t lock;
+};
+
+
+
+/**********************************************************/
+/**
+ * @brief      Parse files from the queue until there are none left
+ *
+ * @param [in] void *arg   The queue of files
+ * @return     NULL
+ *
+ **********************************************************/
+
+static void *
+parse_atomic_files_worker (void *arg)
+{
+  struct parse_queue *queue = arg;
+  int n;
+
+  while (1)
+  {
+    pthread_mutex_lock (&queue->lock);
+    n = queue->next++;
+    pthread_mutex_unlock (&queue->lock);
+
+    if (n >= queue->nfiles)
+      break;
+
+    Trace_begin ("parse_atomic_file");
+    parse_atomic_file (&queue->dfiles[n]);
+    Trace_end ("parse_atomic_file");
+  }
+
+  return (NULL);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      The number of threads with which to read and sort the atomic data
+ *
+ * @return     The number of threads, at least 1
+ *
+ * @details
+ *
+ * This is atomicdata_nthreads if it is set.  Otherwise the processors
+ * which are online are divided between the processes on this node
+ * which read the data, which shared_init counts in
+ * atomicdata_node_readers.  If that is not known and MPI_COMM_WORLD has
+ * more than one process, every process may be reading its own copy, so
+ * only one thread is used rather than starting as many threads in each
+ * process as the node has processors.
+ *
+ **********************************************************/
+
+int
+atomicdata_thread_count ()
+{
+  int nthreads, mpi_on, mpi_done, n_mpi;
+
+  if (atomicdata_nthreads > 0)
+    return (atomicdata_nthreads);
+
+  nthreads = sysconf (_SC_NPROCESSORS_ONLN);
+  if (atomicdata_node_readers > 0)
+  {
+    nthreads /= atomicdata_node_readers;
+  }
+  else
+  {
+    MPI_Initialized (&mpi_on);
+    MPI_Finalized (&mpi_done);
+    if (mpi_on && !mpi_done)
+    {
+      MPI_Comm_size (MPI_COMM_WORLD, &n_mpi);
+      if (n_mpi > 1)
+        nthreads = 1;
+    }
+  }
+
+  return (nthreads < 1 ? 1 : nthreads);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Read and parse all of the atomic data files in parallel
+ *
+ * @param [in, out] Atomic_data_file dfiles[]   The files to parse, with the names set
+ * @param [in] int nfiles   The number of files
+ * @return     The number of threads which were used
+ *
+ * @details
+ *
+ * The number of threads is given by atomicdata_thread_count, but is
+ * never more than the number of files.  The calling thread parses files
+ * too, so if no threads can be started all of the files are still
+ * parsed.
+ *
+ **********************************************************/
+
+int
+parse_atomic_files (dfiles, nfiles)
+     Atomic_data_file dfiles[];
+     int nfiles;
+{
+  struct parse_queue queue;
+  pthread_t *threads;
+  int nthreads, nstarted;
+  int n;
+
+  nthreads = atomicdata_thread_count ();
+  if (nthreads > nfiles)
+    nthreads = nfiles;
+  if (nthreads < 1)
+    nthreads = 1;
+
+  queue.dfiles = dfiles;
+  queue.nfiles = nfiles;
+  queue.next = 0;
+  pthread_mutex_init (&queue.lock, NULL);
+
+  nstarted = 0;
+  if (nthreads > 1 && (threads = calloc (nthreads - 1, sizeof (pthread_t))) != NULL)
+  {
+    for (n = 0; n < nthreads - 1; n++)
+    {
+      if (pthread_create (&threads[n], NULL, parse_atomic_files_worker, &queue) != 0)
+        break;
+      nstarted++;
+    }
+
+    parse_atomic_files_worker (&queue);
+
+    for (n = 0; n < nstarted; n++)
+      pthread_join (threads[n], NULL);
+
+    free (threads);
+  }
+  else
+  {
+    parse_atomic_files_worker (&queue);
+  }
+
+  pthread_mutex_destroy (&queue.lock);
+
+  return (nstarted + 1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Release the memory used by a parsed atomic data file
+ *
+ * @param [in, out] Atomic_data_file *dfile   The file
+ *
+ **********************************************************/
+
+void
+free_atomic_data_file (dfile)
+     Atomic_data_file *dfile;
+{
+  atomic_file_close (&dfile->contents);
+  free (dfile->record);
+  free (dfile->lines);
+  free (dfile->xe);
+  free (dfile->xx);
+  free (dfile->name);
+  dfile->record = NULL;
+  dfile->lines = NULL;
+  dfile->xe = dfile->xx = NULL;
+  dfile->name = NULL;
+  dfile->nrecords = dfile->nline_records = dfile->npoints = 0;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Count the records of each type in the parsed atomic data files
+ *
+ * @param [in] Atomic_data_file dfiles[]   The files, as parsed by parse_atomic_files
+ * @param [in] int nfiles   The number of files
+ * @param [out] Atomic_sizes *sizes   The number of records which can add an entry to each table
+ * @return     The total number of records which were counted
+ *
+ * @details
+ * Each record adds at most one entry to the table it belongs to, so
+ * the counts are the sizes with which the tables are allocated by
+ * init_atomic_data.  Continuation records are counted as records of
+ * the type which they continue.
+ *
+ **********************************************************/
+
+int
+count_atomic_records (dfiles, nfiles, sizes)
+     Atomic_data_file dfiles[];
+     int nfiles;
+     Atomic_sizes *sizes;
+{
+  int ifile, irec, ntotal;
+
+  memset (sizes, 0, sizeof (Atomic_sizes));
+  ntotal = 0;
+
+  for (ifile = 0; ifile < nfiles; ifile++)
+  {
+    for (irec = 0; irec < dfiles[ifile].nrecords; irec++)
+    {
+      switch (dfiles[ifile].record[irec].type)
+      {
+      case 'e':
+        sizes->nelements++;
+        break;
+      case 'i':
+        sizes->nions++;
+        break;
+      case 'N':
+      case 'n':
+        sizes->nlevels++;
+        break;
+      case 'r':
+        sizes->nlines++;
+        break;
+      case 'w':
+        sizes->nphot++;
+        break;
+      case 'I':
+        sizes->ninner++;
+        break;
+      case 'a':
+        sizes->nauger_macro++;
+        break;
+      case 'C':
+        sizes->ncoll_stren++;
+        break;
+      default:
+        continue;
+      }
+      ntotal++;
+    }
+  }
+
+  return (ntotal);
+}
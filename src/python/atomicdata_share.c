@@ -0,0 +1,397 @@
+
+/***********************************************************/
+/** @file  atomicdata_share.c
+ *
+ * @brief  Share the atomic data between the MPI processes on a node
+ *
+ * When the tables are shared, see shared_alloc.c, only the loader on
+ * each node calls get_atomic_data, along with build_upsilon_tables and
+ * build_rate_tables if the tables of upsilon and rates are wanted.  Then
+ * every process calls share_atomic_data, after which the atomic data can
+ * be used in all of them, exactly as if each had read it.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atomic.h"
+#include "log.h"
+// If routines are added cproto > atomic_proto.h should be run
+#include "atomic_proto.h"
+
+#define FINGERPRINT_LINELENGTH 500
+#define FINGERPRINT_WORD_FORMAT "%499s"
+
+
+/* Everything in atomic.h which get_atomic_data sets, other than the
+   tables, which the loader shares as one more table, so that it can be
+   found in the same way with every mode of sharing.  The pointers in the
+   structures are replaced by shared_lookup. */
+
+typedef struct atomic_scalars
+{
+  int nelements, nions, nlevels, nlte_levels, nlevels_macro, nlines, nlines_macro, n_inner_tot;
+  int nauger, nauger_macro, n_coll_stren, nxphot, ntop_phot, nphot_total;
+  int ndrecomb, n_total_rr, n_bad_gs_rr, n_dere_di_rate, gaunt_n_gsqrd, n_charge_exchange;
+  double rho2nh, phot_freq_min, inner_freq_min;
+  Atomic_sizes atomic_max;
+  Jump_list bbu_jumps, bbd_jumps, bfu_jumps, bfd_jumps;
+  Line_view line_view;
+  Xsection_pool xsection_pool;
+  Upsilon_pool upsilon_pool;
+  Rate_tables rate_tables;
+} Atomic_scalars;
+
+
+
+/**********************************************************/
+/**
+ * @brief      Point a list of Macro Atom jumps at its shared tables
+ *
+ **********************************************************/
+
+static void
+share_jump_list (Jump_list *list, Jump_list *loaded)
+{
+  char name[32];
+
+  *list = *loaded;
+  snprintf (name, sizeof (name), "%s_offset", list->name);
+  list->offset = shared_lookup (name);
+  snprintf (name, sizeof (name), "%s_jump", list->name);
+  list->jump = shared_lookup (name);
+  list->pair_config = list->pair_jump = NULL;
+  list->npairs = list->npairs_max = 0;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Make the atomic data read by the loader available to every process on the node
+ *
+ * @return     The number of tables which were shared
+ *
+ * @details
+ * This is collective over the processes on the node, and is called by
+ * all of them once the loader has read the data.  The tables are moved
+ * into shared memory, along with the number of records of each type,
+ * so that ele, ion, line and so on point to the same memory in every
+ * process.  With SHARED_BCAST the loader is rank 0, which sends the
+ * tables to every node, and this is collective over all of the
+ * processes.  With SHARED_POSIX each process calls this by itself, and
+ * the loader is the first to use the segment.  Nothing is done if the
+ * tables are private.
+ *
+ * ### Notes ###
+ *
+ * Once the data is shared it must not be changed, so get_atomic_data,
+ * build_upsilon_tables and build_rate_tables cannot be called again.
+ *
+ **********************************************************/
+
+int
+share_atomic_data ()
+{
+  Atomic_scalars scalars, *shared_scalars;
+  char name[32];
+  int ntables, type;
+
+  if (shared_get_mode () == SHARED_PRIVATE)
+    return (0);
+
+  Trace_begin ("share_atomic_data");
+
+  if (shared_loader ())
+  {
+    if ((shared_scalars = shared_calloc ("atomic_scalars", 1, sizeof (Atomic_scalars))) == NULL)
+    {
+      Error ("share_atomic_data: Could not allocate memory for the sizes of the tables\n");
+      Exit (0);
+    }
+    scalars.nelements = nelements;
+    scalars.nions = nions;
+    scalars.nlevels = nlevels;
+    scalars.nlte_levels = nlte_levels;
+    scalars.nlevels_macro = nlevels_macro;
+    scalars.nlines = nlines;
+    scalars.nlines_macro = nlines_macro;
+    scalars.n_inner_tot = n_inner_tot;
+    scalars.nauger = nauger;
+    scalars.nauger_macro = nauger_macro;
+    scalars.n_coll_stren = n_coll_stren;
+    scalars.nxphot = nxphot;
+    scalars.ntop_phot = ntop_phot;
+    scalars.nphot_total = nphot_total;
+    scalars.ndrecomb = ndrecomb;
+    scalars.n_total_rr = n_total_rr;
+    scalars.n_bad_gs_rr = n_bad_gs_rr;
+    scalars.n_dere_di_rate = n_dere_di_rate;
+    scalars.gaunt_n_gsqrd = gaunt_n_gsqrd;
+    scalars.n_charge_exchange = n_charge_exchange;
+    scalars.rho2nh = rho2nh;
+    scalars.phot_freq_min = phot_freq_min;
+    scalars.inner_freq_min = inner_freq_min;
+    scalars.atomic_max = atomic_max;
+    scalars.bbu_jumps = bbu_jumps;
+    scalars.bbd_jumps = bbd_jumps;
+    scalars.bfu_jumps = bfu_jumps;
+    scalars.bfd_jumps = bfd_jumps;
+    scalars.line_view = line_view;
+    scalars.xsection_pool = xsection_pool;
+    scalars.upsilon_pool = upsilon_pool;
+    scalars.rate_tables = rate_tables;
+    *shared_scalars = scalars;
+  }
+
+  ntables = shared_publish ();
+  if ((shared_scalars = shared_lookup ("atomic_scalars")) == NULL)
+  {
+    Error ("share_atomic_data: The sizes of the tables were not shared\n");
+    Exit (0);
+  }
+  scalars = *shared_scalars;
+
+  nelements = scalars.nelements;
+  nions = scalars.nions;
+  nlevels = scalars.nlevels;
+  nlte_levels = scalars.nlte_levels;
+  nlevels_macro = scalars.nlevels_macro;
+  nlines = scalars.nlines;
+  nlines_macro = scalars.nlines_macro;
+  n_inner_tot = scalars.n_inner_tot;
+  nauger = scalars.nauger;
+  nauger_macro = scalars.nauger_macro;
+  n_coll_stren = scalars.n_coll_stren;
+  nxphot = scalars.nxphot;
+  ntop_phot = scalars.ntop_phot;
+  nphot_total = scalars.nphot_total;
+  ndrecomb = scalars.ndrecomb;
+  n_total_rr = scalars.n_total_rr;
+  n_bad_gs_rr = scalars.n_bad_gs_rr;
+  n_dere_di_rate = scalars.n_dere_di_rate;
+  gaunt_n_gsqrd = scalars.gaunt_n_gsqrd;
+  n_charge_exchange = scalars.n_charge_exchange;
+  rho2nh = scalars.rho2nh;
+  phot_freq_min = scalars.phot_freq_min;
+  inner_freq_min = scalars.inner_freq_min;
+  atomic_max = scalars.atomic_max;
+
+  /* Every process, including the loader, now finds the tables in shared memory */
+
+  ele = shared_lookup ("elements");
+  ion = shared_lookup ("ions");
+  xconfig = shared_lookup ("config");
+  line = shared_lookup ("line");
+  lin_idx = shared_lookup ("lin_idx");
+  coll_stren = shared_lookup ("coll_stren");
+  phot_top = shared_lookup ("phot_top");
+  phot_top_idx = shared_lookup ("phot_top_idx");
+  inner_cross = shared_lookup ("inner_cross");
+  inner_cross_idx = shared_lookup ("inner_cross_idx");
+  inner_elec_yield = shared_lookup ("elec_yield");
+  inner_fluor_yield = shared_lookup ("fluor_yield");
+  auger_macro = shared_lookup ("auger_macro");
+  ground_frac = shared_lookup ("ground_frac");
+  drecomb = shared_lookup ("drecomb");
+  total_rr = shared_lookup ("total_rr");
+  bad_gs_rr = shared_lookup ("bad_gs_rr");
+  dere_di_rate = shared_lookup ("dere_di_rate");
+  gaunt_total = shared_lookup ("gaunt_total");
+  charge_exchange = shared_lookup ("charge_exchange");
+
+  share_jump_list (&bbu_jumps, &scalars.bbu_jumps);
+  share_jump_list (&bbd_jumps, &scalars.bbd_jumps);
+  share_jump_list (&bfu_jumps, &scalars.bfu_jumps);
+  share_jump_list (&bfd_jumps, &scalars.bfd_jumps);
+
+  line_view = scalars.line_view;
+  line_view.freq = shared_lookup ("line_view_freq");
+  line_view.f = shared_lookup ("line_view_f");
+  line_view.gl = shared_lookup ("line_view_gl");
+  line_view.gu = shared_lookup ("line_view_gu");
+  line_view.nion = shared_lookup ("line_view_nion");
+  line_view.bucket = shared_lookup ("line_view_bucket");
+
+  xsection_pool = scalars.xsection_pool;
+  xsection_pool.freq = shared_lookup ("xsection_freq");
+  xsection_pool.log_freq = shared_lookup ("xsection_log_freq");
+  xsection_pool.x = shared_lookup ("xsection_x");
+  xsection_pool.log_x = shared_lookup ("xsection_log_x");
+
+  upsilon_pool = scalars.upsilon_pool;
+  upsilon_pool.upsilon = shared_lookup ("upsilon_pool");
+
+  rate_tables = scalars.rate_tables;
+  for (type = 0; type < NRATE_TYPES; type++)
+  {
+    snprintf (name, sizeof (name), "rate_table_%d", type);
+    rate_tables.rate[type] = shared_lookup (name);
+  }
+
+  if (shared_get_mode () == SHARED_POSIX)
+    Log ("share_atomic_data: %d tables are shared through POSIX shared memory\n", ntables);
+  else
+    Log ("share_atomic_data: %d tables are shared by %d processes\n", ntables, shared_nprocs ());
+  Trace_end ("share_atomic_data");
+
+  return (ntables);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Free the atomic data, so that it can be read again
+ *
+ * @return     The number of tables which were freed
+ *
+ * @details
+ * This is collective over the processes which share the tables, if they
+ * are shared.  All of the tables are freed with shared_release, and the
+ * pointers to them set to NULL, so that get_atomic_data does not try to
+ * free them again.  It is used to read the same data with a different
+ * mode of shared_init.
+ *
+ **********************************************************/
+
+int
+release_atomic_data ()
+{
+  int nfreed;
+
+  nfreed = shared_release ();
+
+  ele = NULL;
+  ion = NULL;
+  xconfig = NULL;
+  line = NULL;
+  lin_idx = NULL;
+  coll_stren = NULL;
+  phot_top = NULL;
+  phot_top_idx = NULL;
+  inner_cross = NULL;
+  inner_cross_idx = NULL;
+  inner_elec_yield = NULL;
+  inner_fluor_yield = NULL;
+  auger_macro = NULL;
+  ground_frac = NULL;
+  drecomb = NULL;
+  total_rr = NULL;
+  bad_gs_rr = NULL;
+  dere_di_rate = NULL;
+  gaunt_total = NULL;
+  charge_exchange = NULL;
+
+  bbu_jumps.offset = bbu_jumps.jump = NULL;
+  bbd_jumps.offset = bbd_jumps.jump = NULL;
+  bfu_jumps.offset = bfu_jumps.jump = NULL;
+  bfd_jumps.offset = bfd_jumps.jump = NULL;
+
+  memset (&line_view, 0, sizeof (line_view));
+  memset (&xsection_pool, 0, sizeof (xsection_pool));
+  memset (&upsilon_pool, 0, sizeof (upsilon_pool));
+  memset (&rate_tables, 0, sizeof (rate_tables));
+
+  nelements = nions = nlevels = nlines = 0;
+
+  return (nfreed);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add some bytes to a 64 bit FNV-1a hash
+ *
+ **********************************************************/
+
+static unsigned long long
+fingerprint_add (unsigned long long hash, const void *buf, size_t size)
+{
+  const unsigned char *byte = buf;
+  size_t n;
+
+  for (n = 0; n < size; n++)
+  {
+    hash ^= byte[n];
+    hash *= 1099511628211ULL;
+  }
+
+  return (hash);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Make a key which identifies the atomic data read from a masterfile
+ *
+ * @param [in] char *  masterfile   The masterfile which would be given to get_atomic_data
+ * @param [out] char *  key   The key, the name of a POSIX shared memory segment
+ * @param [in] int  size   The space for the key
+ * @return     1 if the key was made, 0 if the masterfile could not be read
+ *
+ * @details
+ * The key is a hash of the masterfile, of every file named in it and of
+ * the sizes of the structures the data is read into, so that processes
+ * which read the same data with the same program get the same key, to
+ * give to shared_init_posix.  If any file changes, or the program is
+ * built with a different layout of the tables, the key changes too.
+ *
+ * ### Notes ###
+ *
+ * The tables of upsilons and of rates are not part of the key, so the
+ * processes which use one must all build them, or none of them.
+ *
+ **********************************************************/
+
+int
+atomic_data_fingerprint (masterfile, key, size)
+     char *masterfile;
+     char *key;
+     int size;
+{
+  Atomic_file master_file, data_file;
+  char *aline, file[FINGERPRINT_LINELENGTH];
+  unsigned long long hash;
+  size_t sizes[6];
+
+  if (atomic_file_open (masterfile, &master_file))
+  {
+    Error ("atomic_data_fingerprint: Could not read masterfile %s\n", masterfile);
+    return (0);
+  }
+
+  sizes[0] = sizeof (ele_dummy);
+  sizes[1] = sizeof (ion_dummy);
+  sizes[2] = sizeof (config_dummy);
+  sizes[3] = sizeof (line_dummy);
+  sizes[4] = sizeof (Topbase_phot);
+  sizes[5] = sizeof (Atomic_scalars);
+
+  hash = fingerprint_add (14695981039346656037ULL, sizes, sizeof (sizes));
+  hash = fingerprint_add (hash, master_file.buf, master_file.end - master_file.buf);
+
+  while (atomic_file_next_line (&master_file, &aline))
+  {
+    if (sscanf (aline, FINGERPRINT_WORD_FORMAT, file) == 1 && file[0] != '#')
+    {
+      if (atomic_file_open (file, &data_file))
+      {
+        Error ("atomic_data_fingerprint: Could not read %s\n", file);
+        continue;
+      }
+      hash = fingerprint_add (hash, data_file.buf, data_file.end - data_file.buf);
+      atomic_file_close (&data_file);
+    }
+  }
+
+  atomic_file_close (&master_file);
+
+  snprintf (key, size, "/python_atomic_%016llx", hash);
+
+  return (1);
+}
@@ -0,0 +1,309 @@
+
+/***********************************************************/
+/** @file  atomicdata_sort.c
+ *
+ * @brief  Sort the atomic data into frequency order
+ *
+ * The lines, and the photoionization and inner shell x-sections,
+ * are accessed in frequency order through lin_idx, phot_top_idx
+ * and inner_cross_idx.  The routine here finds that order using
+ * the full double precision frequencies.  Entries with the same
+ * frequency are kept in the order in which they were read, so the
+ * result does not depend on the number of threads used.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "atomic.h"
+#include "log.h"
+// If routines are added cproto > atomic_proto.h should be run
+#include "atomic_proto.h"
+
+#define MIN_SORT_CHUNK 16384    /* The smallest number of entries worth giving to a thread */
+#define INSERTION_RUN 16        /* The length of the runs which are sorted before merging */
+
+/* A key and the position of the entry it belongs to, which breaks ties between equal keys */
+
+struct sort_key
+{
+  double key;
+  int index;
+};
+
+/* The work given to one thread: either sort a[lo, hi) or merge the sorted a[lo, mid) and a[mid, hi) */
+
+struct sort_task
+{
+  struct sort_key *a, *tmp;
+  int lo, mid, hi;
+};
+
+
+
+/**********************************************************/
+/**
+ * @brief      Whether one key comes before another
+ *
+ **********************************************************/
+
+static int
+sort_key_before (const struct sort_key *a, const struct sort_key *b)
+{
+  return (a->key < b->key || (a->key == b->key && a->index < b->index));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Merge the sorted runs src[lo, mid) and src[mid, hi) into dst[lo, hi)
+ *
+ **********************************************************/
+
+static void
+merge_sort_keys (const struct sort_key *src, struct sort_key *dst, int lo, int mid, int hi)
+{
+  int i, j, k;
+
+  i = lo;
+  j = mid;
+  for (k = lo; k < hi; k++)
+  {
+    if (i < mid && (j >= hi || !sort_key_before (&src[j], &src[i])))
+      dst[k] = src[i++];
+    else
+      dst[k] = src[j++];
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Sort a[lo, hi) using tmp[lo, hi) as workspace
+ *
+ * @details
+ * Short runs are sorted by insertion, and then merged bottom up,
+ * alternating between a and tmp.  The result is left in a.
+ *
+ **********************************************************/
+
+static void
+sort_keys (struct sort_key *a, struct sort_key *tmp, int lo, int hi)
+{
+  struct sort_key *src, *dst, *swap, x;
+  int i, j, width, start;
+
+  for (start = lo; start < hi; start += INSERTION_RUN)
+  {
+    for (i = start + 1; i < start + INSERTION_RUN && i < hi; i++)
+    {
+      x = a[i];
+      for (j = i; j > start && sort_key_before (&x, &a[j - 1]); j--)
+        a[j] = a[j - 1];
+      a[j] = x;
+    }
+  }
+
+  src = a;
+  dst = tmp;
+  for (width = INSERTION_RUN; width < hi - lo; width *= 2)
+  {
+    for (start = lo; start < hi; start += 2 * width)
+    {
+      if (start + width >= hi)
+        memcpy (&dst[start], &src[start], (hi - start) * sizeof (struct sort_key));
+      else
+        merge_sort_keys (src, dst, start, start + width, (start + 2 * width < hi) ? start + 2 * width : hi);
+    }
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  if (src != a)
+    memcpy (&a[lo], &src[lo], (hi - lo) * sizeof (struct sort_key));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Carry out one sort task, as the start routine of a thread
+ *
+ **********************************************************/
+
+static void *
+sort_task_worker (void *arg)
+{
+  struct sort_task *task = (struct sort_task *) arg;
+
+  if (task->mid < 0)
+  {
+    sort_keys (task->a, task->tmp, task->lo, task->hi);
+  }
+  else
+  {
+    merge_sort_keys (task->a, task->tmp, task->lo, task->mid, task->hi);
+    memcpy (&task->a[task->lo], &task->tmp[task->lo], (task->hi - task->lo) * sizeof (struct sort_key));
+  }
+
+  return (NULL);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Carry out a set of independent sort tasks, one per thread
+ *
+ * @details
+ * The calling thread does the last task itself, and any task for
+ * which a thread cannot be started.
+ *
+ **********************************************************/
+
+static void
+run_sort_tasks (struct sort_task *tasks, int ntasks)
+{
+  pthread_t *threads;
+  int *started;
+  int n;
+
+  threads = calloc (ntasks, sizeof (pthread_t));
+  started = calloc (ntasks, sizeof (int));
+
+  for (n = 0; n < ntasks - 1; n++)
+  {
+    if (threads != NULL && started != NULL && pthread_create (&threads[n], NULL, sort_task_worker, &tasks[n]) == 0)
+      started[n] = 1;
+    else
+      sort_task_worker (&tasks[n]);
+  }
+
+  sort_task_worker (&tasks[ntasks - 1]);
+
+  for (n = 0; n < ntasks - 1; n++)
+  {
+    if (started != NULL && started[n])
+      pthread_join (threads[n], NULL);
+  }
+
+  free (threads);
+  free (started);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the order of a set of entries by increasing value of a key
+ *
+ * @param [in] int n   The number of entries
+ * @param [in] double key[]   The key, usually the frequency, of each entry
+ * @param [out] int index[]   The entries in order, so that key[index[0]] is the smallest
+ * @return     The number of threads which were used
+ *
+ * @details
+ * Entries with equal keys are ordered by their position in key, so the
+ * order is fully determined by the keys.  The entries are divided between
+ * up to atomicdata_thread_count threads, each of which sorts its share,
+ * and the shares are then merged in pairs, again in parallel.  Small
+ * sets are sorted by the calling thread.
+ *
+ * ### Notes ###
+ * Unlike indexx, which this replaces for the atomic data, both
+ * arrays run from 0 to n-1.
+ *
+ **********************************************************/
+
+int
+index_by_key (n, key, index)
+     int n;
+     double key[];
+     int index[];
+{
+  struct sort_key *a, *tmp;
+  struct sort_task *tasks;
+  int nthreads, nchunks, width, ntasks;
+  int i;
+
+  if (n < 1)
+    return (0);
+
+  a = calloc (n, sizeof (struct sort_key));
+  tmp = calloc (n, sizeof (struct sort_key));
+  if (a == NULL || tmp == NULL)
+  {
+    Error ("index_by_key: Could not allocate memory to sort %d entries\n", n);
+    Exit (0);
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    a[i].key = key[i];
+    a[i].index = i;
+  }
+
+  nthreads = atomicdata_thread_count ();
+  if (nthreads > n / MIN_SORT_CHUNK)
+    nthreads = n / MIN_SORT_CHUNK;
+  if (nthreads < 1)
+    nthreads = 1;
+
+  if (nthreads == 1)
+  {
+    sort_keys (a, tmp, 0, n);
+  }
+  else
+  {
+    /* Sort nthreads chunks, and then merge neighbouring chunks until there is one */
+
+    nchunks = nthreads;
+    tasks = calloc (nchunks, sizeof (struct sort_task));
+    if (tasks == NULL)
+    {
+      Error ("index_by_key: Could not allocate memory to sort %d entries\n", n);
+      Exit (0);
+    }
+
+    for (i = 0; i < nchunks; i++)
+    {
+      tasks[i].a = a;
+      tasks[i].tmp = tmp;
+      tasks[i].lo = (int) ((long) n * i / nchunks);
+      tasks[i].hi = (int) ((long) n * (i + 1) / nchunks);
+      tasks[i].mid = -1;
+    }
+    run_sort_tasks (tasks, nchunks);
+
+    for (width = 1; width < nchunks; width *= 2)
+    {
+      ntasks = 0;
+      for (i = 0; i + width < nchunks; i += 2 * width)
+      {
+        tasks[ntasks].a = a;
+        tasks[ntasks].tmp = tmp;
+        tasks[ntasks].lo = (int) ((long) n * i / nchunks);
+        tasks[ntasks].mid = (int) ((long) n * (i + width) / nchunks);
+        tasks[ntasks].hi = (int) ((long) n * ((i + 2 * width < nchunks) ? i + 2 * width : nchunks) / nchunks);
+        ntasks++;
+      }
+      run_sort_tasks (tasks, ntasks);
+    }
+
+    free (tasks);
+  }
+
+  for (i = 0; i < n; i++)
+    index[i] = a[i].index;
+
+  free (a);
+  free (tmp);
+
+  return (nthreads);
+}
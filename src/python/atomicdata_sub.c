@@ -96,7 +96,7 @@ atomicdata2file ()
   for (n = 0; n < ntop_phot + nxphot; n++)
   {
     fprintf (fptr, "Phot n %5d z %2d istate %3d sigma %8.2e freq[0] %8.2e nlev %5d uplev %2d macro %2d  %2d %2d use %2d\n",
-             n, phot_top[n].z, phot_top[n].istate, phot_top[n].x[0], phot_top[n].freq[0],
+             n, phot_top[n].z, phot_top[n].istate, xsection_pool.x[phot_top[n].offset], xsection_pool.freq[phot_top[n].offset],
              phot_top[n].nlev, phot_top[n].uplev, phot_top[n].macro_info, phot_top[n].down_index, phot_top[n].up_index, phot_top[n].use);
   }
 
@@ -118,14 +118,15 @@ atomicdata2file ()
   for (n = 0; n < ntop_phot + nxphot; n++)
   {
     fprintf (fptr, "Photx n %5d z %2d istate %3d sigma %8.2e freq[0] %8.2e nlev %5d uplev %2d macro %2d  %2d %2d use %2d\n",
-             n, phot_top[n].z, phot_top[n].istate, phot_top[n].x[0], phot_top[n].freq[0],
+             n, phot_top[n].z, phot_top[n].istate, xsection_pool.x[phot_top[n].offset], xsection_pool.freq[phot_top[n].offset],
              phot_top[n].nlev, phot_top[n].uplev, phot_top[n].macro_info, phot_top[n].down_index, phot_top[n].up_index, phot_top[n].use);
 
-    int nn;
+    int nn, nx;
     for (nn = 0; nn < phot_top[n].np; nn++)
     {
-      fprintf (fptr, "Photz %4d %10.6e %10.6e %10.6f %10.6f\n", nn, phot_top[n].freq[nn], phot_top[n].x[nn], phot_top[n].log_freq[nn],
-               phot_top[n].log_x[nn]);
+      nx = phot_top[n].offset + nn;
+      fprintf (fptr, "Photz %4d %10.6e %10.6e %10.6f %10.6f\n", nn, xsection_pool.freq[nx], xsection_pool.x[nx], xsection_pool.log_freq[nx],
+               xsection_pool.log_x[nx]);
     }
 
 
@@ -147,54 +148,121 @@ atomicdata2file ()
  * @details
  *
  * ### Notes ###
- * All use a Numerical recipes routine indexx for this
+ * All use index_by_key for this, which sorts on the double precision
+ * frequencies; lines with the same frequency stay in the order they were read
  *
  **********************************************************/
 
 int
 index_lines ()
 {
-  float *freqs, foo;
-  int *index, ioo;
+  double *freqs;
   int n;
-  void indexx ();
 
   /* Allocate memory for some modestly large arrays */
-  freqs = calloc (sizeof (foo), NLINES + 2);
-  index = calloc (sizeof (ioo), NLINES + 2);
+  freqs = calloc (sizeof (double), nlines + 1);
 
-  freqs[0] = 0;
   for (n = 0; n < nlines; n++)
-    freqs[n + 1] = line[n].freq;        /* So filled matrix
-                                           elements run from 1 to nlines */
+    freqs[n] = line[n].freq;
 
-  indexx (nlines, freqs, index);        /* Note that this math recipes routine
-                                           expects arrays to run from 1 to nlines inclusive */
-
-  /* The for loop indices are complicated by the numerical recipes routine,
-     which is a simple translation of a fortran routine.
-     Specifically, index array elements 1 to nlines are now filled,
-     and the numbers run from 1 to nlines, but the
-     pointer array is only filled from elements 0 to nlines -1 */
+  index_by_key (nlines, freqs, lin_idx);
 
   /* SS - adding quantity "where_in_list" to line structure so that it is easy to from emission
      in recombination line to correct place in line list. */
 
-
   for (n = 0; n < nlines; n++)
   {
-    lin_ptr[n] = &line[index[n + 1] - 1];
-    line[index[n + 1] - 1].where_in_list = n;
+    line[lin_idx[n]].where_in_list = n;
   }
 
   /* Free the memory for the arrays */
   free (freqs);
-  free (index);
+
+  /* And make the frequency ordered copy of the lines */
+  build_line_view ();
 
   return (0);
 }
 
 
+
+/**********************************************************/
+/**
+ * @brief      Build the frequency ordered copy of the most used fields of the lines
+ *
+ * @return     The number of lines in the view
+ *
+ * @details
+ * The arrays in line_view are filled in the order of lin_idx, so
+ * this must be called after lin_idx has been set up by index_lines.
+ *
+ **********************************************************/
+
+int
+build_line_view ()
+{
+  int n, b;
+
+  shared_free (line_view.freq);
+  shared_free (line_view.f);
+  shared_free (line_view.gl);
+  shared_free (line_view.gu);
+  shared_free (line_view.nion);
+  shared_free (line_view.bucket);
+
+  line_view.nlines = nlines;
+  line_view.freq = shared_calloc ("line_view_freq", nlines + 1, sizeof (double));
+  line_view.f = shared_calloc ("line_view_f", nlines + 1, sizeof (double));
+  line_view.gl = shared_calloc ("line_view_gl", nlines + 1, sizeof (double));
+  line_view.gu = shared_calloc ("line_view_gu", nlines + 1, sizeof (double));
+  line_view.nion = shared_calloc ("line_view_nion", nlines + 1, sizeof (int));
+
+  if (line_view.freq == NULL || line_view.f == NULL || line_view.gl == NULL || line_view.gu == NULL || line_view.nion == NULL)
+  {
+    Error ("build_line_view: Could not allocate memory for %d lines\n", nlines);
+    Exit (0);
+  }
+
+  for (n = 0; n < nlines; n++)
+  {
+    line_view.freq[n] = LIN_PTR (n)->freq;
+    line_view.f[n] = LIN_PTR (n)->f;
+    line_view.gl[n] = LIN_PTR (n)->gl;
+    line_view.gu[n] = LIN_PTR (n)->gu;
+    line_view.nion[n] = LIN_PTR (n)->nion;
+  }
+
+  /* Divide the lines into buckets, aiming for about one line per bucket */
+
+  line_view.nbuckets = (nlines > 0) ? nlines : 1;
+  line_view.bucket = shared_calloc ("line_view_bucket", line_view.nbuckets + 1, sizeof (int));
+  if (line_view.bucket == NULL)
+  {
+    Error ("build_line_view: Could not allocate memory for %d buckets\n", line_view.nbuckets);
+    Exit (0);
+  }
+
+  line_view.log_freq_min = 0.0;
+  line_view.bucket_scale = 0.0;
+  if (nlines > 1 && line_view.freq[nlines - 1] > line_view.freq[0])
+  {
+    line_view.log_freq_min = log (line_view.freq[0]);
+    line_view.bucket_scale = line_view.nbuckets / (log (line_view.freq[nlines - 1]) - line_view.log_freq_min);
+  }
+
+  n = 0;
+  for (b = 0; b < line_view.nbuckets; b++)
+  {
+    while (n < nlines && line_view_bucket (line_view.freq[n]) < b)
+      n++;
+    line_view.bucket[b] = n;
+  }
+  line_view.bucket[line_view.nbuckets] = nlines;
+
+  return (nlines);
+}
+
+
 /**********************************************************/
 /**
  * @brief      Index the topbase photoionzation crossections by frequency
@@ -204,7 +272,7 @@ index_lines ()
  *
  * @details
  *
- * The results are stored in phot_top_ptr
+ * The results are stored in phot_top_idx
  *
  * ### Notes ###
  * Adapted from index_lines as part to topbase
@@ -215,37 +283,19 @@ index_lines ()
 int
 index_phot_top ()
 {
-  float *freqs, foo;
-  int *index, ioo;
+  double *freqs;
   int n;
-  void indexx ();
 
   /* Allocate memory for some modestly large arrays */
-  freqs = calloc (sizeof (foo), ntop_phot + nxphot + 2);
-  index = calloc (sizeof (ioo), ntop_phot + nxphot + 2);
+  freqs = calloc (sizeof (double), ntop_phot + nxphot + 1);
 
-  freqs[0] = 0;
   for (n = 0; n < ntop_phot + nxphot; n++)
-    freqs[n + 1] = phot_top[n].freq[0]; /* So filled matrix
-                                           elements run from 1 to ntop_phot */
-
-  indexx (ntop_phot + nxphot, freqs, index);    /* Note that this math recipes routine
-                                                   expects arrays to run from 1 to nlines inclusive */
-
-  /* The for loop indices are complicated by the numerical recipes routine,
-     which is a simple translation of a fortran routine.
-     Specifically, index array elements 1 to nlines are now filled,
-     and the numbers run from 1 to nlines, but the
-     pointer array is only filled from elements 0 to nlines -1 */
+    freqs[n] = xsection_pool.freq[phot_top[n].offset];
 
-  for (n = 0; n < ntop_phot + nxphot; n++)
-  {
-    phot_top_ptr[n] = &phot_top[index[n + 1] - 1];
-  }
+  index_by_key (ntop_phot + nxphot, freqs, phot_top_idx);
 
   /* Free the memory for the arrays */
   free (freqs);
-  free (index);
 
   return (0);
 
@@ -259,7 +309,7 @@ index_phot_top ()
  * @return     Alwasy returns 0
  *
  * @details
- * The rusults are stored in inner_cross_ptr
+ * The rusults are stored in inner_cross_idx
  *
  * ### Notes ###
  * ??? NOTES ???
@@ -269,44 +319,26 @@ index_phot_top ()
 int
 index_inner_cross ()
 {
-  float *freqs, foo;
-  int *index, ioo;
+  double *freqs;
   int n;
-  void indexx ();
 
   /* Allocate memory for some modestly large arrays */
-  freqs = calloc (sizeof (foo), n_inner_tot + 2);
-  index = calloc (sizeof (ioo), n_inner_tot + 2);
+  freqs = calloc (sizeof (double), n_inner_tot + 1);
 
-  freqs[0] = 0;
   for (n = 0; n < n_inner_tot; n++)
-    freqs[n + 1] = inner_cross[n].freq[0];      /* So filled matrix
-                                                   elements run from 1 to ntop_phot */
-
-  indexx (n_inner_tot, freqs, index);   /* Note that this math recipes routine
-                                           expects arrays to run from 1 to nlines inclusive */
+    freqs[n] = xsection_pool.freq[inner_cross[n].offset];
 
-  /* The for loop indices are complicated by the numerical recipes routine,
-     which is a simple translation of a fortran routine.
-     Specifically, index array elements 1 to nlines are now filled,
-     and the numbers run from 1 to nlines, but the
-     pointer array is only filled from elements 0 to nlines -1 */
-
-  for (n = 0; n < n_inner_tot; n++)
-  {
-    inner_cross_ptr[n] = &inner_cross[index[n + 1] - 1];
-  }
+  index_by_key (n_inner_tot, freqs, inner_cross_idx);
 
   /* Free the memory for the arrays */
   free (freqs);
-  free (index);
 
   return (0);
 
 }
 
 
-/* Numerical recipes routine used by index_lines which in turn is used by get_atomic_data */
+/* Numerical recipes routine which index_lines used before index_by_key; it sorts on float keys */
 
 
 /**********************************************************/
@@ -382,6 +414,80 @@ indexx (n, arrin, indx)
 
 
 
+/**********************************************************/
+/**
+ * @brief      Find the bucket of line_view which contains a frequency
+ *
+ * @param [in] double  freq   The frequency
+ * @return     The bucket, between 0 and line_view.nbuckets - 1
+ *
+ * @details
+ * Frequencies outside the range of the lines are put in the first
+ * or last bucket.  The bucket never decreases as the frequency
+ * increases, which is what makes the search in line_view_search exact.
+ *
+ **********************************************************/
+
+int
+line_view_bucket (freq)
+     double freq;
+{
+  double x;
+
+  x = (log (freq) - line_view.log_freq_min) * line_view.bucket_scale;
+
+  if (!(x > 0.0))
+    return (0);
+  if (x >= line_view.nbuckets)
+    return (line_view.nbuckets - 1);
+
+  return ((int) x);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the first line above a frequency
+ *
+ * @param [in] double  freq   The frequency
+ * @param [in] int  upper   If 0, find the first line with a frequency >= freq;
+ *    otherwise find the first line with a frequency > freq
+ * @return     The position of the line in line_view and lin_idx, or nlines if there is none
+ *
+ * @details
+ * The bucket which contains freq bounds the answer, since all of the lines
+ * in lower buckets have smaller frequencies and all of those in higher
+ * buckets have larger ones, so only the lines in that bucket are searched.
+ *
+ **********************************************************/
+
+int
+line_view_search (freq, upper)
+     double freq;
+     int upper;
+{
+  const double *lfreq = line_view.freq;
+  int b, lo, hi, mid;
+
+  b = line_view_bucket (freq);
+  lo = line_view.bucket[b];
+  hi = line_view.bucket[b + 1];
+
+  while (lo < hi)
+  {
+    mid = (lo + hi) >> 1;
+    if (upper ? lfreq[mid] <= freq : lfreq[mid] < freq)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return (lo);
+}
+
+
+
 /**********************************************************/
 /**
  * @brief      uses freqmin and freqmax to set limits on which lines in the
@@ -419,6 +525,9 @@ indexx (n, arrin, indx)
  * 	is in range.  This is because depending on how the velocity is trending you may
  * 	want to sum from the highest frequency line to the lowest.
  *
+ * 	The search uses the frequencies and buckets in line_view, which are in the
+ * 	same order as lin_idx, so the indices can be used with either.  Finding
+ * 	the bucket takes constant time, and only the lines in it are searched.
  *
  **********************************************************/
 
@@ -427,11 +536,7 @@ limit_lines (freqmin, freqmax)
      double freqmin, freqmax;
 {
 
-  int nmin, nmax, n;
-  double f;
-
-
-  if (freqmin > lin_ptr[nlines - 1]->freq || freqmax < lin_ptr[0]->freq)
+  if (freqmin > line_view.freq[nlines - 1] || freqmax < line_view.freq[0])
   {
     nline_min = 0;
     nline_max = 0;
@@ -439,41 +544,75 @@ limit_lines (freqmin, freqmax)
     return (0);
   }
 
-  f = freqmin;
+  /* The line below freqmin, and the line above freqmax, are included */
 
-  nmin = 0;
-  nmax = nlines - 1;
-  n = (nmin + nmax) >> 1;       // Compute a midpoint >> is a bitwise right shift
+  nline_min = line_view_search (freqmin, 0) - 1;
+  if (nline_min < 0)
+    nline_min = 0;
 
-  while (n != nmin)
-  {
-    if (lin_ptr[n]->freq < f)
-      nmin = n;
-    if (lin_ptr[n]->freq >= f)
-      nmax = n;
-    n = (nmin + nmax) >> 1;     // Compute a midpoint >> is a bitwise right shift
-  }
+  nline_max = line_view_search (freqmax, 1);
+  if (nline_max > nlines - 1)
+    nline_max = nlines - 1;
+
+
+  return (nline_delt = nline_max - nline_min + 1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the lines which are in each of a set of frequency windows
+ *
+ * @param [in] int  nwindows   The number of windows
+ * @param [in] double  freqmin[]   The minimum frequency of each window
+ * @param [in] double  freqmax[]   The maximum frequency of each window
+ * @param [out] int  line_min[]   The first line to consider for each window
+ * @param [out] int  line_max[]   The last line to consider for each window
+ * @param [out] int  line_delt[]   The number of lines for each window, 0 if there are none
+ * @return     The total number of lines in all of the windows
+ *
+ * @details
+ * The limits are exactly those limit_lines would set as nline_min,
+ * nline_max and nline_delt for each window, but the external
+ * variables are not changed.
+ *
+ **********************************************************/
 
-  nline_min = nmin;
+int
+limit_lines_batch (nwindows, freqmin, freqmax, line_min, line_max, line_delt)
+     int nwindows;
+     double freqmin[], freqmax[];
+     int line_min[], line_max[], line_delt[];
+{
+  int n, ntot;
+  double fmin_lines, fmax_lines;
 
-  f = freqmax;
-  nmin = 0;
-  nmax = nlines - 1;
-  n = (nmin + nmax) >> 1;       // Compute a midpoint >> is a bitwise right shift
+  fmin_lines = line_view.freq[0];
+  fmax_lines = line_view.freq[nlines - 1];
+  ntot = 0;
 
-  while (n != nmin)
+  for (n = 0; n < nwindows; n++)
   {
-    if (lin_ptr[n]->freq <= f)
-      nmin = n;
-    if (lin_ptr[n]->freq > f)
-      nmax = n;
-    n = (nmin + nmax) >> 1;     // Compute a midpoint >> is a bitwise right shift
-  }
+    if (freqmin[n] > fmax_lines || freqmax[n] < fmin_lines)
+    {
+      line_min[n] = line_max[n] = line_delt[n] = 0;
+      continue;
+    }
 
-  nline_max = nmax;
+    line_min[n] = line_view_search (freqmin[n], 0) - 1;
+    if (line_min[n] < 0)
+      line_min[n] = 0;
 
+    line_max[n] = line_view_search (freqmax[n], 1);
+    if (line_max[n] > nlines - 1)
+      line_max[n] = nlines - 1;
 
-  return (nline_delt = nline_max - nline_min + 1);
+    line_delt[n] = line_max[n] - line_min[n] + 1;
+    ntot += line_delt[n];
+  }
+
+  return (ntot);
 }
 
 
@@ -505,10 +644,10 @@ check_xsections ()
     if (ion[nion].phot_info == 1)
       Debug
         ("Topbase Ion %i Z %i istate %i nground %i ilv %i ntop %i f0 %8.4e IP %8.4e\n",
-         nion, ion[nion].z, ion[nion].istate, ion[nion].ntop_ground, phot_top[n].nlev, ion[nion].ntop, phot_top[n].freq[0], ion[nion].ip);
+         nion, ion[nion].z, ion[nion].istate, ion[nion].ntop_ground, phot_top[n].nlev, ion[nion].ntop, xsection_pool.freq[phot_top[n].offset], ion[nion].ip);
     else if (ion[nion].phot_info == 0)
       Debug ("Vfky Ion %i Z %i istate %i nground %i f0 %8.4e IP %8.4e\n",
-             nion, ion[nion].z, ion[nion].istate, ion[nion].nxphot, phot_top[n].freq[0], ion[nion].ip);
+             nion, ion[nion].z, ion[nion].istate, ion[nion].nxphot, xsection_pool.freq[phot_top[n].offset], ion[nion].ip);
 
     /* some simple checks -- could be made more robust */
     if (ion[nion].n_lte_max == 0 && ion[nion].phot_info == 1)
@@ -537,8 +676,39 @@ check_xsections ()
 /// (8*PI)/(sqrt(3) *nu_1Rydberg
 #define ECS_CONSTANT 4.773691e16
 
-struct lines *q21_line_ptr;
-double q21_a, q21_t_old;
+#define A21_CONSTANT 7.429297e-22       // 8 * PI * PI * E * E / (MELEC * C * C * C)
+
+
+/**********************************************************/
+/**
+ * @brief      Calculate the coefficients of a line which do not depend on temperature
+ *
+ * @param [in out] struct lines *  line_ptr   A single line
+ * @return     0
+ *
+ * @details
+ * The Einstein A coefficient, and the parts of q21 and q12 which do not
+ * depend on temperature, are stored in the line structure so that a21,
+ * q21 and q12 do not have to recalculate them.  This is done for every
+ * line by get_atomic_data, and must be done for any line structure which
+ * is made elsewhere before these routines are used with it.
+ *
+ **********************************************************/
+
+int
+line_coefficients (line_ptr)
+     struct lines *line_ptr;
+{
+  double freq;
+
+  freq = line_ptr->freq;
+  line_ptr->a21 = A21_CONSTANT * line_ptr->gl / line_ptr->gu * freq * freq * line_ptr->f;
+  line_ptr->q21_coef = 8.629e-6 / line_ptr->gu;
+  line_ptr->q21_vr = line_ptr->q21_coef * ECS_CONSTANT * line_ptr->gl * line_ptr->f / freq;
+  line_ptr->gu_over_gl = line_ptr->gu / line_ptr->gl;
+
+  return (0);
+}
 
 
 /**********************************************************/
@@ -557,6 +727,10 @@ double q21_a, q21_t_old;
  * The relevant paper to consult here is 
  * [Van Regemorter 1962 (ApJ 136 906)](https://ui.adsabs.harvard.edu/abs/1962ApJ...136..906V/abstract). 
  * We use an effective gaunt factor to calculate collision strengths.  
+ *
+ * The parts which do not depend on temperature are taken from the line
+ * structure (see line_coefficients), and nothing is remembered between
+ * calls, so the routine can be used from several threads at once.
  * 
 ************************************************************/
 
@@ -566,46 +740,37 @@ q21 (line_ptr, t)
      double t;
 {
   double gaunt;
-  double omega;
   double u0;
-  double upsilon ();
-
-
-  if (q21_line_ptr != line_ptr || t != q21_t_old)
-  {
-
-    u0 = (BOLTZMANN * t) / (PLANCK * line_ptr->freq);
+  double rate;
 
 
-    if (line_ptr->coll_index < 0)       //if we do not have a collision strength for this line use the g-bar formulation
-    {
+  u0 = (BOLTZMANN * t) / (PLANCK * line_ptr->freq);
 
-      /* Use the gaunt factor approximatation suggested by Van Regemorter, which makes neutrals a special case. */
-      if (line_ptr->istate == 1 && u0 < 2)
-        gaunt = u0 / 10.0;
-      else
-        gaunt = 0.2;
 
-      omega = ECS_CONSTANT * line_ptr->gl * gaunt * line_ptr->f / line_ptr->freq;
-    }
-    else                        //otherwise use the collision strength directly. NB what we call omega, most people including hazy call upsilon.
-    {
-      omega = upsilon (line_ptr->coll_index, u0);
-    }
+  if (line_ptr->coll_index < 0) //if we do not have a collision strength for this line use the g-bar formulation
+  {
 
+    /* Use the gaunt factor approximatation suggested by Van Regemorter, which makes neutrals a special case. */
+    if (line_ptr->istate == 1 && u0 < 2)
+      gaunt = u0 / 10.0;
+    else
+      gaunt = 0.2;
 
-    q21_a = 8.629e-6 / (sqrt (t) * line_ptr->gu) * omega;
-    q21_t_old = t;
+    rate = line_ptr->q21_vr * gaunt / sqrt (t);
+  }
+  else                          //otherwise use the collision strength directly. NB what we call omega, most people including hazy call upsilon.
+  {
+    rate = line_ptr->q21_coef * tabulated_upsilon (line_ptr->coll_index, u0) / sqrt (t);
   }
 
 
-  if (q21_a < 0.0)
+  if (rate < 0.0)
   {
-    Error ("q21: Calculated q21 (%e) < 0. Setting to 0", q21_a);
-    q21_a = 0.0;
+    Error ("q21: Calculated q21 (%e) < 0. Setting to 0", rate);
+    rate = 0.0;
   }
 
-  return (q21_a);
+  return (rate);
 }
 
 
@@ -630,10 +795,8 @@ q12 (line_ptr, t)
      double t;
 {
   double x;
-  double q21 ();
-  double exp ();
 
-  x = line_ptr->gu / line_ptr->gl * q21 (line_ptr, t) * exp (-H_OVER_K * line_ptr->freq / t);
+  x = line_ptr->gu_over_gl * q21 (line_ptr, t) * exp (-H_OVER_K * line_ptr->freq / t);
 
   // Not clear that this check is needed; it should only occure if q21 is less than 0
   if (x < 0.0)
@@ -646,12 +809,6 @@ q12 (line_ptr, t)
 }
 
 
-#define A21_CONSTANT 7.429297e-22       // 8 * PI * PI * E * E / (MELEC * C * C * C)
-
-struct lines *a21_line_ptr;
-double a21_a;
-
-
 /**********************************************************/
 /**
  * @brief      Calculate the Einstein A coefficient for a line
@@ -664,6 +821,7 @@ double a21_a;
  * read in) calculate A
  *
  * ### Notes ###
+ * A is calculated once for each line by line_coefficients.
  *
  **********************************************************/
 
@@ -671,16 +829,74 @@ double
 a21 (line_ptr)
      struct lines *line_ptr;
 {
-  double freq;
+  return (line_ptr->a21);
+}
+
+
+/**********************************************************/
+/**
+ * @brief      Calculate q21, q12 and A21 for every line at one temperature
+ *
+ * @param [in] double  t   The temperature
+ * @param [out] double  q21_rate[]   The collisional de-excitation coefficient of each line
+ * @param [out] double  q12_rate[]   The collisional excitation coefficient of each line
+ * @param [out] double  a21_rate[]   The Einstein A coefficient of each line
+ * @return     The number of lines
+ *
+ * @details
+ * Element n of each array is for line[n], and the values are those
+ * q21, q12 and a21 would return.  The Van Regemorter rates are
+ * calculated for all of the lines in one loop without branches that
+ * the compiler cannot remove, and the lines with collision strengths
+ * are then corrected, so that the work for most lines can be
+ * vectorised.
+ *
+ **********************************************************/
+
+int
+line_rates (t, q21_rate, q12_rate, a21_rate)
+     double t;
+     double q21_rate[], q12_rate[], a21_rate[];
+{
+  double kt_over_h, h_over_kt, sqrt_t;
+  double u0, gaunt;
+  int n, nneg;
+
+  kt_over_h = BOLTZMANN * t / PLANCK;
+  h_over_kt = H_OVER_K / t;
+  sqrt_t = sqrt (t);
+
+  for (n = 0; n < nlines; n++)
+  {
+    u0 = kt_over_h / line[n].freq;
+    gaunt = (line[n].istate == 1 && u0 < 2) ? u0 / 10.0 : 0.2;
+    q21_rate[n] = line[n].q21_vr * gaunt / sqrt_t;
+    a21_rate[n] = line[n].a21;
+  }
+
+  for (n = 0; n < nlines; n++)
+  {
+    if (line[n].coll_index >= 0)
+      q21_rate[n] = line[n].q21_coef * tabulated_upsilon (line[n].coll_index, kt_over_h / line[n].freq) / sqrt_t;
+  }
+
+  nneg = 0;
+  for (n = 0; n < nlines; n++)
+  {
+    if (q21_rate[n] < 0.0)
+    {
+      q21_rate[n] = 0.0;
+      nneg++;
+    }
+    q12_rate[n] = line[n].gu_over_gl * q21_rate[n] * exp (-h_over_kt * line[n].freq);
+  }
 
-  if (a21_line_ptr != line_ptr)
+  if (nneg > 0)
   {
-    freq = line_ptr->freq;
-    a21_a = A21_CONSTANT * line_ptr->gl / line_ptr->gu * freq * freq * line_ptr->f;
-    a21_line_ptr = line_ptr;
+    Error ("line_rates: Calculated q21 < 0 for %d lines. Setting to 0\n", nneg);
   }
 
-  return (a21_a);
+  return (nlines);
 }
 
 
@@ -762,53 +978,755 @@ upsilon (n_coll, u0)
   return (upsilon);
 }
 
+
+
 /**********************************************************/
 /**
- * @brief Printout some information about auger macro-atom data for diagnostics
+ * @brief      The fractional error of tabulated_upsilon at one value of u0
+ *
  **********************************************************/
 
-// void check_auger_macro()
-// {
-//   int n, iauger;
-//   int nconfigu, nconfigl;
+static double
+upsilon_table_error (int n_coll, double u0)
+{
+  double exact, interp;
 
-//   for (n = 0; n < nlines; n++)
-//   {
-//     nconfigu = line[n].nconfigu;
+  exact = upsilon (n_coll, u0);
+  interp = tabulated_upsilon (n_coll, u0);
 
-//     if (xconfig[nconfigu].iauger >= 0)
-//     {
-//       iauger = xconfig[nconfigu].iauger;
+  return ((exact != 0.0) ? fabs ((interp - exact) / exact) : fabs (interp));
+}
 
 
-//     }
-//   }
-// }
 
+/**********************************************************/
+/**
+ * @brief      Make room for more points in the pool which holds the tables of upsilon
+ *
+ **********************************************************/
+
+static void
+upsilon_pool_reserve (int npoints)
+{
+  int npoints_max;
+
+  if (upsilon_pool.npoints + npoints <= upsilon_pool.npoints_max)
+    return;
+
+  npoints_max = 2 * upsilon_pool.npoints_max;
+  if (npoints_max < upsilon_pool.npoints + npoints)
+    npoints_max = upsilon_pool.npoints + npoints;
+
+  if (upsilon_pool.upsilon == NULL)
+    upsilon_pool.upsilon = shared_calloc ("upsilon_pool", npoints_max, sizeof (double));
+  else
+    upsilon_pool.upsilon = shared_realloc (upsilon_pool.upsilon, npoints_max, sizeof (double));
+
+  if (upsilon_pool.upsilon == NULL)
+  {
+    Error ("upsilon_pool_reserve: Could not allocate %d points for the tables of upsilon\n", npoints_max);
+    Exit (0);
+  }
+
+  upsilon_pool.npoints_max = npoints_max;
+}
 
 
 
 /**********************************************************/
 /**
- * @brief Skip the specified number of lines in a file
+ * @brief      Make a table of upsilon against temperature for one collision strength
  *
- * @param[in, out] FILE *fptr  The file to skip lines for
- * @param[in] int nskip        The number of lines to skip
+ * @param [in] int  n_coll   The index of the collision strength record
+ * @param [in] double  freq   The frequency of the line the record belongs to
+ * @param [in] double  tmin   The lowest temperature in the table
+ * @param [in] double  tmax   The highest temperature in the table
+ * @param [in] double  max_error   The largest fractional error allowed in the interpolated upsilon
+ * @return     The number of points in the table
  *
  * @details
- * Reads a line in character by character until reaching the end of the line
- * (denoted by a new line character \n) or until reaching the end of the
- * file.
+ * The points are evenly spaced in log(T_e), which for a given line is the
+ * same as being evenly spaced in log(u0).  The table starts with 17 points,
+ * and the number of intervals is doubled until linear interpolation
+ * reproduces upsilon to within max_error, or until there would be more
+ * than UPSILON_TABLE_MAX_POINTS.  The table is added to the end of
+ * upsilon_pool.
+ *
+ * ### Notes ###
+ * upsilon is smooth except for a kink at each of the Burgess and Tully
+ * points, where the interpolation in the reduced temperature changes
+ * slope.  The error is therefore checked at the kinks, which is where it
+ * is largest, as well as at a quarter, a half and three quarters of the
+ * way through every interval.  Because of the kinks the error only falls
+ * in proportion to the spacing of the table.
  *
  **********************************************************/
 
-void
-skiplines (FILE * fptr, int nskip)
+int
+build_upsilon_table (n_coll, freq, tmin, tmax, max_error)
+     int n_coll;
+     double freq, tmin, tmax, max_error;
 {
-  int i, c;
+  Coll_strenptr cs;
+  double log_u0_min, log_u0_max, dlog_u0;
+  double x, u0, c, error, worst, frac;
+  int n, npts;
 
-  for (i = 0; i < nskip; ++i)
+  cs = &coll_stren[n_coll];
+  log_u0_min = log (BOLTZMANN * tmin / (PLANCK * freq));
+  log_u0_max = log (BOLTZMANN * tmax / (PLANCK * freq));
+  c = cs->scaling_param;
+
+  cs->n_table = 0;
+  cs->table_offset = upsilon_pool.npoints;
+
+  worst = 0.0;
+  for (npts = 17; npts <= UPSILON_TABLE_MAX_POINTS; npts = 2 * npts - 1)
   {
-    while (c = fgetc (fptr), c != '\n' && c != EOF);
+    upsilon_pool_reserve (npts);
+
+    dlog_u0 = (log_u0_max - log_u0_min) / (npts - 1);
+    for (n = 0; n < npts; n++)
+    {
+      upsilon_pool.upsilon[cs->table_offset + n] = upsilon (n_coll, exp (log_u0_min + n * dlog_u0));
+    }
+
+    cs->n_table = npts;
+    cs->log_u0_min = log_u0_min;
+    cs->table_scale = (npts - 1) / (log_u0_max - log_u0_min);
+
+    worst = 0.0;
+    for (n = 0; n < npts - 1; n++)
+    {
+      for (frac = 0.25; frac < 1.0; frac += 0.25)
+      {
+        error = upsilon_table_error (n_coll, exp (log_u0_min + (n + frac) * dlog_u0));
+        if (error > worst)
+          worst = error;
+      }
+    }
+
+    /* Invert the reduced temperature of each Burgess and Tully point to find where the kinks are */
+
+    for (n = 0; n < cs->n_points; n++)
+    {
+      x = cs->sct[n];
+      if (x <= 0.0 || x >= 1.0)
+        continue;
+      if (cs->type == 1 || cs->type == 4)
+        u0 = exp (log (c) / (1. - x)) - c;
+      else
+        u0 = c * x / (1. - x);
+      if (u0 > 0.0 && (error = upsilon_table_error (n_coll, u0)) > worst)
+        worst = error;
+    }
+
+    if (worst <= max_error)
+      break;
   }
+
+  if (worst > max_error)
+  {
+    Log_silent ("build_upsilon_table: coll_stren %d has error %.2e > %.2e with %d points\n", n_coll, worst, max_error,
+                cs->n_table);
+  }
+
+  upsilon_pool.npoints += cs->n_table;
+
+  return (cs->n_table);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Make tables of upsilon for all of the collision strengths
+ *
+ * @param [in] double  tmin   The lowest temperature in the tables
+ * @param [in] double  tmax   The highest temperature in the tables
+ * @param [in] double  max_error   The largest fractional error allowed in the interpolated upsilon
+ * @return     The total number of points in the tables
+ *
+ * @details
+ * Once the tables have been made, tabulated_upsilon, and so q21, q12 and
+ * line_rates, interpolate in them for temperatures between tmin and tmax.
+ * The tables are optional; UPSILON_TABLE_TMIN, UPSILON_TABLE_TMAX and
+ * UPSILON_TABLE_ERROR are reasonable values for the arguments.  Any
+ * tables which have already been made are replaced.
+ *
+ **********************************************************/
+
+int
+build_upsilon_tables (tmin, tmax, max_error)
+     double tmin, tmax, max_error;
+{
+  int n, ntot;
+
+  upsilon_pool.npoints = 0;
+  for (n = 0; n < n_coll_stren; n++)
+    coll_stren[n].n_table = 0;
+
+  ntot = 0;
+  for (n = 0; n < nlines; n++)
+  {
+    if (line[n].coll_index >= 0)
+      ntot += build_upsilon_table (line[n].coll_index, line[n].freq, tmin, tmax, max_error);
+  }
+
+  Log ("build_upsilon_tables: %d tables of upsilon from %.1e to %.1e K with %d points in all\n", n_coll_stren, tmin, tmax,
+       ntot);
+
+  return (ntot);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the collision strength for a line, from a table if there is one
+ *
+ * @param [in] int  n_coll   the index of the collision strength record we are working with
+ * @param [in] double  u0  - kT_e/hnu for the line
+ * @return     upsilon
+ *
+ * @details
+ * If build_upsilon_tables has been called and u0 is inside the table,
+ * upsilon is interpolated linearly in log(u0); otherwise it is calculated
+ * by upsilon.
+ *
+ **********************************************************/
+
+double
+tabulated_upsilon (n_coll, u0)
+     int n_coll;
+     double u0;
+{
+  Coll_strenptr cs;
+  const double *table;
+  double x, frac;
+  int n;
+
+  cs = &coll_stren[n_coll];
+  if (cs->n_table == 0)
+    return (upsilon (n_coll, u0));
+
+  x = (log (u0) - cs->log_u0_min) * cs->table_scale;
+  if (!(x >= 0.0) || x > cs->n_table - 1)
+    return (upsilon (n_coll, u0));
+
+  n = (int) x;
+  if (n > cs->n_table - 2)
+    n = cs->n_table - 2;
+  frac = x - n;
+
+  table = &upsilon_pool.upsilon[cs->table_offset];
+
+  return (table[n] + frac * (table[n + 1] - table[n]));
+}
+
+/**********************************************************/
+/**
+ * @brief Printout some information about auger macro-atom data for diagnostics
+ **********************************************************/
+
+// void check_auger_macro()
+// {
+//   int n, iauger;
+//   int nconfigu, nconfigl;
+
+//   for (n = 0; n < nlines; n++)
+//   {
+//     nconfigu = line[n].nconfigu;
+
+//     if (xconfig[nconfigu].iauger >= 0)
+//     {
+//       iauger = xconfig[nconfigu].iauger;
+
+
+//     }
+//   }
+// }
+
+
+
+
+/**********************************************************/
+/**
+ * @brief Skip the specified number of lines in a file
+ *
+ * @param[in, out] FILE *fptr  The file to skip lines for
+ * @param[in] int nskip        The number of lines to skip
+ *
+ * @details
+ * Reads a line in character by character until reaching the end of the line
+ * (denoted by a new line character \n) or until reaching the end of the
+ * file.
+ *
+ **********************************************************/
+
+void
+skiplines (FILE * fptr, int nskip)
+{
+  int i, c;
+
+  for (i = 0; i < nskip; ++i)
+  {
+    while (c = fgetc (fptr), c != '\n' && c != EOF);
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Read an entire atomic data file into memory
+ *
+ * @param [in] char *filename   The name of the file to read
+ * @param [out] Atomic_file *afile  The structure which holds the contents of the file
+ * @return     0 if the file was read successfully, 1 if it could not be opened or read
+ *
+ * @details
+ *
+ * The file is read with a single fread into a buffer which is one byte larger
+ * than the file, so that the buffer is always terminated.  The lines in the file
+ * are then retrieved with atomic_file_next_line, which works entirely within
+ * the buffer.
+ *
+ * ### Notes ###
+ *
+ * This replaces reading the data files one line at a time with fgets.  On
+ * parallel file systems a single large sequential read is much cheaper than
+ * the many small reads issued by each rank.
+ *
+ * The buffer should be released with atomic_file_close once all of the
+ * lines returned from it are no longer needed.
+ *
+ * No messages are written here, since the data files may be read
+ * from several threads at once.  It is up to the caller to report a failure.
+ *
+ **********************************************************/
+
+int
+atomic_file_open (filename, afile)
+     char *filename;
+     Atomic_file *afile;
+{
+  FILE *fptr;
+  long size;
+
+  afile->buf = NULL;
+  afile->next = NULL;
+  afile->end = NULL;
+
+  if ((fptr = fopen (filename, "r")) == NULL)
+  {
+    return (1);
+  }
+
+  if (fseek (fptr, 0, SEEK_END) != 0 || (size = ftell (fptr)) < 0 || fseek (fptr, 0, SEEK_SET) != 0
+      || (afile->buf = malloc (size + 1)) == NULL)
+  {
+    fclose (fptr);
+    return (1);
+  }
+
+  if ((long) fread (afile->buf, 1, size, fptr) != size)
+  {
+    free (afile->buf);
+    afile->buf = NULL;
+    fclose (fptr);
+    return (1);
+  }
+
+  fclose (fptr);
+
+  afile->buf[size] = '\0';
+  afile->next = afile->buf;
+  afile->end = afile->buf + size;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Get the next line from an atomic data file which has been read into memory
+ *
+ * @param [in, out] Atomic_file *afile  The file, as read by atomic_file_open
+ * @param [out] char **line   Set to the start of the next line
+ * @return     1 if a line was found, 0 if the end of the file has been reached
+ *
+ * @details
+ *
+ * The newline at the end of the line is replaced in the buffer by a string
+ * terminator, and line is pointed at the start of the line, so no copy is made
+ * and the line can be of any length.  Lines are therefore no longer split when
+ * they are longer than the buffers which used to be used with fgets.
+ *
+ * ### Notes ###
+ *
+ * As with fgets, line is left unchanged when the end of the file has been
+ * reached.  The returned line does not include the newline character.
+ *
+ **********************************************************/
+
+int
+atomic_file_next_line (afile, line)
+     Atomic_file *afile;
+     char **line;
+{
+  char *start, *eol;
+
+  if (afile->next == NULL || afile->next >= afile->end)
+  {
+    return (0);
+  }
+
+  start = afile->next;
+
+  if ((eol = memchr (start, '\n', afile->end - start)) != NULL)
+  {
+    *eol = '\0';
+    afile->next = eol + 1;
+  }
+  else
+  {
+    afile->next = afile->end;
+  }
+
+  *line = start;
+
+  return (1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Release the memory used to hold an atomic data file
+ *
+ * @param [in, out] Atomic_file *afile  The file, as read by atomic_file_open
+ *
+ * @details
+ * Any lines returned by atomic_file_next_line are invalid after this call.
+ *
+ **********************************************************/
+
+void
+atomic_file_close (afile)
+     Atomic_file *afile;
+{
+  free (afile->buf);
+  afile->buf = afile->next = afile->end = NULL;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Reserve space in the pool which holds the points of the photoionization x-sections
+ *
+ * @param [in] int npoints   The number of points for which to reserve space
+ * @return     Always returns 0
+ *
+ * @details
+ * Any x-sections already in the pool are discarded. The number of points
+ * is normally the total number of x-section points in the data files
+ * which have been read, which is an upper limit on the number stored.
+ *
+ **********************************************************/
+
+int
+xsection_pool_init (npoints)
+     int npoints;
+{
+  shared_free (xsection_pool.freq);
+  shared_free (xsection_pool.log_freq);
+  shared_free (xsection_pool.x);
+  shared_free (xsection_pool.log_x);
+
+  xsection_pool.npoints = 0;
+  xsection_pool.npoints_max = 0;
+  xsection_pool.freq = xsection_pool.log_freq = xsection_pool.x = xsection_pool.log_x = NULL;
+
+  if (npoints > 0)
+  {
+    xsection_pool.freq = shared_calloc ("xsection_freq", npoints, sizeof (double));
+    xsection_pool.log_freq = shared_calloc ("xsection_log_freq", npoints, sizeof (double));
+    xsection_pool.x = shared_calloc ("xsection_x", npoints, sizeof (double));
+    xsection_pool.log_x = shared_calloc ("xsection_log_x", npoints, sizeof (double));
+
+    if (xsection_pool.freq == NULL || xsection_pool.log_freq == NULL || xsection_pool.x == NULL || xsection_pool.log_x == NULL)
+    {
+      Error ("xsection_pool_init: Could not allocate memory for %d x-section points\n", npoints);
+      Exit (0);
+    }
+
+    xsection_pool.npoints_max = npoints;
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Store the points of a photoionization x-section in the pool
+ *
+ * @param [in, out] Topbase_phot *xptr   The x-section to which the points belong
+ * @param [in] int np   The number of points
+ * @param [in] double xe[]   The energies of the points in eV
+ * @param [in] double xx[]   The cross sections in cgs
+ * @return     The offset of the first point in the pool
+ *
+ * @details
+ * The offset is also recorded in xptr. The energies are converted
+ * to frequencies, and the logs of the frequencies and cross sections,
+ * which are used for the FB integrals, are stored as well.
+ *
+ * ### Notes ###
+ * If the x-section replaces one which has already been stored, the
+ * old points are left unused in the pool until xsection_pool_compact
+ * is called.
+ *
+ **********************************************************/
+
+int
+xsection_pool_add (xptr, np, xe, xx)
+     Topbase_phot *xptr;
+     int np;
+     double xe[], xx[];
+{
+  int n, offset;
+  int npoints_max;
+
+  if (xsection_pool.freq == NULL)
+    xsection_pool_init (np);
+
+  offset = xsection_pool.npoints;
+
+  if (offset + np > xsection_pool.npoints_max)
+  {
+    npoints_max = offset + np;
+    xsection_pool.freq = shared_realloc (xsection_pool.freq, npoints_max, sizeof (double));
+    xsection_pool.log_freq = shared_realloc (xsection_pool.log_freq, npoints_max, sizeof (double));
+    xsection_pool.x = shared_realloc (xsection_pool.x, npoints_max, sizeof (double));
+    xsection_pool.log_x = shared_realloc (xsection_pool.log_x, npoints_max, sizeof (double));
+
+    if (xsection_pool.freq == NULL || xsection_pool.log_freq == NULL || xsection_pool.x == NULL || xsection_pool.log_x == NULL)
+    {
+      Error ("xsection_pool_add: Could not allocate memory for %d x-section points\n", npoints_max);
+      Exit (0);
+    }
+
+    xsection_pool.npoints_max = npoints_max;
+  }
+
+  for (n = 0; n < np; n++)
+  {
+    xsection_pool.freq[offset + n] = xe[n] * EV2ERGS / PLANCK;  // convert from eV to freqency
+    xsection_pool.log_freq[offset + n] = log (xe[n] * EV2ERGS / PLANCK);        // log version
+    xsection_pool.x[offset + n] = xx[n];        // leave cross sections in  CGS
+    xsection_pool.log_x[offset + n] = log (xx[n]);      // log version
+  }
+
+  xsection_pool.npoints += np;
+  xptr->offset = offset;
+
+  return (offset);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Reduce the x-section pool to the points which are used
+ *
+ * @return     The number of points in the pool
+ *
+ * @details
+ * The points of the photoionization and inner shell x-sections which
+ * have been read are copied into arrays which are exactly large enough
+ * to hold them, and the offsets of the x-sections are updated. This
+ * is called once all of the atomic data has been read.
+ *
+ **********************************************************/
+
+int
+xsection_pool_compact ()
+{
+  Xsection_pool pool;
+  Topbase_phot *xptr;
+  int n, nn, npoints;
+
+  npoints = 0;
+  for (n = 0; n < nphot_total + n_inner_tot; n++)
+  {
+    xptr = (n < nphot_total) ? &phot_top[n] : &inner_cross[n - nphot_total];
+    if (xptr->offset >= 0 && xptr->np > 0)
+      npoints += xptr->np;
+  }
+
+  pool = xsection_pool;
+  xsection_pool.freq = xsection_pool.log_freq = xsection_pool.x = xsection_pool.log_x = NULL;
+  xsection_pool_init (npoints);
+
+  for (n = 0; n < nphot_total + n_inner_tot; n++)
+  {
+    xptr = (n < nphot_total) ? &phot_top[n] : &inner_cross[n - nphot_total];
+    if (xptr->offset >= 0 && xptr->np > 0)
+    {
+      nn = xsection_pool.npoints;
+      memcpy (&xsection_pool.freq[nn], &pool.freq[xptr->offset], xptr->np * sizeof (double));
+      memcpy (&xsection_pool.log_freq[nn], &pool.log_freq[xptr->offset], xptr->np * sizeof (double));
+      memcpy (&xsection_pool.x[nn], &pool.x[xptr->offset], xptr->np * sizeof (double));
+      memcpy (&xsection_pool.log_x[nn], &pool.log_x[xptr->offset], xptr->np * sizeof (double));
+      xptr->offset = nn;
+      xsection_pool.npoints += xptr->np;
+    }
+  }
+
+  free (pool.freq);
+  free (pool.log_freq);
+  free (pool.x);
+  free (pool.log_x);
+
+  return (xsection_pool.npoints);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Empty a list of Macro Atom jumps
+ *
+ * @param [in, out] Jump_list *list   The list of jumps
+ * @param [in] char *name   The name of the list, which is used to name its tables
+ * @return     Always returns 0
+ *
+ **********************************************************/
+
+int
+jump_list_init (list, name)
+     Jump_list *list;
+     char *name;
+{
+  strncpy (list->name, name, sizeof (list->name) - 1);
+  list->name[sizeof (list->name) - 1] = '\0';
+
+  shared_free (list->offset);
+  shared_free (list->jump);
+  free (list->pair_config);
+  free (list->pair_jump);
+
+  list->offset = list->jump = list->pair_config = list->pair_jump = NULL;
+  list->njumps = list->npairs = list->npairs_max = 0;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Record a Macro Atom jump from a configuration
+ *
+ * @param [in, out] Jump_list *list   The list of jumps
+ * @param [in] int nconfig   The configuration from which the jump is made
+ * @param [in] int njump   The index of the line or phot_top x-section for the jump
+ * @return     Always returns 0
+ *
+ * @details
+ * The jump is only recorded here, and becomes available once
+ * jump_list_build has been called.  The caller keeps track of
+ * the number of jumps from each configuration.
+ *
+ **********************************************************/
+
+int
+jump_list_add (list, nconfig, njump)
+     Jump_list *list;
+     int nconfig, njump;
+{
+  int npairs_max;
+
+  if (list->npairs == list->npairs_max)
+  {
+    npairs_max = (list->npairs_max > 0) ? 2 * list->npairs_max : 1024;
+    list->pair_config = realloc (list->pair_config, npairs_max * sizeof (int));
+    list->pair_jump = realloc (list->pair_jump, npairs_max * sizeof (int));
+    if (list->pair_config == NULL || list->pair_jump == NULL)
+    {
+      Error ("jump_list_add: Could not allocate memory for %d Macro Atom jumps\n", npairs_max);
+      Exit (0);
+    }
+    list->npairs_max = npairs_max;
+  }
+
+  list->pair_config[list->npairs] = nconfig;
+  list->pair_jump[list->npairs] = njump;
+  list->npairs++;
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Build the compressed sparse row form of a list of Macro Atom jumps
+ *
+ * @param [in, out] Jump_list *list   The list of jumps
+ * @param [in] int nconfigs   The number of configurations
+ * @return     The number of jumps in the list
+ *
+ * @details
+ * The pairs recorded by jump_list_add are sorted by configuration,
+ * keeping the order in which the jumps from each configuration were
+ * recorded, into the offset and jump arrays.  The pairs are then freed.
+ *
+ **********************************************************/
+
+int
+jump_list_build (list, nconfigs)
+     Jump_list *list;
+     int nconfigs;
+{
+  char name[32];
+  int n, *next;
+
+  shared_free (list->offset);
+  shared_free (list->jump);
+
+  list->njumps = list->npairs;
+  snprintf (name, sizeof (name), "%s_offset", list->name);
+  list->offset = shared_calloc (name, nconfigs + 1, sizeof (int));
+  snprintf (name, sizeof (name), "%s_jump", list->name);
+  list->jump = shared_calloc (name, list->njumps, sizeof (int));
+  next = calloc (nconfigs + 1, sizeof (int));
+  if (list->offset == NULL || list->jump == NULL || next == NULL)
+  {
+    Error ("jump_list_build: Could not allocate memory for %d Macro Atom jumps\n", list->njumps);
+    Exit (0);
+  }
+
+  for (n = 0; n < list->npairs; n++)
+    list->offset[list->pair_config[n] + 1]++;
+  for (n = 0; n < nconfigs; n++)
+  {
+    list->offset[n + 1] += list->offset[n];
+    next[n] = list->offset[n];
+  }
+  for (n = 0; n < list->npairs; n++)
+    list->jump[next[list->pair_config[n]]++] = list->pair_jump[n];
+
+  free (next);
+  free (list->pair_config);
+  free (list->pair_jump);
+  list->pair_config = list->pair_jump = NULL;
+  list->npairs = list->npairs_max = 0;
+
+  return (list->njumps);
 }
@@ -0,0 +1,431 @@
+
+/***********************************************************/
+/** @file  rate_tables.c
+ *
+ * @brief  Tables of the rate coefficients which are given as fits
+ *
+ * The dielectronic and radiative recombination, direct ionization and
+ * charge exchange rates are read in as the parameters of fits, which
+ * have to be evaluated for every ion in every cell whenever the
+ * temperature of a cell changes.  The routines here evaluate the fits
+ * once on a grid of temperatures after the atomic data have been read,
+ * and then interpolate in the tables for the temperatures of many
+ * cells at once.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <gsl/gsl_errno.h>
+#include <gsl/gsl_sf_expint.h>
+
+#include "atomic.h"
+#include "log.h"
+// If routines are added cproto > atomic_proto.h should be run
+#include "atomic_proto.h"
+#include "math_struc.h"
+#include "math_proto.h"
+
+
+
+/**********************************************************/
+/**
+ * @brief      The dielectronic recombination rate coefficient of an ion
+ *
+ * @details
+ * Both the Badnell and the Shull forms of the fit are supported.
+ *
+ **********************************************************/
+
+static double
+dr_fit (int nion, double t)
+{
+  Drecombptr dr;
+  double rate;
+  int n;
+
+  if (ion[nion].drflag == 0)
+    return (0.0);
+
+  dr = &drecomb[ion[nion].nxdrecomb];
+  rate = 0.0;
+  if (dr->type == DRTYPE_BADNELL)
+  {
+    for (n = 0; n < dr->nparam; n++)
+    {
+      rate += dr->c[n] * exp (-dr->e[n] / t);
+    }
+    rate *= pow (t, -1.5);
+  }
+  else if (dr->type == DRTYPE_SHULL)
+  {
+    rate = dr->shull[0] * pow (t, -1.5) * exp (-dr->shull[2] / t) * (1. + dr->shull[1] * exp (-dr->shull[3] / t));
+  }
+
+  return (rate);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      The total radiative recombination rate coefficient of an ion
+ *
+ * @details
+ * Both the Badnell and the Shull forms of the fit are supported.
+ *
+ **********************************************************/
+
+static double
+total_rr_fit (int nion, double t)
+{
+  total_rrptr rr;
+  double b, rate;
+
+  if (ion[nion].total_rrflag == 0)
+    return (0.0);
+
+  rr = &total_rr[ion[nion].nxtotalrr];
+  rate = 0.0;
+  if (rr->type == RRTYPE_BADNELL)
+  {
+    b = rr->params[1] + rr->params[4] * exp (-rr->params[5] / t);
+    rate = rr->params[0] / (sqrt (t / rr->params[2]) * pow (1. + sqrt (t / rr->params[2]), 1. - b) *
+                            pow (1. + sqrt (t / rr->params[3]), 1. + b));
+  }
+  else if (rr->type == RRTYPE_SHULL)
+  {
+    rate = rr->params[0] * pow (t / 1.0e4, -rr->params[1]);
+  }
+
+  return (rate);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      The ground state radiative recombination rate coefficient of an ion
+ *
+ * @details
+ * The rates are tabulated, and are held constant outside the
+ * tabulated temperatures.
+ *
+ **********************************************************/
+
+static double
+gs_rr_fit (int nion, double t)
+{
+  Bad_gs_rrptr gs;
+  double rate;
+
+  if (ion[nion].bad_gs_rr_t_flag == 0 || ion[nion].bad_gs_rr_r_flag == 0)
+    return (0.0);
+
+  gs = &bad_gs_rr[ion[nion].nxbadgsrr];
+  if (t <= gs->temps[0])
+    return (gs->rates[0]);
+  if (t >= gs->temps[BAD_GS_RR_PARAMS - 1])
+    return (gs->rates[BAD_GS_RR_PARAMS - 1]);
+
+  linterp (t, gs->temps, gs->rates, BAD_GS_RR_PARAMS, &rate, 0);
+
+  return (rate);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      The direct ionization rate coefficient of an ion
+ *
+ * @details
+ * The fit of Dere (2007) is tabulated against a scaled temperature,
+ * and is held constant outside the tabulated range.  There is no
+ * ionization below the minimum temperature of the fit.
+ *
+ **********************************************************/
+
+static double
+di_fit (int nion, double t)
+{
+  Dere_di_rateptr di;
+  gsl_sf_result e1;
+  double x, scaled_t, rate;
+
+  if (ion[nion].dere_di_flag == 0)
+    return (0.0);
+
+  di = &dere_di_rate[ion[nion].nxderedi];
+  if (t < di->min_temp)
+    return (0.0);
+
+  x = BOLTZMANN * t / (di->xi * EV2ERGS);
+  scaled_t = 1.0 - log (2.0) / log (2.0 + x);
+
+  if (scaled_t <= di->temps[0])
+    rate = di->rates[0];
+  else if (scaled_t >= di->temps[di->nspline - 1])
+    rate = di->rates[di->nspline - 1];
+  else
+    linterp (scaled_t, di->temps, di->rates, di->nspline, &rate, 0);
+
+  /* E1 underflows when the temperature is far below the ionization potential */
+
+  if (gsl_sf_expint_E1_e (1.0 / x, &e1) != GSL_SUCCESS)
+    return (0.0);
+
+  return (pow (x, -0.5) * pow (di->xi, -1.5) * rate * e1.val);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      The rate coefficient of a charge exchange record
+ *
+ * @details
+ * Records for which the ion being ionized is hydrogen give the
+ * recombination rate of the other ion; the others give an
+ * ionization rate, which includes the Boltzmann factor for the
+ * energy defect.  The fits are held constant outside the range
+ * of temperature for which they are valid.
+ *
+ **********************************************************/
+
+static double
+ch_ex_fit (int n, double t)
+{
+  Charge_exchange_ptr ce;
+  double tfit, rate;
+
+  ce = &charge_exchange[n];
+  tfit = t;
+  if (tfit < ce->tmin)
+    tfit = ce->tmin;
+  if (tfit > ce->tmax)
+    tfit = ce->tmax;
+
+  rate = ce->a * 1e-9 * pow (tfit / 1.0e4, ce->b) * (1. + ce->c * exp (ce->d * tfit / 1.0e4));
+
+  if (ion[ce->nion1].z != 1)
+    rate *= exp (-ce->delta_e_ovr_k * 1.0e4 / t);
+
+  return (rate);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Evaluate the fit for one of the rates
+ *
+ * @param [in] int  type   The rate, RATE_DR, RATE_TOTAL_RR, RATE_GS_RR, RATE_DI or RATE_CH_EX
+ * @param [in] int  n   The ion, or for RATE_CH_EX the charge exchange record
+ * @param [in] double  t   The electron temperature
+ * @return     The rate coefficient, or 0 if there is no data for the ion
+ *
+ **********************************************************/
+
+double
+rate_fit (type, n, t)
+     int type, n;
+     double t;
+{
+  switch (type)
+  {
+  case RATE_DR:
+    return (dr_fit (n, t));
+  case RATE_TOTAL_RR:
+    return (total_rr_fit (n, t));
+  case RATE_GS_RR:
+    return (gs_rr_fit (n, t));
+  case RATE_DI:
+    return (di_fit (n, t));
+  case RATE_CH_EX:
+    return (ch_ex_fit (n, t));
+  default:
+    Error ("rate_fit: Unknown type of rate %d\n", type);
+    Exit (0);
+  }
+
+  return (0.0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      The number of rows of the table for one of the rates
+ *
+ **********************************************************/
+
+static int
+rate_table_rows (int type)
+{
+  return ((type == RATE_CH_EX) ? n_charge_exchange : nions);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Evaluate all of the fits on a grid of temperatures
+ *
+ * @param [in] double  tmin   The lowest temperature in the tables
+ * @param [in] double  tmax   The highest temperature in the tables
+ * @param [in] int  ntemps   The number of temperatures, evenly spaced in log(T)
+ * @return     The total number of values in the tables
+ *
+ * @details
+ * This should be called after get_atomic_data.  Any tables which
+ * already exist are replaced.  RATE_TABLE_TMIN, RATE_TABLE_TMAX and
+ * RATE_TABLE_NTEMPS are reasonable values for the arguments.
+ *
+ * The tables are named rate_table_0 to rate_table_4, by type, so
+ * that they can be shared by the processes on a node.
+ *
+ **********************************************************/
+
+int
+build_rate_tables (tmin, tmax, ntemps)
+     double tmin, tmax;
+     int ntemps;
+{
+  char name[32];
+  double t, dlog_t;
+  int type, n, k, ntot;
+
+  if (ntemps < 2 || !(tmax > tmin) || tmin <= 0.0)
+  {
+    Error ("build_rate_tables: Cannot make tables of %d temperatures from %e to %e\n", ntemps, tmin, tmax);
+    Exit (0);
+  }
+
+  rate_tables.ntemps = ntemps;
+  rate_tables.log_t_min = log (tmin);
+  rate_tables.log_t_max = log (tmax);
+  dlog_t = (rate_tables.log_t_max - rate_tables.log_t_min) / (ntemps - 1);
+  rate_tables.scale = 1. / dlog_t;
+
+  ntot = 0;
+  for (type = 0; type < NRATE_TYPES; type++)
+  {
+    rate_tables.nrows[type] = rate_table_rows (type);
+
+    shared_free (rate_tables.rate[type]);
+    snprintf (name, sizeof (name), "rate_table_%d", type);
+    rate_tables.rate[type] = shared_calloc (name, (size_t) rate_tables.nrows[type] * ntemps + 1, sizeof (double));
+    if (rate_tables.rate[type] == NULL)
+    {
+      Error ("build_rate_tables: Could not allocate memory for %d x %d rates\n", rate_tables.nrows[type], ntemps);
+      Exit (0);
+    }
+
+    for (k = 0; k < ntemps; k++)
+    {
+      t = exp (rate_tables.log_t_min + k * dlog_t);
+      for (n = 0; n < rate_tables.nrows[type]; n++)
+      {
+        rate_tables.rate[type][n * ntemps + k] = rate_fit (type, n, t);
+      }
+    }
+    ntot += rate_tables.nrows[type] * ntemps;
+  }
+
+  Log ("build_rate_tables: Tabulated %d rates at %d temperatures from %.1e to %.1e K\n", ntot / ntemps, ntemps, tmin, tmax);
+
+  return (ntot);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find one of the rates for every ion at the temperatures of many cells
+ *
+ * @param [in] int  type   The rate, RATE_DR, RATE_TOTAL_RR, RATE_GS_RR, RATE_DI or RATE_CH_EX
+ * @param [in] int  ncells   The number of cells
+ * @param [in] double  t_e[]   The electron temperature of each cell
+ * @param [out] double  rates[]   The rates, with rates[n * ncells + i] for ion (or record) n in cell i
+ * @return     The number of ions (or records), so rates must have room for this times ncells values
+ *
+ * @details
+ * The position of each temperature in the table is found once, and
+ * the same position is used for every ion, interpolating linearly in
+ * log(T).  Temperatures outside the tables, or all of them if
+ * build_rate_tables has not been called, are dealt with by evaluating
+ * the fits.
+ *
+ **********************************************************/
+
+int
+rate_table_values (type, ncells, t_e, rates)
+     int type, ncells;
+     double t_e[], rates[];
+{
+  const double *row;
+  double *frac, x;
+  int *k;
+  int i, n, nrows, ntemps;
+
+  if (type < 0 || type >= NRATE_TYPES)
+  {
+    Error ("rate_table_values: Unknown type of rate %d\n", type);
+    Exit (0);
+  }
+
+  nrows = rate_table_rows (type);
+  ntemps = rate_tables.ntemps;
+  if (ntemps == 0 || rate_tables.nrows[type] != nrows)
+  {
+    for (n = 0; n < nrows; n++)
+    {
+      for (i = 0; i < ncells; i++)
+      {
+        rates[n * ncells + i] = rate_fit (type, n, t_e[i]);
+      }
+    }
+    return (nrows);
+  }
+
+  k = calloc (ncells, sizeof (int));
+  frac = calloc (ncells, sizeof (double));
+  if (k == NULL || frac == NULL)
+  {
+    Error ("rate_table_values: Could not allocate memory for %d cells\n", ncells);
+    Exit (0);
+  }
+
+  for (i = 0; i < ncells; i++)
+  {
+    x = (log (t_e[i]) - rate_tables.log_t_min) * rate_tables.scale;
+    if (!(x >= 0.0) || x > ntemps - 1)
+    {
+      k[i] = -1;
+      continue;
+    }
+    k[i] = (int) x;
+    if (k[i] > ntemps - 2)
+      k[i] = ntemps - 2;
+    frac[i] = x - k[i];
+  }
+
+  for (n = 0; n < nrows; n++)
+  {
+    row = &rate_tables.rate[type][n * ntemps];
+    for (i = 0; i < ncells; i++)
+    {
+      if (k[i] < 0)
+        rates[n * ncells + i] = rate_fit (type, n, t_e[i]);
+      else
+        rates[n * ncells + i] = row[k[i]] + frac[i] * (row[k[i] + 1] - row[k[i]]);
+    }
+  }
+
+  free (k);
+  free (frac);
+
+  return (nrows);
+}
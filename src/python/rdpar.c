@@ -36,6 +36,8 @@
  *  - int get_root(root,total) -- strips off the trailing characters in a .pf file
  *  	name.
  *  - int rdpar_set_mpi_rank(rank) -- passes the rank of the parallel process to rdpar
+ *  - int rdpar_set_broadcast(broadcast) -- if broadcast is 1, only rank 0 reads the
+ *  	parameter files, and sends their lines to the other ranks
  *  - int rdpar_set_verbosity  -- Control how much diagnostic information is printed out
  *  
  *  The file also contains a subroutine to put out a message of
@@ -144,6 +146,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <ctype.h>
+#include <mpi.h>
 
 #include "log.h"
 //OLD #inc "strict.h"
@@ -163,6 +166,7 @@ int verbose = 1;                /* verbose = 1 -> printout all errors
 char current_filename[LINELEN];
 
 int rd_rank = 0;                // rank of mpi process, set to zero
+int rdpar_broadcast = 0;        // 1 if rank 0 reads the parameter files and broadcasts them to the other ranks
 
 /* Array to record the actual values of rdpar accepted by rdpar.  All values are 
  * stored as strings */
@@ -191,14 +195,384 @@ struct rdpar_raw
 {
   char line[LINELEN];           // Raw input line 
   int icheck;                   // Check off to indicate a line has been used
+  char keyword[LINELEN];        // The first word of the line up to any (, in lower case, or empty if the line has no value
+  int next;                     // The next line with the same keyword, or -1
 }
 input[MAX_RECORDS];
 
+/* The input lines are found by hashing their keywords, so that each question
+   does not have to be compared with every line.  The table is open addressed,
+   and its size is a power of 2 more than twice the number of lines.  The
+   lines which begin with the old name of each synonym are also listed once,
+   when the lines are read. */
+
+#define RDPAR_HASH_SIZE 1024    // Slots in the table of keywords, > 2 * MAX_RECORDS
+#define RDPAR_HASH_BASIS 2166136261u
+
+int rdpar_keys[RDPAR_HASH_SIZE];        // For each slot, 1 + the first line with that keyword, or 0 for an empty slot
+int rdpar_nindexed = 0;         // The number of input lines which have been added to rdpar_keys
+int **rdpar_synonym_lines = NULL;       // For each synonym, the lines which begin with its old name
+int *rdpar_synonym_nlines = NULL;
+extern int number_of_names;     // The number of synonyms, from synonyms.c
+
 
 int strict = 0;                 // Initialize to a value that indicates everyting is OK
 
 
 
+/**********************************************************/
+/**
+ * @brief      Add a character to the hash of a keyword
+ *
+ * Starting from RDPAR_HASH_BASIS, this gives the FNV-1a hash of the
+ * keyword, and of each of its beginnings on the way.
+ *
+ **********************************************************/
+
+static unsigned int
+rdpar_hash_step (unsigned int hash, char c)
+{
+  return ((hash ^ (unsigned char) c) * 16777619u);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add the input lines which have been read since the last call to the index
+ *
+ * @details
+ * The keyword of each line is found in the same way as string_process_from_file
+ * used to when it compared every line with a question.  Lines without a
+ * value, or whose first word begins with (, are never matched and so are
+ * not added.
+ *
+ **********************************************************/
+
+static void
+rdpar_index_input (void)
+{
+  char firstword[LINELEN], secondword[LINELEN];
+  char *ccc;
+  int *synonyms;
+  int n, i, nwords, wordlength, slot, last, nsynonyms;
+  unsigned int hash;
+
+  if (rdpar_synonym_lines == NULL)
+  {
+    rdpar_synonym_lines = calloc (number_of_names, sizeof (int *));
+    rdpar_synonym_nlines = calloc (number_of_names, sizeof (int));
+    if (rdpar_synonym_lines == NULL || rdpar_synonym_nlines == NULL)
+    {
+      Error ("rdpar_index_input: Could not allocate memory for the synonyms\n");
+      exit (1);
+    }
+  }
+  if ((synonyms = calloc (number_of_names, sizeof (int))) == NULL)
+  {
+    Error ("rdpar_index_input: Could not allocate memory for the synonyms\n");
+    exit (1);
+  }
+
+  for (n = rdpar_nindexed; n < rdpar_ntot; n++)
+  {
+    input[n].keyword[0] = '\0';
+    input[n].next = -1;
+
+    strcpy (firstword, "");
+    strcpy (secondword, "");
+    nwords = sscanf (input[n].line, "%s %s", firstword, secondword);
+
+    wordlength = strlen (firstword);
+    if ((ccc = strchr (firstword, '(')) != NULL)
+      wordlength = (int) (ccc - firstword);
+    if (nwords < 2 || wordlength == 0)
+      continue;
+
+    hash = RDPAR_HASH_BASIS;
+    for (i = 0; i < wordlength; i++)
+    {
+      input[n].keyword[i] = tolower (firstword[i]);
+      hash = rdpar_hash_step (hash, input[n].keyword[i]);
+    }
+    input[n].keyword[wordlength] = '\0';
+
+    slot = hash & (RDPAR_HASH_SIZE - 1);
+    while (rdpar_keys[slot] != 0 && strcmp (input[rdpar_keys[slot] - 1].keyword, input[n].keyword) != 0)
+      slot = (slot + 1) & (RDPAR_HASH_SIZE - 1);
+
+    if (rdpar_keys[slot] == 0)
+      rdpar_keys[slot] = n + 1;
+    else
+    {
+      last = rdpar_keys[slot] - 1;
+      while (input[last].next >= 0)
+        last = input[last].next;
+      input[last].next = n;
+    }
+
+    nsynonyms = synonyms_for_input_line (input[n].line, synonyms);
+    for (i = 0; i < nsynonyms; i++)
+    {
+      if (rdpar_synonym_lines[synonyms[i]] == NULL
+          && (rdpar_synonym_lines[synonyms[i]] = calloc (MAX_RECORDS, sizeof (int))) == NULL)
+      {
+        Error ("rdpar_index_input: Could not allocate memory for the synonyms\n");
+        exit (1);
+      }
+      rdpar_synonym_lines[synonyms[i]][rdpar_synonym_nlines[synonyms[i]]++] = n;
+    }
+  }
+
+  rdpar_nindexed = rdpar_ntot;
+  free (synonyms);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the first unused input line which answers a question
+ *
+ * @param [in] char  question[]   The keyword and or question
+ * @param [out] int *  synonym   Set to 1 if the line only answers the question because
+ *   it begins with an old name for the keyword, 0 otherwise
+ * @return     The line, or rdpar_ntot if there is none
+ *
+ * @details
+ * A line answers a question if its keyword, ignoring case, is the beginning of
+ * the question, or if the line begins with an old name for the question.  Since
+ * keywords contain neither ( nor white space, each beginning of the question up
+ * to the first of these is looked up in the table.  When a line could
+ * answer the question both ways, it is only treated as a synonym if its
+ * keyword does not match the question exactly, including case, since
+ * that is the order in which the lines used to be checked.
+ *
+ **********************************************************/
+
+static int
+rdpar_find_line (question, synonym)
+     char question[];
+     int *synonym;
+{
+  char xquestion[LINELEN], firstword[LINELEN];
+  char *ccc;
+  int *synonyms;
+  int best, best_synonym, n, i, slot, nsynonyms, wordlength;
+  unsigned int hash;
+
+  best = rdpar_ntot;
+  hash = RDPAR_HASH_BASIS;
+  for (i = 0; i < LINELEN - 1 && question[i] != '\0' && question[i] != '(' && !isspace (question[i]); i++)
+  {
+    xquestion[i] = tolower (question[i]);
+    xquestion[i + 1] = '\0';
+    hash = rdpar_hash_step (hash, xquestion[i]);
+
+    slot = hash & (RDPAR_HASH_SIZE - 1);
+    while (rdpar_keys[slot] != 0 && strcmp (input[rdpar_keys[slot] - 1].keyword, xquestion) != 0)
+      slot = (slot + 1) & (RDPAR_HASH_SIZE - 1);
+
+    for (n = rdpar_keys[slot] - 1; n >= 0 && n < best; n = input[n].next)
+    {
+      if (input[n].icheck == UNUSED)
+      {
+        best = n;
+        break;
+      }
+    }
+  }
+
+  best_synonym = rdpar_ntot;
+  if ((synonyms = calloc (number_of_names, sizeof (int))) != NULL)
+  {
+    nsynonyms = synonyms_for_question (question, synonyms);
+    for (i = 0; i < nsynonyms; i++)
+    {
+      for (n = 0; n < rdpar_synonym_nlines[synonyms[i]]; n++)
+      {
+        if (rdpar_synonym_lines[synonyms[i]][n] >= best_synonym)
+          break;
+        if (input[rdpar_synonym_lines[synonyms[i]][n]].icheck == UNUSED)
+        {
+          best_synonym = rdpar_synonym_lines[synonyms[i]][n];
+          break;
+        }
+      }
+    }
+    free (synonyms);
+  }
+
+  *synonym = 0;
+  if (best_synonym < best)
+  {
+    best = best_synonym;
+    *synonym = 1;
+  }
+  else if (best_synonym == best && best < rdpar_ntot)
+  {
+    sscanf (input[best].line, "%s", firstword);
+    wordlength = strlen (firstword);
+    if ((ccc = strchr (firstword, '(')) != NULL)
+      wordlength = (int) (ccc - firstword);
+    *synonym = (strncmp (question, firstword, wordlength) != 0);
+  }
+
+  return (best);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Report whether lines of the file being read were dropped
+ *
+ * @param [in] char  filename[]   The name of the file
+ * @return     1 if rdin_ptr has lines left which did not fit in input, 0 otherwise
+ *
+ * @details
+ * This is called when all of the lines which fit have been read.  The
+ * questions in any lines which were dropped would be asked
+ * interactively, or answered at the end of the input, so this is an error.
+ *
+ **********************************************************/
+
+static int
+rdpar_check_truncated (char filename[])
+{
+  char extra[LINELEN];
+  int nextra;
+
+  nextra = 0;
+  while (fgets (extra, LINELEN, rdin_ptr) != NULL)
+    nextra++;
+
+  if (nextra > 0)
+  {
+    Error ("rdpar_read_file: At most %d lines of input can be kept, so the last %d lines of %s were dropped\n",
+           MAX_RECORDS, nextra, filename);
+    return (1);
+  }
+
+  return (0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find whether rank 0 reads the parameter files for the other ranks
+ *
+ * @param [out] int *  rank   The rank of this process in MPI_COMM_WORLD
+ * @return     The number of MPI processes, or 1 if rdpar_broadcast is not set
+ *             or MPI is not running
+ *
+ **********************************************************/
+
+static int
+rdpar_broadcast_size (int *rank)
+{
+  int mpi_on, mpi_done, n_mpi;
+
+  n_mpi = 1;
+  *rank = 0;
+  if (rdpar_broadcast)
+  {
+    MPI_Initialized (&mpi_on);
+    MPI_Finalized (&mpi_done);
+    if (mpi_on && !mpi_done)
+    {
+      MPI_Comm_rank (MPI_COMM_WORLD, rank);
+      MPI_Comm_size (MPI_COMM_WORLD, &n_mpi);
+    }
+  }
+
+  return (n_mpi);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add the lines of a parameter file to the input structure
+ *
+ * @param [in] char  filename[]   The name of the file
+ * @return     0 if the file was read, 1 if it could not be opened
+ *
+ * @details
+ * If rdpar_broadcast is set and there is more than one MPI process, rank 0
+ * reads the file and broadcasts whether it could be opened and how many
+ * lines it has, and then the lines themselves, so that the other ranks do
+ * not touch the file system.  Every rank then has the same input lines as
+ * if it had read the file itself.  No more than MAX_RECORDS lines are kept in all, and
+ * an error is logged if any lines of the file are dropped.
+ *
+ **********************************************************/
+
+static int
+rdpar_read_file (char filename[])
+{
+  struct rdpar_message
+  {
+    int status;
+    int nlines;
+    char line[MAX_RECORDS][LINELEN];
+  } *msg;
+  int rank, n;
+
+  if (rdpar_broadcast_size (&rank) == 1)
+  {
+    if ((rdin_ptr = fopen (filename, "r")) == NULL)
+      return (1);
+    while (rdpar_ntot < MAX_RECORDS && fgets (input[rdpar_ntot].line, LINELEN, rdin_ptr) != NULL)
+    {
+      input[rdpar_ntot].icheck = UNUSED;
+      rdpar_ntot++;
+    }
+    rdpar_check_truncated (filename);
+    fclose (rdin_ptr);
+    return (0);
+  }
+
+  if ((msg = calloc (1, sizeof (struct rdpar_message))) == NULL)
+  {
+    Error ("rdpar_read_file: Could not allocate memory to broadcast %s\n", filename);
+    exit (1);
+  }
+
+  if (rank == 0)
+  {
+    if ((rdin_ptr = fopen (filename, "r")) == NULL)
+      msg->status = 1;
+    else
+    {
+      while (rdpar_ntot + msg->nlines < MAX_RECORDS && fgets (msg->line[msg->nlines], LINELEN, rdin_ptr) != NULL)
+        msg->nlines++;
+      rdpar_check_truncated (filename);
+      fclose (rdin_ptr);
+    }
+  }
+
+  /* Send the status and the number of lines first, so that only the
+     lines which were read are sent, not the whole buffer */
+
+  MPI_Bcast (msg, 2, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast (msg->line, msg->nlines * LINELEN, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+  for (n = 0; n < msg->nlines; n++)
+  {
+    memcpy (input[rdpar_ntot].line, msg->line[n], LINELEN);
+    input[rdpar_ntot].icheck = UNUSED;
+    rdpar_ntot++;
+  }
+  n = msg->status;
+  free (msg);
+
+  return (n);
+}
+
+
+
 /**********************************************************/
 /** 
  * @brief      Open a parameter file for reading
@@ -224,7 +598,6 @@ int
 opar (filename)
      char filename[];
 {
-  FILE *fopen (), *tmp_ptr;
   int rdpar_init ();
 
   /* Check that an input file is not currently open */
@@ -236,7 +609,7 @@ opar (filename)
 
   /*Open a temporary output file */
   rdpar_init ();
-  if ((tmp_ptr = fopen (filename, "r")) == NULL)
+  if (rdpar_read_file (filename))
   {
     printf ("Error: opar: Could not open filename %s\n", filename);
     printf ("               Proceeding in interactive mode\n");
@@ -244,14 +617,8 @@ opar (filename)
   }
   else
   {
-    rdin_ptr = tmp_ptr;
     rdpar_stat = 2;             /* implies we are now trying to read from a file */
-    while (fgets (input[rdpar_ntot].line, LINELEN, rdin_ptr) != NULL)
-    {
-      input[rdpar_ntot].icheck = UNUSED;
-      rdpar_ntot++;
-    }
-    fclose (rdin_ptr);
+    rdpar_index_input ();
   }
   strcpy (current_filename, filename);
 
@@ -302,18 +669,13 @@ add_par (filename)
     return (rdpar_stat);
   }
 
-  if ((rdin_ptr = fopen (filename, "r")) == NULL)
+  if (rdpar_read_file (filename))
   {
     printf ("Error: add_par: Could not additional file %s\n", filename);
     return (rdpar_stat);
   }
 
-  while (fgets (input[rdpar_ntot].line, LINELEN, rdin_ptr) != NULL)
-  {
-    input[rdpar_ntot].icheck = UNUSED;
-    rdpar_ntot++;
-  }
-  fclose (rdin_ptr);
+  rdpar_index_input ();
 
 
   return (rdpar_stat);
@@ -382,7 +744,8 @@ cpar (filename)
  * ###Notes###
  *
  * Storing information in a temporaray file prevents overwriting 
- * a permannt one before one is ready.
+ * a permannt one before one is ready.  With rdpar_broadcast, ranks
+ * other than 0 write to /dev/null, since only rank 0 keeps the file.
  *
  **********************************************************/
 
@@ -390,10 +753,20 @@ int
 rdpar_init ()
 {
   FILE *fopen ();
+  char *outname;
+  int rank;
+
+  /* When rank 0 reads the parameter files for everyone, only it writes
+     tmp.rdpar, so that the other ranks do not create the same file */
+
+  outname = "tmp.rdpar";
+  if (rdpar_broadcast_size (&rank) > 1 && rank != 0)
+    outname = "/dev/null";
+
   rdin_ptr = stdin;             /* Initialize rdin_ptr to standard input */
-  if ((rdout_ptr = fopen ("tmp.rdpar", "w")) == NULL)
+  if ((rdout_ptr = fopen (outname, "w")) == NULL)
   {
-    printf ("Error: rdpar_init: Problem opening tmp.rdpar\n");
+    printf ("Error: rdpar_init: Problem opening %s\n", outname);
     exit (1);
   }
   rdpar_stat = 1;
@@ -556,6 +929,10 @@ string_process_from_command_line (question, dummy)
  * 	If the value for the keyword in the input list is a $, then
  * 	the user will be queried for that value interactively.
  *
+ * 	The lines are looked up by their keywords in the index made
+ * 	by rdpar_index_input when the file is read, so the time this
+ * 	takes does not grow with the length of the file.
+ *
  **********************************************************/
 
 int
@@ -564,85 +941,40 @@ string_process_from_file (question, dummy)
 {
 
   char firstword[LINELEN], secondword[LINELEN];
-  char *line, *fgets_rc;
-  char *ccc, *index (), *fgets ();
+  char *fgets_rc;
   int nwords = 0;               // Initialise to avoid warning
-  int wordlength;
-  char xfirstword[LINELEN], xquestion[LINELEN];
-  int i;
+  int synonym, n;
 
-  for (rdpar_cursor = 0; rdpar_cursor < rdpar_ntot; rdpar_cursor++)
-  {
-    if (input[rdpar_cursor].icheck == USED)
-    {
-      continue;
-    }
+  // Find the line with the keyword, indexing any lines which have been read since the last question
 
-    line = input[rdpar_cursor].line;
-
-    // Parse the first two words of the input line
-
-    strcpy (firstword, "");
-    strcpy (secondword, "");
-    nwords = sscanf (line, "%s %s", firstword, secondword);
+  if (rdpar_nindexed < rdpar_ntot)
+  {
+    rdpar_index_input ();
+  }
 
-    wordlength = strlen (firstword);
-    if (nwords < 2 || wordlength == 0)
-    {
-      continue;                 // Read the next line in the file
-    }
+  rdpar_cursor = rdpar_find_line (question, &synonym);
 
-    // Strip off everthing in paren
-    if ((ccc = index (firstword, '(')) != NULL)
+  // Print a warning for each of the lines before it which did not match
+  if (verbose > 1 && rd_rank == 0)
+  {
+    for (n = 0; n < rdpar_cursor; n++)
     {
-      wordlength = (int) (ccc - firstword);
-      if (wordlength == 0)
+      if (input[n].icheck == UNUSED && input[n].keyword[0] != '\0')
       {
-        continue;
+        sscanf (input[n].line, "%s", firstword);
+        printf ("Warning:  Question (%s) does not match word (%s) in file. Continuing!\n", question, firstword);
       }
     }
+  }
 
+  /* Check for synonyms - That is look for keywords in the file we are reading 
+   * that have been replaced by a new keyword
+   */
 
-    // If there is a match go to the section that handles the various possibilities
-
-    if (strncmp (question, firstword, wordlength) == 0)
-    {
-      break;                    // We have matched the keywords
-    }
-
-
-
-    /* Check for synonyms - That is look for keywords in the file we are reading 
-     * that have been replaced by a new keyword
-     */
-
-    if (is_input_line_synonym_for_question (question, line))
-    {
-      strict = 1;
-      Error ("Had to parse a synonym. Program will stop after writing out a new parameter file\n");
-      break;
-    }
-
-    strncpy (xquestion, question, wordlength);
-    strncpy (xfirstword, firstword, wordlength);
-    for (i = 0; i < wordlength; i++)
-    {
-      xquestion[i] = tolower (xquestion[i]);
-      xfirstword[i] = tolower (xfirstword[i]);
-    }
-
-
-    if (strncmp (xquestion, xfirstword, wordlength) == 0)
-    {
-      break;                    // We have matched the keywords
-    }
-
-
-
-
-    // Print a warning if the lines do not match
-    if (verbose > 1 && rd_rank == 0)
-      printf ("Warning:  Question (%s) does not match word (%s) in file. Continuing!\n", question, firstword);
+  if (rdpar_cursor < rdpar_ntot && synonym)
+  {
+    strict = 1;
+    Error ("Had to parse a synonym. Program will stop after writing out a new parameter file\n");
   }
 
   // Handle the EOF since we were not successful in identifying the keyword
@@ -659,6 +991,9 @@ string_process_from_file (question, dummy)
   }
   else
   {
+    strcpy (firstword, "");
+    strcpy (secondword, "");
+    nwords = sscanf (input[rdpar_cursor].line, "%s %s", firstword, secondword);
     input[rdpar_cursor].icheck = USED;
     rdpar_cursor++;             // This is needed because we have already processed the earlier line
   }
@@ -1478,6 +1813,33 @@ rdpar_set_mpi_rank (rank)
 }
 
 
+/**********************************************************/
+/** 
+ * @brief      Choose whether rank 0 reads the parameter files for all of the ranks
+ *
+ * @param [in] int  broadcast   1 if rank 0 is to read the files and broadcast them, 0
+ *    if each rank reads them
+ * @return     0
+ *
+ * ###Notes###
+ *
+ * This must be called with the same value on every rank, after MPI_Init and
+ * before opar, since opar and add_par then have to be called by every rank.
+ * The answers to the rd routines are the same either way, but when
+ * thousands of ranks start at once this avoids them all opening the same
+ * file.
+ *
+ **********************************************************/
+
+int
+rdpar_set_broadcast (broadcast)
+     int broadcast;
+{
+  rdpar_broadcast = broadcast;
+  return (0);
+}
+
+
 
 /**********************************************************/
 /** 
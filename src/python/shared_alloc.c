@@ -0,0 +1,994 @@
+
+/***********************************************************/
+/** @file  shared_alloc.c
+ *
+ * @brief  Allocate tables which the MPI processes on a node share
+ *
+ * The tables of atomic data are the same in every process, so when
+ * many processes run on one node they need only one copy.  Each table
+ * is allocated with shared_calloc, which gives it a name.  One process
+ * on each node, the loader, reads the data into the tables as if they
+ * were private, and then all of the processes call shared_publish.  This
+ * moves the tables into MPI shared memory windows, and the processes
+ * then find where each table is with shared_lookup.
+ *
+ * - shared_init(mode)	Choose whether the tables are shared by each node, SHARED_NODE, by each
+ *			NUMA domain, SHARED_NUMA, or not at all, SHARED_PRIVATE, and with
+ *			SHARED_BCAST whether they are read once for all of the nodes
+ * - shared_init_posix(key)	Share the tables between independent processes instead
+ * - shared_get_mode()	How the tables are shared
+ * - shared_loader()	1 if this process should read the data
+ * - shared_nprocs()	The number of processes which share the tables
+ * - shared_calloc(name, count, size)	Allocate a table
+ * - shared_realloc(ptr, count, size)	Resize a table
+ * - shared_free(ptr)	Free a table
+ * - shared_publish()	Move the tables into shared memory
+ * - shared_lookup(name)	Find a table
+ * - shared_bcast(buf, size)	Send anything else from the loader to the other processes
+ * - shared_release()	Free all of the tables
+ *
+ * Until shared_init is called, or if the tables are private, these
+ * behave like calloc, realloc and free, and shared_publish does nothing.
+ *
+ * A table which has been published must not be changed, resized or
+ * freed, except by shared_release.  Since a table is at a different
+ * address in each process, it must not contain pointers, either to
+ * itself or to other tables.
+ *
+ * On a node with more than one NUMA domain, usually one for each socket,
+ * a table shared by the whole node is in the memory of one domain, and
+ * the processes in the others read it more slowly.  With SHARED_NUMA
+ * each domain has its own copy, which costs one copy of the tables per
+ * domain rather than per node.  The domain of a process is the one its
+ * CPU is in when shared_init is called, so the processes should be bound
+ * to their cores, or at least to their domains, e.g. with mpirun --bind-to.
+ *
+ * When there are many nodes, having a loader read the data on each one
+ * means many processes reading the same files at once.  If SHARED_BCAST
+ * is added to the mode, only rank 0 of MPI_COMM_WORLD reads the data,
+ * and shared_publish sends its tables, packed into one buffer, to the
+ * first process on each node or NUMA domain, which then shares them as
+ * if it had read them itself.
+ *
+ * Processes which are not in the same MPI job, such as many runs of a
+ * program with one process each, can share the tables with
+ * shared_init_posix, SHARED_POSIX.  The tables are put in one POSIX
+ * shared memory segment, named by a key which should identify the data,
+ * see atomic_data_fingerprint.  The first process to open the segment
+ * holds a lock on it while it reads the data and publishes the tables,
+ * and the processes which open it later wait for the lock and then map
+ * the tables read only.  The processes using the segment are counted by
+ * each holding a shared flock on it, and the last one to release it, the
+ * one which can take an exclusive flock, removes it.  Since the locks go
+ * when a process exits, the segment is removed even if processes are
+ * killed, as long as one releases it.  There is no MPI communication,
+ * so shared_bcast cannot be used.
+ *
+ ***********************************************************/
+
+#define _GNU_SOURCE             // For sched_getcpu
+
+#include <mpi.h>
+#include <sched.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "atomic.h"
+#include "log.h"
+#include "atomic_proto.h"
+
+#define SHARED_NAME_LEN 32
+#define SHARED_KEY_LEN 256
+#define SHARED_MAGIC "python tables 1"     // Written to a segment once it is complete
+#define SHARED_ALIGN 64         // The alignment of each table in a segment
+
+typedef struct shared_block
+{
+  char name[SHARED_NAME_LEN];   // The name by which processes which did not allocate the table find it
+  size_t size;                  // The size of the table in bytes
+  void *ptr;                    // The address of the table in this process
+  int published;                // 1 once the table is in shared memory
+  MPI_Win win;                  // The window holding the table once it is published
+} shared_block_dummy, *SharedBlockPtr;
+
+static int shared_mode = SHARED_PRIVATE;
+static MPI_Comm shared_comm;    // The processes which share the tables, those on one node or NUMA domain
+static int shared_rank = 0;     // The rank in shared_comm; the loader is rank 0
+static int shared_size = 1;
+static int shared_reads = 1;    // 1 if this process reads the data
+static int shared_from_root = 0;        // 1 with SHARED_BCAST, when only rank 0 of MPI_COMM_WORLD reads the data
+static MPI_Comm shared_leader_comm = MPI_COMM_NULL;     // With SHARED_BCAST, rank 0 in each shared_comm
+
+static SharedBlockPtr shared_blocks = NULL;     // The tables, in the order they were allocated
+static int shared_nblocks = 0;
+static int shared_nblocks_max = 0;
+
+/* A POSIX shared memory segment starts with a header, followed by the
+   name, offset and size of each table, and then the tables themselves */
+
+typedef struct shared_segment_header
+{
+  char magic[16];               // SHARED_MAGIC once the tables have all been written
+  int ntables;
+  size_t size;                  // The size of the segment in bytes
+} shared_segment_header_dummy;
+
+typedef struct shared_segment_table
+{
+  char name[SHARED_NAME_LEN];
+  size_t offset;                // From the start of the segment
+  size_t size;
+} shared_segment_table_dummy;
+
+static char shared_key[SHARED_KEY_LEN]; // The name of the segment
+static int shared_fd = -1;      // The segment, which this process holds a lock on
+static void *shared_map = NULL; // Where the segment is mapped, once it is complete
+static size_t shared_map_size = 0;
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the NUMA domain of the CPU this process is running on
+ *
+ * @return     The number of the domain, or 0 if it cannot be found
+ *
+ * ###Notes###
+ *
+ * The directory of each CPU in /sys/devices/system/cpu contains a link
+ * called nodeN to the domain N which it is in.  There is no link if the
+ * kernel was built without NUMA support, in which case there is only
+ * one domain.
+ *
+ **********************************************************/
+
+static int
+shared_numa_domain (void)
+{
+  char dirname[64];
+  DIR *dir;
+  struct dirent *entry;
+  int cpu, domain;
+
+  if ((cpu = sched_getcpu ()) < 0)
+    return (0);
+
+  snprintf (dirname, sizeof (dirname), "/sys/devices/system/cpu/cpu%d", cpu);
+  if ((dir = opendir (dirname)) == NULL)
+    return (0);
+
+  domain = 0;
+  while ((entry = readdir (dir)) != NULL)
+  {
+    if (strncmp (entry->d_name, "node", 4) == 0 && sscanf (entry->d_name + 4, "%d", &domain) == 1)
+      break;
+    domain = 0;
+  }
+  closedir (dir);
+
+  return (domain);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Choose which processes share the tables
+ *
+ * @param [in] int  mode   SHARED_NODE to share the tables between the processes on each node,
+ *                         SHARED_NUMA between those in each NUMA domain, or SHARED_PRIVATE
+ *                         to give each process its own, plus SHARED_BCAST to have only rank 0
+ *                         read the data
+ * @return     1 if this process should read the data into the tables, 0 otherwise
+ *
+ * ###Notes###
+ *
+ * With SHARED_NODE or SHARED_NUMA this is collective over MPI_COMM_WORLD,
+ * which is split into a communicator for each node, and with SHARED_NUMA
+ * each of these is split again by the NUMA domain of each process.  With
+ * SHARED_BCAST the first process in each of these also joins a
+ * communicator of the leaders, over which the tables are sent.  If
+ * MPI is not running, the tables are private whatever the mode.  Any
+ * tables which have already been allocated should be released first.
+ * Use shared_init_posix for SHARED_POSIX.  The number of processes on
+ * this node which read the data is left in atomicdata_node_readers, so
+ * that they can divide the processors between their threads.
+ *
+ **********************************************************/
+
+int
+shared_init (mode)
+     int mode;
+{
+  MPI_Comm node_comm;
+  int mpi_on, mpi_done, node_rank, world_rank, bcast;
+
+  if (shared_mode == SHARED_NODE || shared_mode == SHARED_NUMA)
+    MPI_Comm_free (&shared_comm);
+  if (shared_leader_comm != MPI_COMM_NULL)
+    MPI_Comm_free (&shared_leader_comm);
+
+  shared_mode = SHARED_PRIVATE;
+  shared_rank = 0;
+  shared_size = 1;
+  shared_reads = 1;
+  shared_from_root = 0;
+  atomicdata_node_readers = 0;
+
+  bcast = mode & SHARED_BCAST;
+  mode &= ~SHARED_BCAST;
+  if (mode != SHARED_PRIVATE && mode != SHARED_NODE && mode != SHARED_NUMA)
+  {
+    Error ("shared_init: Unknown mode %d, so the tables will be private\n", mode);
+    return (1);
+  }
+
+  MPI_Initialized (&mpi_on);
+  MPI_Finalized (&mpi_done);
+  if (mode != SHARED_PRIVATE && mpi_on && !mpi_done)
+  {
+    MPI_Comm_split_type (MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    if (mode == SHARED_NUMA)
+    {
+      MPI_Comm_rank (node_comm, &node_rank);
+      MPI_Comm_split (node_comm, shared_numa_domain (), node_rank, &shared_comm);
+    }
+    else
+    {
+      MPI_Comm_dup (node_comm, &shared_comm);
+    }
+    MPI_Comm_rank (shared_comm, &shared_rank);
+    MPI_Comm_size (shared_comm, &shared_size);
+    shared_mode = mode;
+    shared_reads = (shared_rank == 0);
+
+    /* Rank 0 of MPI_COMM_WORLD is rank 0 of its node and domain, since
+       the processes keep their order when the communicators are split */
+
+    if (bcast)
+    {
+      MPI_Comm_rank (MPI_COMM_WORLD, &world_rank);
+      MPI_Comm_split (MPI_COMM_WORLD, shared_rank == 0 ? 0 : MPI_UNDEFINED, world_rank, &shared_leader_comm);
+      shared_reads = (world_rank == 0);
+      shared_from_root = 1;
+    }
+
+    /* The processes which read the data share the processors of the node
+       between their threads */
+
+    MPI_Allreduce (&shared_reads, &atomicdata_node_readers, 1, MPI_INT, MPI_SUM, node_comm);
+    MPI_Comm_free (&node_comm);
+  }
+
+  return (shared_reads);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Take or give up the lock which the loader holds while it fills a segment
+ *
+ * @details
+ * This is a record lock, from fcntl, which is separate from the lock
+ * taken with flock which counts the processes using the segment.
+ *
+ **********************************************************/
+
+static int
+shared_build_lock (int type)
+{
+  struct flock lock;
+
+  memset (&lock, 0, sizeof (lock));
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+
+  return (fcntl (shared_fd, F_SETLKW, &lock));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Share the tables with other processes through a POSIX shared memory segment
+ *
+ * @param [in] char *  key   The name of the segment, which must start with a / and identify the data
+ * @return     1 if this process should read the data into the tables, 0 if it can use the tables already there
+ *
+ * ###Notes###
+ *
+ * If no complete segment has the name, this process becomes the loader,
+ * and holds the lock for filling the segment until shared_publish, so
+ * any other process which calls this with the same key waits for it.
+ * Otherwise the segment is mapped read only, and shared_publish finds
+ * the tables in it.  If the segment cannot be opened, the tables are
+ * private.  Any tables which have already been allocated should be
+ * released first.
+ *
+ **********************************************************/
+
+int
+shared_init_posix (key)
+     char *key;
+{
+  struct stat sb;
+  shared_segment_header_dummy *header;
+
+  shared_init (SHARED_PRIVATE);
+
+  strncpy (shared_key, key, SHARED_KEY_LEN - 1);
+  shared_key[SHARED_KEY_LEN - 1] = '\0';
+  if ((shared_fd = shm_open (shared_key, O_RDWR | O_CREAT, 0600)) < 0)
+  {
+    Error ("shared_init_posix: Could not open shared memory %s, so the tables will be private\n", shared_key);
+    return (1);
+  }
+
+  flock (shared_fd, LOCK_SH);
+  shared_build_lock (F_WRLCK);
+  shared_mode = SHARED_POSIX;
+
+  if (fstat (shared_fd, &sb) == 0 && sb.st_size >= (off_t) sizeof (shared_segment_header_dummy))
+  {
+    header = mmap (NULL, sb.st_size, PROT_READ, MAP_SHARED, shared_fd, 0);
+    if (header != MAP_FAILED && strncmp (header->magic, SHARED_MAGIC, sizeof (header->magic)) == 0
+        && header->size == (size_t) sb.st_size)
+    {
+      shared_build_lock (F_UNLCK);
+      shared_map = header;
+      shared_map_size = sb.st_size;
+      shared_rank = 1;
+      shared_reads = 0;
+      return (0);
+    }
+
+    /* The loader which began the segment did not finish it, so start again */
+
+    Error ("shared_init_posix: %s is incomplete, so the data will be read again\n", shared_key);
+    if (header != MAP_FAILED)
+      munmap (header, sb.st_size);
+  }
+
+  if (ftruncate (shared_fd, 0) != 0)
+    Error ("shared_init_posix: Could not empty %s\n", shared_key);
+  shared_rank = 0;
+  shared_reads = 1;
+
+  return (1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find out how the tables are shared
+ *
+ * @return     SHARED_PRIVATE, SHARED_NODE, SHARED_NUMA or SHARED_POSIX
+ *
+ * SHARED_NODE or SHARED_NUMA are only returned if MPI is running, and
+ * without SHARED_BCAST, even if it was given to shared_init.
+ *
+ **********************************************************/
+
+int
+shared_get_mode ()
+{
+  return (shared_mode);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find out whether this process should read the data into the tables
+ *
+ * @return     1 for the loader, which is one process on each node or NUMA domain, or only rank 0
+ *             with SHARED_BCAST, or every process if the tables are private
+ *
+ **********************************************************/
+
+int
+shared_loader ()
+{
+  return (shared_reads);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find out how many processes share the tables
+ *
+ * @return     The number of processes on this node or NUMA domain if the tables are shared, otherwise 1
+ *
+ **********************************************************/
+
+int
+shared_nprocs ()
+{
+  return (shared_size);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the most recent table with a given address or name
+ *
+ **********************************************************/
+
+static SharedBlockPtr
+shared_find (const void *ptr, const char *name)
+{
+  int n;
+
+  for (n = shared_nblocks - 1; n >= 0; n--)
+  {
+    if (ptr != NULL && shared_blocks[n].ptr == ptr)
+      return (&shared_blocks[n]);
+    if (name != NULL && strncmp (shared_blocks[n].name, name, SHARED_NAME_LEN - 1) == 0)
+      return (&shared_blocks[n]);
+  }
+
+  return (NULL);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add a table to the list, returning the entry
+ *
+ **********************************************************/
+
+static SharedBlockPtr
+shared_add (const char *name, void *ptr, size_t size)
+{
+  SharedBlockPtr blocks, block;
+  int nmax;
+
+  if (shared_nblocks == shared_nblocks_max)
+  {
+    nmax = (shared_nblocks_max > 0) ? 2 * shared_nblocks_max : 64;
+    if ((blocks = realloc (shared_blocks, nmax * sizeof (shared_block_dummy))) == NULL)
+      return (NULL);
+    shared_blocks = blocks;
+    shared_nblocks_max = nmax;
+  }
+
+  block = &shared_blocks[shared_nblocks++];
+  memset (block, 0, sizeof (shared_block_dummy));
+  strncpy (block->name, name, SHARED_NAME_LEN - 1);
+  block->ptr = ptr;
+  block->size = size;
+
+  return (block);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Allocate a table which may be shared
+ *
+ * @param [in] char *  name   The name of the table, which must be the same in every process
+ * @param [in] size_t  count   The number of entries in the table
+ * @param [in] size_t  size   The size of each entry
+ * @return     The table, filled with zeros, or NULL if it could not be allocated
+ *
+ * ###Notes###
+ *
+ * The table is private until shared_publish is called.  If a table
+ * which has not been published already has the name, it is forgotten,
+ * but not freed, so the caller can still copy from it and free it.
+ *
+ **********************************************************/
+
+void *
+shared_calloc (name, count, size)
+     char *name;
+     size_t count, size;
+{
+  SharedBlockPtr block;
+  void *ptr;
+
+  if ((ptr = calloc (count > 0 ? count : 1, size)) == NULL)
+    return (NULL);
+
+  if ((block = shared_find (NULL, name)) != NULL && !block->published)
+  {
+    block->ptr = ptr;
+    block->size = count * size;
+  }
+  else if (shared_add (name, ptr, count * size) == NULL)
+  {
+    free (ptr);
+    return (NULL);
+  }
+
+  return (ptr);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Change the size of a table which has not been published
+ *
+ * @param [in] void *  ptr   The table
+ * @param [in] size_t  count   The new number of entries
+ * @param [in] size_t  size   The size of each entry
+ * @return     The table, which may have moved, or NULL if it could not be resized
+ *
+ * Memory which was not allocated by shared_calloc is simply reallocated.
+ *
+ **********************************************************/
+
+void *
+shared_realloc (ptr, count, size)
+     void *ptr;
+     size_t count, size;
+{
+  SharedBlockPtr block;
+  void *new_ptr;
+
+  if ((block = shared_find (ptr, NULL)) == NULL || ptr == NULL)
+    return (realloc (ptr, count * size));
+
+  if (block->published)
+  {
+    Error ("shared_realloc: %s is shared and cannot be resized\n", block->name);
+    return (NULL);
+  }
+
+  if ((new_ptr = realloc (ptr, count > 0 ? count * size : size)) == NULL)
+    return (NULL);
+
+  block->ptr = new_ptr;
+  block->size = count * size;
+
+  return (new_ptr);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Free a table which has not been published
+ *
+ * @param [in] void *  ptr   The table, or NULL
+ *
+ * A table which has been published is left until shared_release, since
+ * all of the processes which share it have to free it together.  Memory
+ * which was not allocated by shared_calloc is simply freed.
+ *
+ **********************************************************/
+
+void
+shared_free (ptr)
+     void *ptr;
+{
+  SharedBlockPtr block;
+
+  if (ptr == NULL)
+    return;
+
+  if ((block = shared_find (ptr, NULL)) == NULL)
+  {
+    free (ptr);
+    return;
+  }
+
+  if (block->published)
+    return;
+
+  free (ptr);
+  memmove (block, block + 1, (&shared_blocks[shared_nblocks] - (block + 1)) * sizeof (shared_block_dummy));
+  shared_nblocks--;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Move the tables into the POSIX shared memory segment, or find them there
+ *
+ * @details
+ * The loader lays the tables out in the segment, copies them into it and
+ * frees its private copies, and only then marks the segment complete and
+ * lets the processes waiting for it in, by giving up the lock for filling
+ * it.  The other processes list the tables in the segment they mapped in
+ * shared_init_posix.
+ *
+ **********************************************************/
+
+static int
+shared_publish_posix (int first)
+{
+  shared_segment_header_dummy *header;
+  shared_segment_table_dummy *tables;
+  SharedBlockPtr block;
+  size_t size;
+  char *map;
+  int n, nnew;
+
+  if (shared_rank != 0)
+  {
+    if (shared_nblocks > 0)     // The tables have already been listed
+      return (0);
+    header = shared_map;
+    tables = (shared_segment_table_dummy *) (header + 1);
+    for (n = 0; n < header->ntables; n++)
+    {
+      if ((block = shared_add (tables[n].name, (char *) shared_map + tables[n].offset, tables[n].size)) == NULL)
+      {
+        Error ("shared_publish: Could not record table %s\n", tables[n].name);
+        Exit (0);
+      }
+      block->published = 1;
+    }
+    return (header->ntables);
+  }
+
+  nnew = shared_nblocks - first;
+  if (shared_map != NULL)
+  {
+    Error ("shared_publish: The tables in %s have already been published, so %d more will be private\n", shared_key,
+           nnew);
+    return (0);
+  }
+
+  size = sizeof (shared_segment_header_dummy) + nnew * sizeof (shared_segment_table_dummy);
+  for (n = first; n < shared_nblocks; n++)
+    size = (size + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN + shared_blocks[n].size;
+
+  if (ftruncate (shared_fd, size) != 0
+      || (map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shared_fd, 0)) == MAP_FAILED)
+  {
+    Error ("shared_publish: Could not make %s %zu bytes long, so the tables will be private\n", shared_key, size);
+    return (0);
+  }
+
+  header = (shared_segment_header_dummy *) map;
+  tables = (shared_segment_table_dummy *) (header + 1);
+  size = sizeof (shared_segment_header_dummy) + nnew * sizeof (shared_segment_table_dummy);
+  for (n = 0; n < nnew; n++)
+  {
+    block = &shared_blocks[first + n];
+    size = (size + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN;
+    strncpy (tables[n].name, block->name, SHARED_NAME_LEN);
+    tables[n].offset = size;
+    tables[n].size = block->size;
+    memcpy (map + size, block->ptr, block->size);
+    free (block->ptr);
+    block->ptr = map + size;
+    block->published = 1;
+    size += block->size;
+  }
+
+  header->ntables = nnew;
+  header->size = size;
+  __sync_synchronize ();
+  memcpy (header->magic, SHARED_MAGIC, sizeof (SHARED_MAGIC));
+
+  mprotect (map, size, PROT_READ);
+  shared_map = map;
+  shared_map_size = size;
+  shared_build_lock (F_UNLCK);
+
+  return (nnew);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Broadcast a buffer which may be larger than an int can count
+ *
+ **********************************************************/
+
+static void
+shared_bcast_bytes (char *buf, size_t size, MPI_Comm comm)
+{
+  const size_t chunk = 1 << 30;
+  size_t sent;
+
+  for (sent = 0; sent < size; sent += chunk)
+    MPI_Bcast (buf + sent, (int) (size - sent < chunk ? size - sent : chunk), MPI_BYTE, 0, comm);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Send the tables read by rank 0 to the leaders of the other nodes
+ *
+ * @details
+ * This is collective over shared_leader_comm.  Rank 0 packs the tables
+ * which it has not published into one buffer, which is sent with the
+ * names and sizes of the tables.  Each of the other leaders unpacks the
+ * buffer into private tables, as if it had read them, so that they can
+ * be published on its node.
+ *
+ **********************************************************/
+
+static void
+shared_send_to_leaders (void)
+{
+  SharedBlockPtr list;
+  size_t total, offset;
+  int n, first, nnew, leader_rank;
+  char *buf;
+  void *ptr;
+
+  Trace_begin ("shared_send_to_leaders");
+
+  MPI_Comm_rank (shared_leader_comm, &leader_rank);
+  for (first = shared_nblocks; first > 0 && !shared_blocks[first - 1].published; first--);
+
+  nnew = shared_nblocks - first;
+  MPI_Bcast (&nnew, 1, MPI_INT, 0, shared_leader_comm);
+
+  if ((list = calloc (nnew > 0 ? nnew : 1, sizeof (shared_block_dummy))) == NULL)
+  {
+    Error ("shared_publish: Could not allocate memory for %d tables\n", nnew);
+    Exit (0);
+  }
+  if (leader_rank == 0)
+    memcpy (list, &shared_blocks[first], nnew * sizeof (shared_block_dummy));
+  MPI_Bcast (list, nnew * sizeof (shared_block_dummy), MPI_BYTE, 0, shared_leader_comm);
+
+  for (total = 0, n = 0; n < nnew; n++)
+    total += list[n].size;
+
+  if ((buf = malloc (total > 0 ? total : 1)) == NULL)
+  {
+    Error ("shared_publish: Could not allocate %zu bytes to send the tables\n", total);
+    Exit (0);
+  }
+
+  if (leader_rank == 0)
+  {
+    for (offset = 0, n = 0; n < nnew; n++)
+    {
+      memcpy (buf + offset, list[n].ptr, list[n].size);
+      offset += list[n].size;
+    }
+  }
+
+  shared_bcast_bytes (buf, total, shared_leader_comm);
+
+  if (leader_rank != 0)
+  {
+    for (offset = 0, n = 0; n < nnew; n++)
+    {
+      if ((ptr = malloc (list[n].size > 0 ? list[n].size : 1)) == NULL || shared_add (list[n].name, ptr, list[n].size) == NULL)
+      {
+        Error ("shared_publish: Could not allocate memory for table %s\n", list[n].name);
+        Exit (0);
+      }
+      memcpy (ptr, buf + offset, list[n].size);
+      offset += list[n].size;
+    }
+  }
+
+  free (buf);
+  free (list);
+
+  Trace_end ("shared_send_to_leaders");
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Move the tables which the loader has filled into shared memory
+ *
+ * @return     The number of tables which were moved
+ *
+ * ###Notes###
+ *
+ * This is collective over the processes on the node, other than with
+ * SHARED_POSIX, when the processes call it independently.  The loader sends
+ * the names and sizes of its tables which have not been published, and
+ * for each a window is allocated on the loader, the table is copied into
+ * it, and the private copy is freed.  The other processes find the window
+ * with MPI_Win_shared_query.  All of the tables can be read by every
+ * process once this returns, and their addresses found with shared_lookup.
+ *
+ * With SHARED_BCAST, the tables are first sent from rank 0 of
+ * MPI_COMM_WORLD to the loaders of the other nodes, so this is collective
+ * over all of the processes.
+ *
+ * Tables which have not been published are always at the end of the list,
+ * since they are added there and are published in order.
+ *
+ **********************************************************/
+
+int
+shared_publish ()
+{
+  SharedBlockPtr block, list;
+  MPI_Aint window_size;
+  int n, first, nnew, disp_unit;
+  void *base;
+
+  if (shared_mode == SHARED_PRIVATE)
+    return (0);
+
+  if (shared_leader_comm != MPI_COMM_NULL)
+    shared_send_to_leaders ();
+
+  for (first = shared_nblocks; first > 0 && !shared_blocks[first - 1].published; first--);
+
+  if (shared_rank != 0 && first < shared_nblocks)
+  {
+    Error ("shared_publish: %d tables allocated by a process which is not the loader will be freed\n",
+           shared_nblocks - first);
+    for (n = first; n < shared_nblocks; n++)
+      free (shared_blocks[n].ptr);
+    shared_nblocks = first;
+  }
+
+  if (shared_mode == SHARED_POSIX)
+    return (shared_publish_posix (first));
+
+  nnew = shared_nblocks - first;
+  MPI_Bcast (&nnew, 1, MPI_INT, 0, shared_comm);
+
+  if ((list = calloc (nnew > 0 ? nnew : 1, sizeof (shared_block_dummy))) == NULL)
+  {
+    Error ("shared_publish: Could not allocate memory for %d tables\n", nnew);
+    Exit (0);
+  }
+  if (shared_rank == 0)
+    memcpy (list, &shared_blocks[first], nnew * sizeof (shared_block_dummy));
+  MPI_Bcast (list, nnew * sizeof (shared_block_dummy), MPI_BYTE, 0, shared_comm);
+
+  for (n = 0; n < nnew; n++)
+  {
+    if (shared_rank == 0)
+      block = &shared_blocks[first + n];
+    else if ((block = shared_add (list[n].name, NULL, list[n].size)) == NULL)
+    {
+      Error ("shared_publish: Could not record table %s\n", list[n].name);
+      Exit (0);
+    }
+
+    window_size = (shared_rank == 0) ? (MPI_Aint) block->size : 0;
+    MPI_Win_allocate_shared (window_size, 1, MPI_INFO_NULL, shared_comm, &base, &block->win);
+    if (shared_rank == 0)
+    {
+      memcpy (base, block->ptr, block->size);
+      free (block->ptr);
+    }
+    else
+    {
+      MPI_Win_shared_query (block->win, 0, &window_size, &disp_unit, &base);
+    }
+    MPI_Win_fence (0, block->win);
+
+    block->ptr = base;
+    block->published = 1;
+  }
+
+  free (list);
+
+  return (nnew);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find a table by name
+ *
+ * @param [in] char *  name   The name given to shared_calloc
+ * @return     The address of the table in this process, or NULL if there is no such table
+ *
+ **********************************************************/
+
+void *
+shared_lookup (name)
+     char *name;
+{
+  SharedBlockPtr block;
+
+  if ((block = shared_find (NULL, name)) == NULL)
+    return (NULL);
+
+  return (block->ptr);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Send a buffer from the loader to the other processes on the node
+ *
+ * @param [in, out] void *  buf   The buffer
+ * @param [in] int  size   The size of the buffer in bytes
+ * @return     1 if the buffer was sent, 0 if the tables are private or shared with SHARED_POSIX
+ *
+ * This is collective over the processes on the node, or all of the
+ * processes with SHARED_BCAST, and is used for the values which go with
+ * the tables, such as the number of entries.
+ *
+ **********************************************************/
+
+int
+shared_bcast (buf, size)
+     void *buf;
+     int size;
+{
+  if (shared_mode == SHARED_PRIVATE || shared_mode == SHARED_POSIX)
+    return (0);
+
+  if (shared_from_root)
+    MPI_Bcast (buf, size, MPI_BYTE, 0, MPI_COMM_WORLD);
+  else
+    MPI_Bcast (buf, size, MPI_BYTE, 0, shared_comm);
+
+  return (1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Free all of the tables
+ *
+ * @return     The number of tables which were freed
+ *
+ * This is collective over the processes on the node if any tables have
+ * been published, and must be called before MPI_Finalize.  With
+ * SHARED_POSIX the segment is removed if no other process is using it,
+ * and the tables are private afterwards.
+ *
+ **********************************************************/
+
+int
+shared_release ()
+{
+  int n, nfreed;
+
+  nfreed = shared_nblocks;
+  for (n = shared_nblocks - 1; n >= 0; n--)
+  {
+    if (!shared_blocks[n].published)
+      free (shared_blocks[n].ptr);
+    else if (shared_mode != SHARED_POSIX)
+      MPI_Win_free (&shared_blocks[n].win);
+  }
+
+  free (shared_blocks);
+  shared_blocks = NULL;
+  shared_nblocks = shared_nblocks_max = 0;
+
+  /* The last process using a segment, which is the only one which can
+     lock it exclusively, removes it */
+
+  if (shared_fd >= 0)
+  {
+    if (shared_map != NULL)
+      munmap (shared_map, shared_map_size);
+    if (flock (shared_fd, LOCK_EX | LOCK_NB) == 0)
+      shm_unlink (shared_key);
+    close (shared_fd);
+    shared_fd = -1;
+    shared_map = NULL;
+    shared_map_size = 0;
+    shared_mode = SHARED_PRIVATE;
+    shared_rank = 0;
+  }
+
+  return (nfreed);
+}
@@ -0,0 +1,218 @@
+
+/***********************************************************/
+/** @file  shared_reduce.c
+ *
+ * @brief  Sum arrays, such as the estimators, over the MPI processes
+ * in two levels, first on each node and then between the nodes
+ *
+ * In Python each process accumulates its own copy of the estimators,
+ * which are summed with MPI_Allreduce over every process at the end of
+ * each cycle.  Here the processes on a node instead accumulate into
+ * slices of one MPI shared memory window.  Those processes sum the
+ * slices together, each doing part of the array, and then only one
+ * process on each node, the leader, takes part in the MPI_Allreduce
+ * between the nodes.  So the messages between the nodes are the same
+ * size, but there is one for each node rather than each process.
+ *
+ * - shared_reduce_init(nprocs, n)	Set up the window for arrays of n values
+ * - shared_reduce_slice()	The array this process accumulates into
+ * - shared_reduce_sum()	Sum the arrays of all of the processes
+ * - shared_reduce_free()	Free the window
+ *
+ * The slice of each process is in memory which it allocated itself,
+ * so on a node with more than one NUMA domain it is in the domain of
+ * the process which writes to it.  Each process writes only to its own
+ * slice, so no atomic operations are needed while it accumulates.
+ *
+ ***********************************************************/
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atomic.h"
+#include "log.h"
+#include "atomic_proto.h"
+
+static int reduce_active = 0;   // 1 while this process has a window
+static int reduce_n = 0;        // The number of values in each array
+static MPI_Comm reduce_comm;    // The processes which take part in the sum
+static MPI_Comm reduce_node_comm;       // Those on the same node as this one
+static MPI_Comm reduce_leader_comm;     // The leader of each node, or MPI_COMM_NULL if this is not a leader
+static int reduce_node_rank = 0;
+static int reduce_node_size = 1;
+static MPI_Win reduce_win;
+static double **reduce_slices = NULL;   // The slice of each process on the node
+static double *reduce_result = NULL;    // The sum, after the slice of the leader
+
+
+
+/**********************************************************/
+/**
+ * @brief      Set up a shared window in which arrays can be summed over the processes
+ *
+ * @param [in] int  nprocs   The number of processes which take part, or 0 for all of them
+ * @param [in] int  n   The number of values in each array
+ * @return     1 if this process takes part in the sum, 0 otherwise
+ *
+ * ###Notes###
+ *
+ * This is collective over MPI_COMM_WORLD.  The processes which take part
+ * are the first nprocs in MPI_COMM_WORLD, so that the sum can be timed
+ * with fewer processes than there are.  The slice of each process is
+ * filled with zeros.  A window which has already been set up is freed.
+ *
+ **********************************************************/
+
+int
+shared_reduce_init (nprocs, n)
+     int nprocs, n;
+{
+  MPI_Aint window_size;
+  int world_rank, world_size, disp_unit, rank;
+  double *base;
+
+  shared_reduce_free ();
+
+  MPI_Comm_rank (MPI_COMM_WORLD, &world_rank);
+  MPI_Comm_size (MPI_COMM_WORLD, &world_size);
+  if (nprocs <= 0 || nprocs > world_size)
+    nprocs = world_size;
+
+  MPI_Comm_split (MPI_COMM_WORLD, world_rank < nprocs ? 0 : MPI_UNDEFINED, world_rank, &reduce_comm);
+  if (reduce_comm == MPI_COMM_NULL)
+    return (0);
+
+  MPI_Comm_split_type (reduce_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &reduce_node_comm);
+  MPI_Comm_rank (reduce_node_comm, &reduce_node_rank);
+  MPI_Comm_size (reduce_node_comm, &reduce_node_size);
+  MPI_Comm_split (reduce_comm, reduce_node_rank == 0 ? 0 : MPI_UNDEFINED, world_rank, &reduce_leader_comm);
+
+  if ((reduce_slices = calloc (reduce_node_size, sizeof (double *))) == NULL)
+  {
+    Error ("shared_reduce_init: Could not allocate memory for %d slices\n", reduce_node_size);
+    Exit (0);
+  }
+
+  /* The leader also holds the sum, after its own slice */
+
+  window_size = (MPI_Aint) n * sizeof (double) * (reduce_node_rank == 0 ? 2 : 1);
+  MPI_Win_allocate_shared (window_size, sizeof (double), MPI_INFO_NULL, reduce_node_comm, &base, &reduce_win);
+  memset (base, 0, window_size);
+
+  for (rank = 0; rank < reduce_node_size; rank++)
+    MPI_Win_shared_query (reduce_win, rank, &window_size, &disp_unit, &reduce_slices[rank]);
+  reduce_result = reduce_slices[0] + n;
+
+  MPI_Win_fence (0, reduce_win);
+
+  reduce_n = n;
+  reduce_active = 1;
+
+  return (1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find the array which this process accumulates into
+ *
+ * @return     The slice of this process, or NULL if it does not take part
+ *
+ **********************************************************/
+
+double *
+shared_reduce_slice ()
+{
+  if (!reduce_active)
+    return (NULL);
+
+  return (reduce_slices[reduce_node_rank]);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Sum the arrays of all of the processes which take part
+ *
+ * @return     The sum, which is in shared memory and must not be changed, or NULL
+ *             if this process does not take part
+ *
+ * ###Notes###
+ *
+ * This is collective over the processes which take part.  Each process
+ * on a node sums one part of the array over the slices of that node, and
+ * then the leaders add the sums of the nodes together.  The sum can be
+ * read until the next call, and the slices are left as they were, so
+ * they should be set to zero before they are used again.
+ *
+ **********************************************************/
+
+double *
+shared_reduce_sum ()
+{
+  int first, last, rank, j;
+  double *slice;
+
+  if (!reduce_active)
+    return (NULL);
+
+  MPI_Win_fence (0, reduce_win);
+
+  first = (int) ((long) reduce_n * reduce_node_rank / reduce_node_size);
+  last = (int) ((long) reduce_n * (reduce_node_rank + 1) / reduce_node_size);
+
+  memcpy (&reduce_result[first], &reduce_slices[0][first], (last - first) * sizeof (double));
+  for (rank = 1; rank < reduce_node_size; rank++)
+  {
+    slice = reduce_slices[rank];
+    for (j = first; j < last; j++)
+      reduce_result[j] += slice[j];
+  }
+
+  MPI_Win_fence (0, reduce_win);
+
+  if (reduce_leader_comm != MPI_COMM_NULL)
+    MPI_Allreduce (MPI_IN_PLACE, reduce_result, reduce_n, MPI_DOUBLE, MPI_SUM, reduce_leader_comm);
+
+  MPI_Win_fence (0, reduce_win);
+
+  return (reduce_result);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Free the window
+ *
+ * @return     1 if a window was freed, 0 otherwise
+ *
+ * This is collective over the processes which take part.
+ *
+ **********************************************************/
+
+int
+shared_reduce_free ()
+{
+  if (!reduce_active)
+    return (0);
+
+  MPI_Win_free (&reduce_win);
+  free (reduce_slices);
+  reduce_slices = NULL;
+  reduce_result = NULL;
+
+  if (reduce_leader_comm != MPI_COMM_NULL)
+    MPI_Comm_free (&reduce_leader_comm);
+  MPI_Comm_free (&reduce_node_comm);
+  MPI_Comm_free (&reduce_comm);
+
+  reduce_active = 0;
+  reduce_n = 0;
+
+  return (1);
+}
@@ -226,9 +226,9 @@ are_synonym_lists_valid ()
  *
  * ###Notes###
  *
- * It would be much more efficient to do this in file input
- * rather than checking the synonym status of every line for
- * every parameter.
+ * rdpar no longer uses this, but finds the synonyms for each input
+ * line once, with synonyms_for_input_line, and the synonyms for each
+ * question with synonyms_for_question.
  *
  **********************************************************/
 
@@ -265,3 +265,80 @@ is_input_line_synonym_for_question (question, input_line)
   // If we've not found a match, then this line *isn't* a synonym
   return (0);
 }
+
+
+
+/**********************************************************/
+/**
+ * @brief  Find the synonyms whose old name begins an input line
+ *
+ * @param [in] char  input_line[]   A line of a parameter file
+ * @param [out] int  synonyms[]   The synonyms which were found, which must
+ *   have room for number_of_names entries
+ * @return  The number of synonyms which were found
+ *
+ * The old names are matched in the same way as in
+ * is_input_line_synonym_for_question, so a line which begins with the
+ * old name of synonym i is a synonym for any question for which
+ * synonyms_for_question finds i.
+ *
+ **********************************************************/
+
+int
+synonyms_for_input_line (input_line, synonyms)
+     char input_line[];
+     int synonyms[];
+{
+  int synonym_index, nsynonyms;
+
+  if (!synonyms_validated)
+  {
+    synonyms_validated = are_synonym_lists_valid ();
+  }
+
+  nsynonyms = 0;
+  for (synonym_index = 0; synonym_index < number_of_names; synonym_index++)
+  {
+    if (!strncmp (old_names[synonym_index], input_line, get_question_name_length (old_names[synonym_index])))
+    {
+      synonyms[nsynonyms++] = synonym_index;
+    }
+  }
+  return (nsynonyms);
+}
+
+
+/**********************************************************/
+/**
+ * @brief  Find the synonyms whose new name is the question being asked
+ *
+ * @param [in] char  question[]   The current keyword
+ * @param [out] int  synonyms[]   The synonyms which were found, which must
+ *   have room for number_of_names entries
+ * @return  The number of synonyms which were found
+ *
+ **********************************************************/
+
+int
+synonyms_for_question (question, synonyms)
+     char question[];
+     int synonyms[];
+{
+  int synonym_index, nsynonyms;
+  int question_name_length = get_question_name_length (question);
+
+  if (!synonyms_validated)
+  {
+    synonyms_validated = are_synonym_lists_valid ();
+  }
+
+  nsynonyms = 0;
+  for (synonym_index = 0; synonym_index < number_of_names; synonym_index++)
+  {
+    if (!strncmp (new_names[synonym_index], question, question_name_length))
+    {
+      synonyms[nsynonyms++] = synonym_index;
+    }
+  }
+  return (nsynonyms);
+}
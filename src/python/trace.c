@@ -0,0 +1,309 @@
+
+/***********************************************************/
+/** @file  trace.c
+ *
+ * @brief  Record when each phase of a run begins and ends, and write
+ * the record as a trace which can be viewed with chrome://tracing or
+ * Perfetto
+ *
+ * Tracing is off unless Trace_init is called with the name of a file.
+ * While it is off, Trace_begin and Trace_end, which are macros in
+ * log.h, only check trace_enabled, so the calls can be left in the code.
+ *
+ * - Trace_init(filename)	Start tracing, and write the trace to filename at exit
+ * - Trace_begin(name)		Record the beginning of a phase
+ * - Trace_end(name)		Record the end of the phase which began last in this thread
+ * - Trace_write()		Write the trace
+ *
+ * The name of a phase must be a string which lasts until the trace is
+ * written, normally a string constant, since only the pointer is kept.
+ * Phases in one thread must be nested.  Each thread records its events
+ * in its own buffers, so threads do not wait for each other.
+ *
+ * The process of each event is the MPI rank, and when there is more
+ * than one rank each writes its own file, with the rank appended to
+ * the name.
+ *
+ ***********************************************************/
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "log.h"
+
+#undef Trace_begin
+#undef Trace_end
+
+#define LINELENGTH 256
+#define TRACE_CHUNK 4096        // Events in each buffer
+
+typedef struct trace_event
+{
+  const char *name;             // The name of the phase
+  double ts;                    // Microseconds since tracing began
+  char phase;                   // 'B' at the beginning of a phase and 'E' at its end
+} trace_event_dummy;
+
+typedef struct trace_buffer
+{
+  trace_event_dummy event[TRACE_CHUNK];
+  int nevents;
+  int tid;                      // The thread which owns the buffer, numbered from 0
+  struct trace_buffer *next;    // The next buffer in trace_buffers
+} trace_buffer_dummy, *TraceBufferPtr;
+
+int trace_enabled = 0;          // 1 while events are being recorded
+
+static char trace_file[LINELENGTH];
+static int trace_rank = 0;
+static struct timespec trace_start;
+static int trace_exit_registered = 0;
+
+static TraceBufferPtr trace_buffers = NULL;     // All of the buffers, linked through next
+static __thread TraceBufferPtr trace_my_buffer = NULL;  // The buffer this thread is filling
+static __thread int trace_my_tid = -1;
+static int trace_ntids = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;  // Held while a buffer is added to trace_buffers
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write the trace when the program exits
+ *
+ **********************************************************/
+
+static void
+trace_write_at_exit (void)
+{
+  Trace_write ();
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Start recording a trace
+ *
+ * @param [in] char *  filename   The file the trace is written to, or NULL
+ * @return     1 if tracing has begun, 0 if not
+ *
+ * ###Notes###
+ *
+ * Nothing is done if filename is NULL or empty, so that the name can be
+ * taken straight from, for example, getenv.  If MPI is in use this should
+ * be called after MPI_Init, so that the rank is known.  The trace is
+ * written when the program exits, or can be written with Trace_write.
+ *
+ **********************************************************/
+
+int
+Trace_init (filename)
+     char *filename;
+{
+  int mpi_on, mpi_done, n_mpi;
+
+  if (filename == NULL || filename[0] == '\0')
+    return (0);
+
+  n_mpi = 1;
+  MPI_Initialized (&mpi_on);
+  MPI_Finalized (&mpi_done);
+  if (mpi_on && !mpi_done)
+  {
+    MPI_Comm_rank (MPI_COMM_WORLD, &trace_rank);
+    MPI_Comm_size (MPI_COMM_WORLD, &n_mpi);
+  }
+
+  if (n_mpi > 1)
+    snprintf (trace_file, LINELENGTH, "%s.%d", filename, trace_rank);
+  else
+    snprintf (trace_file, LINELENGTH, "%s", filename);
+
+  clock_gettime (CLOCK_MONOTONIC, &trace_start);
+
+  if (!trace_exit_registered)
+  {
+    atexit (trace_write_at_exit);
+    trace_exit_registered = 1;
+  }
+
+  trace_enabled = 1;
+
+  return (1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add an event to the buffer of the calling thread
+ *
+ **********************************************************/
+
+static int
+trace_record (const char *name, char phase)
+{
+  TraceBufferPtr buffer;
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+
+  if ((buffer = trace_my_buffer) == NULL || buffer->nevents == TRACE_CHUNK)
+  {
+    if ((buffer = calloc (1, sizeof (trace_buffer_dummy))) == NULL)
+      return (0);
+
+    pthread_mutex_lock (&trace_lock);
+    if (trace_my_tid < 0)
+      trace_my_tid = trace_ntids++;
+    buffer->tid = trace_my_tid;
+    buffer->next = trace_buffers;
+    trace_buffers = buffer;
+    pthread_mutex_unlock (&trace_lock);
+
+    trace_my_buffer = buffer;
+  }
+
+  buffer->event[buffer->nevents].name = name;
+  buffer->event[buffer->nevents].ts = 1e6 * (now.tv_sec - trace_start.tv_sec) + 1e-3 * (now.tv_nsec - trace_start.tv_nsec);
+  buffer->event[buffer->nevents].phase = phase;
+  buffer->nevents++;
+
+  return (1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Record the beginning of a phase
+ *
+ * @param [in] const char *  name   The name of the phase, which must last until the trace is written
+ * @return     1 if the event was recorded, 0 otherwise
+ *
+ **********************************************************/
+
+int
+Trace_begin (name)
+     const char *name;
+{
+  if (!trace_enabled)
+    return (0);
+
+  return (trace_record (name, 'B'));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Record the end of a phase
+ *
+ * @param [in] const char *  name   The name of the phase
+ * @return     1 if the event was recorded, 0 otherwise
+ *
+ * The phase which ends is the one which began most recently in the
+ * calling thread; the name is only there to make the code readable.
+ *
+ **********************************************************/
+
+int
+Trace_end (name)
+     const char *name;
+{
+  if (!trace_enabled)
+    return (0);
+
+  return (trace_record (name, 'E'));
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write a string into a JSON file, escaping quotes and backslashes
+ *
+ **********************************************************/
+
+static void
+trace_write_string (FILE *fptr, const char *s)
+{
+  fputc ('"', fptr);
+  for (; *s != '\0'; s++)
+  {
+    if (*s == '"' || *s == '\\')
+      fputc ('\\', fptr);
+    fputc (*s, fptr);
+  }
+  fputc ('"', fptr);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write the trace in the Chrome trace event format
+ *
+ * @return     The number of events which were written
+ *
+ * ###Notes###
+ *
+ * Tracing stops once the trace has been written.  This is called when
+ * the program exits, so there is nothing to do if it has already been
+ * written.  Other threads should have finished recording events.
+ *
+ **********************************************************/
+
+int
+Trace_write ()
+{
+  FILE *fptr;
+  TraceBufferPtr buffer;
+  int n, nwritten;
+
+  if (!trace_enabled)
+    return (0);
+  trace_enabled = 0;
+
+  if ((fptr = fopen (trace_file, "w")) == NULL)
+  {
+    Error ("Trace_write: Could not open %s\n", trace_file);
+    return (0);
+  }
+
+  fprintf (fptr, "{\"traceEvents\":[\n");
+  fprintf (fptr, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"rank %d\"}}",
+           trace_rank, trace_rank);
+  for (n = 0; n < trace_ntids; n++)
+    fprintf (fptr, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+             trace_rank, n, n);
+
+  nwritten = 0;
+  for (buffer = trace_buffers; buffer != NULL; buffer = buffer->next)
+  {
+    for (n = 0; n < buffer->nevents; n++)
+    {
+      fprintf (fptr, ",\n{\"name\":");
+      trace_write_string (fptr, buffer->event[n].name);
+      fprintf (fptr, ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", buffer->event[n].phase, buffer->event[n].ts,
+               trace_rank, buffer->tid);
+      nwritten++;
+    }
+  }
+  fprintf (fptr, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  fclose (fptr);
+
+  while ((buffer = trace_buffers) != NULL)
+  {
+    trace_buffers = buffer->next;
+    free (buffer);
+  }
+  trace_my_buffer = NULL;
+
+  return (nwritten);
+}
@@ -58,6 +58,10 @@
  *							the write staatement, it should be easy to grep debug statements out of the log files
  *
  *
+ *  The messages for the diag file are formatted by the thread which logs them, but are written to the file by a 
+ *  separate writer thread, so that logging does not wait for the file system.  Log_flush and Exit write out 
+ *  everything which has been logged, as does a normal exit or a crash.
+ *
  *  For errors, the logging routines keep track of how many times a particular error has been reported, using the format 
  *  statement as a proxy for the error.  After a certin number of times a particular error has been roported the error is
  *  no longer written out to the diag file, but the routens still keep trank of the nubmer of times the error is reported.
@@ -89,20 +93,22 @@
 #include <string.h>
 #include <stdarg.h>
 #include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "log.h"
 
 #define LINELENGTH 256
 #define NERROR_MAX 500          // Number of different errors that are recorded
 
-/* definitions of what is logged at what verbosity level */
+/* The functions are defined here, not the macros in log.h which call them */
 
-#define SHOW_PARALLEL	    1
-#define SHOW_ERROR	    2
-#define SHOW_LOG  	    3
-#define SHOW_DEBUG	    4
-#define SHOW_LOG_SILENT     5
-#define SHOW_ERROR_SILENT   5
+#undef Debug
+#undef Log_silent
 
 
 int my_rank = 0;                // rank of mpi process, set to zero
@@ -123,11 +129,435 @@ ErrorPtr errorlog;
 
 int nerrors;
 
+/* The errors are found by hashing, first on the address of the format
+   statement, which is nearly always a string constant, and then on the
+   text of the format statement.  Both tables are open addressed, and
+   their sizes are powers of 2 more than twice the number of entries. */
+
+#define ERROR_HASH_SIZE 1024    // Slots in the table of error descriptions, > 2 * NERROR_MAX
+#define ERROR_FORMAT_SIZE 2048  // Slots in the table of format addresses
+#define ERROR_FORMAT_MAX 1024   // Number of format addresses that are remembered
+
+typedef struct error_format
+{
+  char *format;                 // The address of a format statement, NULL for an empty slot
+  int n;                        // The error in errorlog with that format
+} error_format_dummy;
+
+int *error_by_description;      // For each slot, 1 + the error in errorlog, or 0 for an empty slot
+error_format_dummy *error_by_format;
+int nerror_formats;
+
 FILE *diagptr;
 int init_log = 0;
 int log_verbosity = 5;          // A parameter which can be used to suppress what would normally be logged or printed
 
 
+/* Messages for the diag file are formatted by the thread which logs them
+   into a ring buffer belonging to that thread, and written to the file by
+   a writer thread, so that threads doing calculations do not wait for the
+   file system.  Each message carries a sequence number, and the writer
+   writes them in that order, so the file is the same as if the messages
+   had been written directly. */
+
+#define LOG_RING_SIZE 65536     // Bytes in the ring buffer of each thread; must be a power of 2
+#define LOG_MESSAGE_MAX 1024    // Messages up to this length are formatted on the stack
+#define LOG_WRITER_SLEEP_NS 20000000    // How long the writer thread sleeps if it is not woken
+
+typedef struct log_record
+{
+  unsigned long seq;            // The order in which the message was logged
+  unsigned long len;            // The number of characters in the message, which follows the record
+} log_record_dummy;
+
+typedef struct log_ring
+{
+  char buf[LOG_RING_SIZE];
+  unsigned long head;           // Bytes ever added, only changed by the thread which owns the ring
+  unsigned long tail;           // Bytes ever removed, only changed while holding log_consumer_lock
+  struct log_ring *next;        // The next ring in log_rings
+} log_ring_dummy, *LogRingPtr;
+
+static LogRingPtr log_rings = NULL;     // All of the rings, linked through next
+static __thread LogRingPtr log_my_ring = NULL;  // The ring of this thread
+static pthread_mutex_t log_rings_lock = PTHREAD_MUTEX_INITIALIZER;      // Held while a ring is added to log_rings
+
+static pthread_mutex_t log_consumer_lock = PTHREAD_MUTEX_INITIALIZER;   // Held while messages are written to diagptr
+static pthread_cond_t log_writer_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t log_writer_thread;
+static int log_writer_running = 0;
+static int log_writer_stop = 0;
+static int log_handlers_installed = 0;
+
+static unsigned long log_next_seq = 0;  // The sequence number of the next message to be logged
+static unsigned long log_next_write = 0;        // The sequence number of the next message to be written
+static volatile sig_atomic_t log_crashing = 0;  // 1 once log_crash has begun, so that stdio is not used
+
+#define LOG_DRAIN_ALL ((unsigned long) -1)
+
+
+
+/**********************************************************/
+/**
+ * @brief      Copy bytes into a ring, allowing for wrapping around its end
+ *
+ **********************************************************/
+
+static void
+log_ring_write (LogRingPtr ring, unsigned long pos, const void *src, unsigned long n)
+{
+  unsigned long start = pos & (LOG_RING_SIZE - 1);
+  unsigned long first = (n < LOG_RING_SIZE - start) ? n : LOG_RING_SIZE - start;
+
+  memcpy (&ring->buf[start], src, first);
+  memcpy (ring->buf, (const char *) src + first, n - first);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Copy bytes out of a ring, allowing for wrapping around its end
+ *
+ **********************************************************/
+
+static void
+log_ring_read (LogRingPtr ring, unsigned long pos, void *dst, unsigned long n)
+{
+  unsigned long start = pos & (LOG_RING_SIZE - 1);
+  unsigned long first = (n < LOG_RING_SIZE - start) ? n : LOG_RING_SIZE - start;
+
+  memcpy (dst, &ring->buf[start], first);
+  memcpy ((char *) dst + first, ring->buf, n - first);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write part of a message to the diag file
+ *
+ * @details
+ * When the program is crashing this goes straight to the file
+ * descriptor with write, which is safe in a signal handler, rather
+ * than through stdio.
+ *
+ **********************************************************/
+
+static void
+log_emit (const char *buf, unsigned long n)
+{
+  ssize_t nwritten;
+
+  if (!log_crashing)
+  {
+    fwrite (buf, 1, n, diagptr);
+    return;
+  }
+
+  while (n > 0)
+  {
+    if ((nwritten = write (fileno (diagptr), buf, n)) < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    buf += nwritten;
+    n -= nwritten;
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write the messages in the rings to the diag file
+ *
+ * @param [in] int  strict   If 1, write the messages strictly in sequence, waiting for any
+ *    message which has been numbered but has not yet been put in its ring
+ * @param [in] unsigned long  upto   Stop before writing the message with this sequence number,
+ *    or LOG_DRAIN_ALL to write everything in the rings
+ *
+ * The caller must hold log_consumer_lock.
+ *
+ **********************************************************/
+
+static void
+log_drain (int strict, unsigned long upto)
+{
+  LogRingPtr ring, first;
+  log_record_dummy record, first_record;
+  unsigned long head, len, pos, chunk;
+
+  while (log_next_write != upto)
+  {
+    first = NULL;
+    for (ring = __atomic_load_n (&log_rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+    {
+      head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+      if (ring->tail == head)
+        continue;
+      log_ring_read (ring, ring->tail, &record, sizeof (record));
+      if (first == NULL || record.seq < first_record.seq)
+      {
+        first = ring;
+        first_record = record;
+      }
+    }
+
+    if (first == NULL && (!strict || upto == LOG_DRAIN_ALL))
+      return;
+
+    if (first == NULL || (strict && first_record.seq != log_next_write))
+    {
+      /* The next message has been numbered, but its thread has not yet put it in its ring */
+      sched_yield ();
+      continue;
+    }
+
+    pos = first->tail + sizeof (record);
+    len = first_record.len;
+    while (len > 0)
+    {
+      chunk = LOG_RING_SIZE - (pos & (LOG_RING_SIZE - 1));
+      if (chunk > len)
+        chunk = len;
+      log_emit (&first->buf[pos & (LOG_RING_SIZE - 1)], chunk);
+      pos += chunk;
+      len -= chunk;
+    }
+
+    __atomic_store_n (&first->tail, pos, __ATOMIC_RELEASE);
+    log_next_write = first_record.seq + 1;
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      The writer thread, which writes the messages in the rings to the diag file
+ *
+ **********************************************************/
+
+static void *
+log_writer (void *arg)
+{
+  struct timespec wake;
+
+  pthread_mutex_lock (&log_consumer_lock);
+  while (!log_writer_stop)
+  {
+    log_drain (1, LOG_DRAIN_ALL);
+    fflush (diagptr);
+
+    clock_gettime (CLOCK_REALTIME, &wake);
+    wake.tv_nsec += LOG_WRITER_SLEEP_NS;
+    if (wake.tv_nsec >= 1000000000)
+    {
+      wake.tv_sec++;
+      wake.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait (&log_writer_wake, &log_consumer_lock, &wake);
+  }
+  log_drain (1, LOG_DRAIN_ALL);
+  fflush (diagptr);
+  pthread_mutex_unlock (&log_consumer_lock);
+
+  return (arg);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write whatever is in the rings if the program crashes, and then crash
+ *
+ * @details
+ * The rings are only drained if log_consumer_lock can be taken, since
+ * the writer thread, or the thread which crashed, may be part of the
+ * way through writing to the diag file.  Everything else which uses
+ * diagptr holds that lock, so once it is taken no thread can be inside
+ * stdio for diagptr, and what stdio has buffered is flushed before the
+ * rest is written with write.
+ *
+ **********************************************************/
+
+static void
+log_crash (int sig)
+{
+  if (init_log && pthread_mutex_trylock (&log_consumer_lock) == 0)
+  {
+    fflush (diagptr);
+    log_crashing = 1;
+    log_drain (0, LOG_DRAIN_ALL);
+  }
+  signal (sig, SIG_DFL);
+  raise (sig);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Stop the writer thread, after it has written everything in the rings
+ *
+ **********************************************************/
+
+static void
+log_writer_finish (void)
+{
+  if (!log_writer_running)
+    return;
+
+  pthread_mutex_lock (&log_consumer_lock);
+  log_writer_stop = 1;
+  pthread_cond_signal (&log_writer_wake);
+  pthread_mutex_unlock (&log_consumer_lock);
+
+  pthread_join (log_writer_thread, NULL);
+  log_writer_running = 0;
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Start the writer thread once the diag file is open
+ *
+ * ###Notes###
+ *
+ * If the thread cannot be started, messages are written to the file by
+ * the thread which logs them.  Whatever is in the rings is written when
+ * the program exits normally, and if it is killed by one of the signals
+ * for a crash, unless someone else is already handling that signal.
+ *
+ **********************************************************/
+
+static void
+log_writer_start (void)
+{
+  struct sigaction action, old;
+  int crash_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+  int n;
+
+  if (!log_handlers_installed)
+  {
+    atexit (log_writer_finish);
+    memset (&action, 0, sizeof (action));
+    action.sa_handler = log_crash;
+    sigemptyset (&action.sa_mask);
+    for (n = 0; n < (int) (sizeof (crash_signals) / sizeof (crash_signals[0])); n++)
+    {
+      if (sigaction (crash_signals[n], NULL, &old) == 0 && old.sa_handler == SIG_DFL)
+        sigaction (crash_signals[n], &action, NULL);
+    }
+    log_handlers_installed = 1;
+  }
+
+  log_writer_stop = 0;
+  log_writer_running = (pthread_create (&log_writer_thread, NULL, log_writer, NULL) == 0);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Write a message to the diag file
+ *
+ * @param [in] char *  prefix   Text to put before the message, or NULL
+ * @param [in] char *  format   The format statement for the message
+ * @param [in] va_list  ap   The values which fill out the format statement
+ * @return     The number of characters in the message, not counting the prefix
+ *
+ * The message is formatted into the ring of the calling thread, which is
+ * made the first time the thread logs something, and the writer thread is
+ * woken if the ring is getting full.  A thread only waits if its ring is
+ * full.  A message which is too long for a ring, or any message if there
+ * is no writer thread, is written directly in its place in the sequence.
+ *
+ **********************************************************/
+
+static int
+log_to_file (char *prefix, char *format, va_list ap)
+{
+  LogRingPtr ring;
+  log_record_dummy record;
+  char stack_message[LOG_MESSAGE_MAX];
+  char *message;
+  unsigned long nprefix, need, head, seq;
+  va_list ap2;
+  int result;
+
+  nprefix = (prefix != NULL) ? strlen (prefix) : 0;
+  if (nprefix > 0)
+    memcpy (stack_message, prefix, nprefix);
+
+  va_copy (ap2, ap);
+  message = stack_message;
+  result = vsnprintf (message + nprefix, LOG_MESSAGE_MAX - nprefix, format, ap);
+  if (result >= 0 && (unsigned long) result >= LOG_MESSAGE_MAX - nprefix)
+  {
+    if ((message = malloc (nprefix + result + 1)) == NULL)
+      result = -1;
+    else
+    {
+      if (nprefix > 0)
+        memcpy (message, prefix, nprefix);
+      vsnprintf (message + nprefix, result + 1, format, ap2);
+    }
+  }
+  va_end (ap2);
+  if (result < 0)
+    return (result);
+
+  record.len = nprefix + result;
+  need = sizeof (record) + record.len;
+
+  if (log_my_ring == NULL && (log_my_ring = calloc (1, sizeof (log_ring_dummy))) != NULL)
+  {
+    pthread_mutex_lock (&log_rings_lock);
+    log_my_ring->next = log_rings;
+    __atomic_store_n (&log_rings, log_my_ring, __ATOMIC_RELEASE);
+    pthread_mutex_unlock (&log_rings_lock);
+  }
+  ring = log_my_ring;
+
+  if (ring == NULL || need > LOG_RING_SIZE || !log_writer_running)
+  {
+    pthread_mutex_lock (&log_consumer_lock);
+    seq = __atomic_fetch_add (&log_next_seq, 1, __ATOMIC_ACQ_REL);
+    log_drain (1, seq);
+    fwrite (message, 1, record.len, diagptr);
+    log_next_write = seq + 1;
+    pthread_mutex_unlock (&log_consumer_lock);
+  }
+  else
+  {
+    head = ring->head;
+    while (LOG_RING_SIZE - (head - __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE)) < need)
+    {
+      pthread_cond_signal (&log_writer_wake);
+      sched_yield ();
+    }
+
+    record.seq = __atomic_fetch_add (&log_next_seq, 1, __ATOMIC_ACQ_REL);
+    log_ring_write (ring, head, &record, sizeof (record));
+    log_ring_write (ring, head + sizeof (record), message, record.len);
+    __atomic_store_n (&ring->head, head + need, __ATOMIC_RELEASE);
+
+    if (head + need - __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE) > LOG_RING_SIZE / 2)
+      pthread_cond_signal (&log_writer_wake);
+  }
+
+  if (message != stack_message)
+    free (message);
+
+  return (result);
+}
+
+
 /**********************************************************/
 /** 
  * @brief      Open a log file 
@@ -153,11 +583,15 @@ Log_init (filename)
     Exit (0);
   }
   init_log = 1;
+  log_writer_start ();
 
   nerrors = 0;
+  nerror_formats = 0;
   errorlog = (ErrorPtr) calloc (sizeof (error_dummy), NERROR_MAX);
+  error_by_description = (int *) calloc (sizeof (int), ERROR_HASH_SIZE);
+  error_by_format = (error_format_dummy *) calloc (sizeof (error_format_dummy), ERROR_FORMAT_SIZE);
 
-  if (errorlog == NULL)
+  if (errorlog == NULL || error_by_description == NULL || error_by_format == NULL)
   {
     printf ("There is a problem in allocating memory for the errorlog structure\n");
     Exit (0);
@@ -196,11 +630,15 @@ Log_append (filename)
     Exit (0);
   }
   init_log = 1;
+  log_writer_start ();
 
   nerrors = 0;
+  nerror_formats = 0;
   errorlog = (ErrorPtr) calloc (sizeof (error_dummy), NERROR_MAX);
+  error_by_description = (int *) calloc (sizeof (int), ERROR_HASH_SIZE);
+  error_by_format = (error_format_dummy *) calloc (sizeof (error_format_dummy), ERROR_FORMAT_SIZE);
 
-  if (errorlog == NULL)
+  if (errorlog == NULL || error_by_description == NULL || error_by_format == NULL)
   {
     printf ("There is a problem in allocating memory for the errorlog structure\n");
     Exit (0);
@@ -228,10 +666,16 @@ Log_append (filename)
 void
 Log_close ()
 {
+  log_writer_finish ();
+  pthread_mutex_lock (&log_consumer_lock);
+  log_drain (1, LOG_DRAIN_ALL);
   init_log = 0;
   fflush (diagptr);
   fclose (diagptr);
+  pthread_mutex_unlock (&log_consumer_lock);
   free (errorlog);              // Release the error summary structure
+  free (error_by_description);
+  free (error_by_format);
 }
 
 /* The next routine allows the user to change the amount of reporting that is
@@ -360,7 +804,7 @@ Log (char *format, ...)
 
   if (my_rank == 0)
     result = vprintf (format, ap);
-  result = vfprintf (diagptr, format, ap2);
+  result = log_to_file (NULL, format, ap2);
   va_end (ap);
   return (result);
 }
@@ -396,7 +840,7 @@ Log_silent (char *format, ...)
   va_start (ap, format);
   va_copy (ap2, ap);            /* ap is not necessarily preserved by vprintf */
 
-  result = vfprintf (diagptr, format, ap);
+  result = log_to_file (NULL, format, ap);
   va_end (ap);
   return (result);
 }
@@ -437,8 +881,7 @@ Error (char *format, ...)
   if (my_rank == 0)             // only want to print errors if master thread
     result = vprintf (format, ap);
 
-  fprintf (diagptr, "Error: ");
-  result = vfprintf (diagptr, format, ap2);
+  result = log_to_file ("Error: ", format, ap2);
   va_end (ap);
   return (result);
 }
@@ -479,8 +922,7 @@ Error_silent (char *format, ...)
 
   if (my_rank == 0)             // only want to print errors if master thread
     result = vprintf (format, ap);
-  fprintf (diagptr, "Error: ");
-  result = vfprintf (diagptr, format, ap2);
+  result = log_to_file ("Error: ", format, ap2);
   va_end (ap);
   return (result);
 }
@@ -522,8 +964,7 @@ Shout (char *format, ...)
   va_start (ap, format);
   va_copy (ap2, ap);            /* ap is not necessarily preserved by vprintf */
   result = vprintf (format, ap);
-  fprintf (diagptr, "Error: ");
-  result = vfprintf (diagptr, format, ap);
+  result = log_to_file ("Error: ", format, ap2);
   va_end (ap);
   return (result);
 }
@@ -561,6 +1002,150 @@ sane_check (x)
 
 
 
+/**********************************************************/
+/**
+ * @brief      Hash the text of a format statement
+ *
+ **********************************************************/
+
+static unsigned int
+error_hash_description (const char *format)
+{
+  unsigned int h = 2166136261u;
+
+  while (*format)
+  {
+    h ^= (unsigned char) *format++;
+    h *= 16777619u;
+  }
+  return (h);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Hash the address of a format statement
+ *
+ **********************************************************/
+
+static unsigned int
+error_hash_format (const char *format)
+{
+  unsigned long long h = (unsigned long long) (size_t) format;
+
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return ((unsigned int) h);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Remember which error a format statement belongs to
+ *
+ **********************************************************/
+
+static void
+error_remember_format (char *format, int n)
+{
+  unsigned int slot;
+
+  slot = error_hash_format (format) & (ERROR_FORMAT_SIZE - 1);
+  while (error_by_format[slot].format != NULL)
+  {
+    if (error_by_format[slot].format == format)
+    {
+      error_by_format[slot].n = n;
+      return;
+    }
+    slot = (slot + 1) & (ERROR_FORMAT_SIZE - 1);
+  }
+
+  if (nerror_formats < ERROR_FORMAT_MAX)
+  {
+    error_by_format[slot].format = format;
+    error_by_format[slot].n = n;
+    nerror_formats++;
+  }
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Find a previous error with the same format statement
+ *
+ * @param [in] char *  format   A format statement for an error message
+ * @return     The position of the error in errorlog, or -1 if it has not occurred before
+ *
+ * Errors are usually reported with string constants as their format, so the
+ * address of the format is looked up first.  As the same address can hold
+ * different text at different times, the text is always checked, and if
+ * the address is new or the text has changed, the error is looked up by
+ * its text instead.
+ *
+ **********************************************************/
+
+static int
+error_find (char *format)
+{
+  unsigned int slot;
+  int n;
+
+  slot = error_hash_format (format) & (ERROR_FORMAT_SIZE - 1);
+  while (error_by_format[slot].format != NULL)
+  {
+    if (error_by_format[slot].format == format)
+    {
+      n = error_by_format[slot].n;
+      if (strcmp (errorlog[n].description, format) == 0)
+        return (n);
+      break;
+    }
+    slot = (slot + 1) & (ERROR_FORMAT_SIZE - 1);
+  }
+
+  slot = error_hash_description (format) & (ERROR_HASH_SIZE - 1);
+  while (error_by_description[slot] != 0)
+  {
+    n = error_by_description[slot] - 1;
+    if (strcmp (errorlog[n].description, format) == 0)
+    {
+      error_remember_format (format, n);
+      return (n);
+    }
+    slot = (slot + 1) & (ERROR_HASH_SIZE - 1);
+  }
+
+  return (-1);
+}
+
+
+
+/**********************************************************/
+/**
+ * @brief      Add a new error to the hash tables
+ *
+ **********************************************************/
+
+static void
+error_add (char *format, int n)
+{
+  unsigned int slot;
+
+  slot = error_hash_description (errorlog[n].description) & (ERROR_HASH_SIZE - 1);
+  while (error_by_description[slot] != 0)
+    slot = (slot + 1) & (ERROR_HASH_SIZE - 1);
+  error_by_description[slot] = n + 1;
+
+  error_remember_format (format, n);
+}
+
+
+
 /**********************************************************/
 /** 
  * @brief      track the number of errors of each type
@@ -571,7 +1156,8 @@ sane_check (x)
  * When an error message is received, the format statement is used to identify the
  * error.  Here the format statement is compared to the format statement associated
  * with previous errors and a counter is kept of the number of times a particular error
- * has occured.
+ * has occured.  The previous errors are found with error_find, so the time this takes
+ * does not depend on how many different errors there have been.
  *
  * Once the error count for a particular error has been reached then the error is no
  * longer printed out; once the error count has reached a much larger number the
@@ -590,28 +1176,22 @@ int
 error_count (char *format)
 {
   int n;
-  n = 0;
-  while (n < nerrors)
-  {
-    if (strcmp (errorlog[n].description, (format)) == 0)
-      break;
-    n++;
-  }
 
-  if (n == nerrors)
+  n = error_find (format);
+
+  if (n < 0)
   {
-    strcpy (errorlog[nerrors].description, format);
-    errorlog[n].n = 1;
-    if (nerrors < NERROR_MAX)
-    {
-      nerrors++;
-    }
-    else
+    if (nerrors == NERROR_MAX)
     {
       printf ("Exceeded number of different errors that can be stored\n");
       error_summary ("Quitting because there are too many differnt types of errors\n");
       Exit (0);
     }
+    n = nerrors;
+    strcpy (errorlog[n].description, format);
+    errorlog[n].n = 1;
+    error_add (format, n);
+    nerrors++;
   }
   else
   {
@@ -727,7 +1307,10 @@ Log_flush ()
   if (init_log == 0)
     Log_init ("logfile");
 
+  pthread_mutex_lock (&log_consumer_lock);
+  log_drain (1, LOG_DRAIN_ALL);
   fflush (diagptr);
+  pthread_mutex_unlock (&log_consumer_lock);
   return (0);
 }
 
@@ -805,8 +1388,7 @@ Log_parallel (char *format, ...)
 
   result = vprintf (format, ap);
 
-  fprintf (diagptr, "Para: ");
-  result = vfprintf (diagptr, format, ap2);
+  result = log_to_file ("Para: ", format, ap2);
 
   return (result);
 }
@@ -852,8 +1434,7 @@ Debug (char *format, ...)
   if (my_rank == 0)
     vprintf ("Debug: ", ap);
   result = vprintf (format, ap);
-  fprintf (diagptr, "Debug: ");
-  result = vfprintf (diagptr, format, ap2);
+  result = log_to_file ("Debug: ", format, ap2);
   va_end (ap);
   return (result);
 }